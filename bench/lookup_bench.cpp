@@ -0,0 +1,152 @@
+// Measures grade lookups in each `GradeLayout` against `Qrels::grade` (binary search
+// over the judgments) and `std::unordered_map`, for queries of growing size, to locate
+// the crossovers behind the `GradeIndexOptions` defaults. Rankings retrieve a third of
+// their documents from the query's judgments, a third from other queries', and a third
+// unjudged anywhere, as deep runs do.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/grade_index.hpp"
+#include "eval_metrics/qrels.hpp"
+
+namespace {
+
+using eval_metrics::GradeIndex;
+using eval_metrics::GradeIndexOptions;
+using eval_metrics::GradeLayout;
+using eval_metrics::Qrels;
+
+constexpr std::size_t ranking_depth = 1000;
+
+/// Qrels of queries with `size` judgments each. With `contiguous`, each query judges a
+/// run of consecutively named documents, so their dictionary IDs are contiguous;
+/// otherwise documents are drawn from a pool a hundred times larger.
+[[nodiscard]] auto make_qrels(std::size_t num_queries, std::size_t size, bool contiguous, std::mt19937_64& rng)
+    -> Qrels
+{
+    std::string text;
+    std::uniform_int_distribution<std::size_t> pool(0, num_queries * size * 100);
+    std::uniform_int_distribution<int> grade(0, 3);
+    for (std::size_t query = 0; query < num_queries; ++query) {
+        std::vector<std::size_t> docs;
+        for (std::size_t idx = 0; idx < size; ++idx) {
+            docs.push_back(contiguous ? query * size + idx : pool(rng));
+        }
+        std::sort(docs.begin(), docs.end());
+        docs.erase(std::unique(docs.begin(), docs.end()), docs.end());
+        for (auto doc : docs) {
+            // Zero-padded, so that names sort (and are interned) in numeric order.
+            std::array<char, 32> name{};
+            std::snprintf(name.data(), name.size(), "D%012zu", doc);
+            text += std::to_string(query) + " 0 " + name.data() + ' ' + std::to_string(grade(rng)) + '\n';
+        }
+    }
+    return Qrels::parse(eval_metrics::Buffer::from_string(std::move(text)));
+}
+
+/// Dictionary IDs retrieved for each query.
+[[nodiscard]] auto make_rankings(Qrels const& qrels, std::mt19937_64& rng) -> std::vector<std::vector<std::uint32_t>>
+{
+    std::uniform_int_distribution<std::uint32_t> any(0, static_cast<std::uint32_t>(qrels.dictionary()->size() - 1));
+    std::vector<std::vector<std::uint32_t>> rankings(qrels.num_queries());
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        auto judgments = qrels.judgments(query);
+        std::uniform_int_distribution<std::size_t> judged(0, judgments.size() - 1);
+        for (std::size_t rank = 0; rank < ranking_depth; ++rank) {
+            switch (rank % 3) {
+            case 0: rankings[query].push_back(judgments[judged(rng)].id); break;
+            case 1: rankings[query].push_back(any(rng)); break;
+            default: rankings[query].push_back(eval_metrics::unjudged_doc);
+            }
+        }
+        std::shuffle(rankings[query].begin(), rankings[query].end(), rng);
+    }
+    return rankings;
+}
+
+/// Nanoseconds per lookup of `grade(query, id)` over all rankings.
+template <typename Lookup>
+[[nodiscard]] auto measure(std::vector<std::vector<std::uint32_t>> const& rankings, Lookup lookup, long& checksum)
+    -> double
+{
+    auto start = std::chrono::steady_clock::now();
+    std::size_t lookups = 0;
+    long sum = 0;
+    for (std::size_t query = 0; query < rankings.size(); ++query) {
+        for (auto id : rankings[query]) {
+            sum += lookup(query, id);
+        }
+        lookups += rankings[query].size();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    checksum += sum;
+    return elapsed.count() / static_cast<double>(lookups);
+}
+
+[[nodiscard]] auto forced(GradeLayout layout) -> GradeIndexOptions
+{
+    switch (layout) {
+    case GradeLayout::sorted: return {.max_dense_span_ratio = 0.0, .max_sorted_size = SIZE_MAX};
+    case GradeLayout::hash: return {.max_dense_span_ratio = 0.0, .max_sorted_size = 0};
+    case GradeLayout::dense: return {.max_dense_span_ratio = 1e300};
+    }
+    return {};
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    // Total judgments per measurement; the number of queries shrinks as they grow.
+    std::size_t total = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t{1} << 18U;
+    std::mt19937_64 rng(42);
+    long checksum = 0;
+    for (bool contiguous : {false, true}) {
+        std::printf("%s document IDs\n", contiguous ? "contiguous" : "scattered");
+        std::printf("%8s %9s %9s %9s %9s %9s   %s\n", "judged", "sorted", "hash", "dense", "lower_bnd",
+                    "unord_map", "(ns per lookup; default layout)");
+        for (std::size_t size = 4; size <= 16384; size *= 2) {
+            auto qrels = make_qrels(std::max<std::size_t>(total / size, 4), size, contiguous, rng);
+            auto rankings = make_rankings(qrels, rng);
+            // A dense array over scattered IDs would span most of the dictionary.
+            std::array<double, 3> layouts{0.0, 0.0, std::nan("")};
+            for (auto layout : {GradeLayout::sorted, GradeLayout::hash, GradeLayout::dense}) {
+                if (layout == GradeLayout::dense && !contiguous) {
+                    continue;
+                }
+                GradeIndex index(qrels, forced(layout));
+                layouts[static_cast<std::size_t>(layout)] = measure(rankings, [&](std::size_t query, std::uint32_t id) {
+                    return index.query(query).grade(id);
+                }, checksum);
+            }
+            auto lower_bound = measure(rankings, [&](std::size_t query, std::uint32_t id) {
+                return qrels.grade(query, id).value_or(eval_metrics::unjudged);
+            }, checksum);
+            std::vector<std::unordered_map<std::uint32_t, std::int32_t>> maps(qrels.num_queries());
+            for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+                for (auto const& judgment : qrels.judgments(query)) {
+                    maps[query].emplace(judgment.id, judgment.grade);
+                }
+            }
+            auto unordered_map = measure(rankings, [&](std::size_t query, std::uint32_t id) {
+                auto pos = maps[query].find(id);
+                return pos == maps[query].end() ? eval_metrics::unjudged : pos->second;
+            }, checksum);
+            GradeIndex chosen(qrels);
+            std::printf("%8zu %9.2f %9.2f %9.2f %9.2f %9.2f   %s\n", size, layouts[0], layouts[1], layouts[2],
+                        lower_bound, unordered_map, grade_layout_name(chosen.query(0).layout()));
+        }
+    }
+    std::printf("checksum %ld\n", checksum);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,277 @@
+// Measures the standard measures computed by the reference functions of `metrics.hpp`,
+// one pass per metric and cutoff, against a single `fused_pass`, the compile-time
+// metric set of `static_metrics.hpp` and the `PrefixSums` of `prefix.hpp`. Then does
+// the same for the cascade and incomplete-judgment measures of `fused_pass`, and
+// measures `vector_dcg_at` against `scalar_dcg` for both gains. That the computations
+// agree is checked by `tests/fused_test.cpp` and `tests/dcg_test.cpp`.
+// Gain columns mix relevant, non-relevant, negative and unjudged grades, at depths from
+// a handful of documents to deep runs.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "eval_metrics/dcg.hpp"
+#include "eval_metrics/fused.hpp"
+#include "eval_metrics/metrics.hpp"
+#include "eval_metrics/prefix.hpp"
+#include "eval_metrics/static_metrics.hpp"
+
+namespace {
+
+using eval_metrics::unjudged;
+
+constexpr std::array<std::size_t, 9> cutoffs{5, 10, 15, 20, 30, 100, 200, 500, 1000};
+constexpr std::int32_t relevance_level = 1;
+
+struct Query {
+    std::vector<std::int32_t> grades;
+    std::vector<std::int32_t> ideal;
+    std::size_t num_rel = 0;
+};
+
+[[nodiscard]] auto make_queries(std::size_t num_queries, std::size_t depth, std::mt19937_64& rng)
+    -> std::vector<Query>
+{
+    std::uniform_int_distribution<int> grade(-1, 4);
+    std::uniform_int_distribution<int> relevant_grade(1, 3);
+    std::uniform_int_distribution<std::size_t> num_rel(0, depth / 4 + 2);
+    std::vector<Query> queries(num_queries);
+    for (auto& query : queries) {
+        for (std::size_t rank = 0; rank < depth; ++rank) {
+            auto value = grade(rng);
+            query.grades.push_back(value == 4 ? unjudged : value);
+        }
+        query.num_rel = num_rel(rng);
+        for (std::size_t idx = 0; idx < query.num_rel; ++idx) {
+            query.ideal.push_back(relevant_grade(rng));
+        }
+        std::sort(query.ideal.begin(), query.ideal.end(), std::greater<>());
+    }
+    return queries;
+}
+
+/// All the standard measures of a query, in the order the evaluator reports them.
+[[nodiscard]] auto reference(Query const& query) -> std::vector<double>
+{
+    namespace em = eval_metrics;
+    std::vector<double> values{
+        static_cast<double>(em::relevant_retrieved(query.grades, relevance_level)),
+        em::average_precision(query.grades, query.num_rel, relevance_level),
+        em::r_precision(query.grades, query.num_rel, relevance_level),
+        em::reciprocal_rank(query.grades, relevance_level)};
+    for (auto k : cutoffs) {
+        values.push_back(em::precision(query.grades, relevance_level, k));
+        values.push_back(em::recall(query.grades, query.num_rel, relevance_level, k));
+        values.push_back(em::ndcg(query.grades, query.ideal, k));
+    }
+    values.push_back(em::ndcg(query.grades, query.ideal));
+    return values;
+}
+
+[[nodiscard]] auto fused(Query const& query) -> std::vector<double>
+{
+    namespace em = eval_metrics;
+    std::array<std::size_t, cutoffs.size()> relevant_at{};
+    std::array<double, cutoffs.size()> dcg_at{};
+    em::FusedTotals totals;
+    em::fused_pass(query.grades, query.num_rel, relevance_level, cutoffs, relevant_at, dcg_at, totals);
+    std::vector<double> values{
+        static_cast<double>(totals.relevant),
+        em::fused_average_precision(totals, query.num_rel),
+        em::fused_r_precision(totals, query.num_rel),
+        em::fused_reciprocal_rank(totals)};
+    for (std::size_t cutoff = 0; cutoff < cutoffs.size(); ++cutoff) {
+        values.push_back(em::fused_precision(relevant_at[cutoff], cutoffs[cutoff]));
+        values.push_back(em::fused_recall(relevant_at[cutoff], query.num_rel));
+        values.push_back(em::fused_ndcg(dcg_at[cutoff], em::dcg(query.ideal, cutoffs[cutoff])));
+    }
+    values.push_back(em::fused_ndcg(totals.dcg, em::dcg(query.ideal)));
+    return values;
+}
+
+using StandardSet = eval_metrics::Metrics<
+    eval_metrics::NumRelRet, eval_metrics::AP, eval_metrics::RPrec, eval_metrics::RR,
+    eval_metrics::P<5>, eval_metrics::Recall<5>, eval_metrics::NDCG<5>,
+    eval_metrics::P<10>, eval_metrics::Recall<10>, eval_metrics::NDCG<10>,
+    eval_metrics::P<15>, eval_metrics::Recall<15>, eval_metrics::NDCG<15>,
+    eval_metrics::P<20>, eval_metrics::Recall<20>, eval_metrics::NDCG<20>,
+    eval_metrics::P<30>, eval_metrics::Recall<30>, eval_metrics::NDCG<30>,
+    eval_metrics::P<100>, eval_metrics::Recall<100>, eval_metrics::NDCG<100>,
+    eval_metrics::P<200>, eval_metrics::Recall<200>, eval_metrics::NDCG<200>,
+    eval_metrics::P<500>, eval_metrics::Recall<500>, eval_metrics::NDCG<500>,
+    eval_metrics::P<1000>, eval_metrics::Recall<1000>, eval_metrics::NDCG<1000>,
+    eval_metrics::NDCG<>>;
+
+[[nodiscard]] auto compiled(Query const& query) -> std::vector<double>
+{
+    auto values = eval_metrics::evaluate<StandardSet>(query.grades, query.ideal, relevance_level).values;
+    return {values.begin(), values.end()};
+}
+
+[[nodiscard]] auto prefix(Query const& query) -> std::vector<double>
+{
+    // Reused across queries, as a caller plotting curves would.
+    static eval_metrics::PrefixSums ideal;
+    static eval_metrics::PrefixSums sums;
+    ideal.assign(query.ideal, relevance_level, query.num_rel, {});
+    sums.assign(query.grades, relevance_level, query.num_rel, ideal.dcg_prefix());
+    // Prefix sums answer the cutoff measures only; the others come from the reference.
+    std::vector<double> values{
+        static_cast<double>(sums.relevant(eval_metrics::no_cutoff)),
+        eval_metrics::average_precision(query.grades, query.num_rel, relevance_level),
+        eval_metrics::r_precision(query.grades, query.num_rel, relevance_level),
+        eval_metrics::reciprocal_rank(query.grades, relevance_level)};
+    for (auto k : cutoffs) {
+        values.push_back(sums.precision(k));
+        values.push_back(sums.recall(k));
+        values.push_back(sums.ndcg(k));
+    }
+    values.push_back(sums.ndcg());
+    return values;
+}
+
+// Stop probabilities `(2^g - 1) / 2^3` of grades 0 to 3, and RBP persistences.
+constexpr std::array<double, 4> stop_probabilities{0.0, 0.125, 0.375, 0.875};
+constexpr std::array<double, 3> persistences{0.5, 0.8, 0.95};
+
+/// Judged non-relevant documents of a query, for bpref.
+[[nodiscard]] auto num_nonrel(Query const& query) -> std::size_t
+{
+    return query.grades.size() / 2;
+}
+
+/// ERR at each cutoff and over the whole ranking, RBP and its residual at each
+/// persistence, then judged@k at each cutoff, bpref and infAP.
+[[nodiscard]] auto optional_reference(Query const& query) -> std::vector<double>
+{
+    namespace em = eval_metrics;
+    std::vector<double> values;
+    for (auto k : cutoffs) {
+        values.push_back(em::expected_reciprocal_rank(query.grades, stop_probabilities, k));
+    }
+    values.push_back(em::expected_reciprocal_rank(query.grades, stop_probabilities));
+    for (auto p : persistences) {
+        values.push_back(em::rank_biased_precision(query.grades, relevance_level, p));
+        values.push_back(em::rbp_residual(query.grades, p));
+    }
+    for (auto k : cutoffs) {
+        values.push_back(em::judged(query.grades, k));
+    }
+    values.push_back(em::bpref(query.grades, query.num_rel, num_nonrel(query), relevance_level));
+    values.push_back(em::inferred_average_precision(query.grades, query.num_rel, relevance_level));
+    return values;
+}
+
+[[nodiscard]] auto optional_fused(Query const& query) -> std::vector<double>
+{
+    namespace em = eval_metrics;
+    std::array<std::size_t, cutoffs.size()> relevant_at{};
+    std::array<double, cutoffs.size()> err_at{};
+    std::array<double, persistences.size()> rbp{};
+    std::array<double, persistences.size()> residual{};
+    std::array<double, persistences.size()> weights{};
+    std::array<std::size_t, cutoffs.size()> judged_at{};
+    em::FusedCascade cascade{stop_probabilities, persistences, err_at, 0.0, rbp, residual, weights};
+    em::FusedIncomplete incomplete{num_nonrel(query), judged_at};
+    em::FusedTotals totals;
+    em::fused_pass<false, true, true>(
+        query.grades, query.num_rel, relevance_level, cutoffs, relevant_at, {}, totals,
+        em::DiscountTable::standard(), &cascade, &incomplete);
+    std::vector<double> values(err_at.begin(), err_at.end());
+    values.push_back(cascade.err);
+    for (std::size_t idx = 0; idx < persistences.size(); ++idx) {
+        values.push_back(rbp[idx]);
+        values.push_back(residual[idx]);
+    }
+    for (std::size_t cutoff = 0; cutoff < cutoffs.size(); ++cutoff) {
+        values.push_back(em::fused_judged(judged_at[cutoff], cutoffs[cutoff]));
+    }
+    values.push_back(incomplete.bpref);
+    values.push_back(incomplete.infap);
+    return values;
+}
+
+/// Nanoseconds per ranked document to compute all measures of every query.
+template <typename Compute>
+[[nodiscard]] auto measure(std::vector<Query> const& queries, Compute compute, std::vector<std::vector<double>>& out)
+    -> double
+{
+    out.clear();
+    std::size_t docs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto const& query : queries) {
+        out.push_back(compute(query));
+        docs += query.grades.size();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / static_cast<double>(docs);
+}
+
+/// Nanoseconds per ranked document to compute the DCG at every cutoff with the scalar
+/// reference and with the vectorized kernel.
+[[nodiscard]] auto measure_dcg(std::vector<Query> const& queries, eval_metrics::Gain gain) -> std::array<double, 2>
+{
+    eval_metrics::DiscountTable discounts(cutoffs.back());
+    std::vector<std::array<double, cutoffs.size()>> scalar(queries.size());
+    std::vector<std::array<double, cutoffs.size()>> vector(queries.size());
+    std::size_t docs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t query = 0; query < queries.size(); ++query) {
+        for (std::size_t cutoff = 0; cutoff < cutoffs.size(); ++cutoff) {
+            scalar[query][cutoff] = eval_metrics::scalar_dcg(queries[query].grades, discounts, gain, cutoffs[cutoff]);
+        }
+        docs += queries[query].grades.size();
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (std::size_t query = 0; query < queries.size(); ++query) {
+        eval_metrics::vector_dcg_at(queries[query].grades, discounts, gain, cutoffs, vector[query]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto per_doc = [&](auto from, auto to) {
+        return std::chrono::duration<double, std::nano>(to - from).count() / static_cast<double>(docs);
+    };
+    return {per_doc(start, middle), per_doc(middle, end)};
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    // Total ranked documents per measurement; the number of queries shrinks as they deepen.
+    std::size_t total = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t{1} << 22U;
+    std::mt19937_64 rng(42);
+    std::printf("%8s %10s %10s %10s %10s   %s\n", "depth", "reference", "fused", "static", "prefix",
+                "(ns per ranked document)");
+    for (std::size_t depth : {3, 10, 100, 1000, 10000}) {
+        auto queries = make_queries(std::max<std::size_t>(total / depth, 1), depth, rng);
+        std::vector<std::vector<double>> values;
+        auto slow = measure(queries, reference, values);
+        auto fast = measure(queries, fused, values);
+        auto fixed = measure(queries, compiled, values);
+        auto sums = measure(queries, prefix, values);
+        std::printf("%8zu %10.2f %10.2f %10.2f %10.2f\n", depth, slow, fast, fixed, sums);
+    }
+    std::printf("\n%8s %10s %10s %10s %10s   %s\n", "depth", "linear", "vector", "exp", "vector",
+                "(ns per ranked document, DCG at every cutoff)");
+    for (std::size_t depth : {10, 100, 1000, 10000}) {
+        auto queries = make_queries(std::max<std::size_t>(total / depth, 1), depth, rng);
+        auto linear = measure_dcg(queries, eval_metrics::Gain::linear);
+        auto exponential = measure_dcg(queries, eval_metrics::Gain::exponential);
+        std::printf("%8zu %10.2f %10.2f %10.2f %10.2f\n", depth, linear[0], linear[1], exponential[0], exponential[1]);
+    }
+    std::printf("\n%8s %10s %10s   %s\n", "depth", "reference", "fused", "(ns per ranked document, ERR, RBP, judged@k, bpref, infAP)");
+    for (std::size_t depth : {3, 10, 100, 1000, 10000}) {
+        auto queries = make_queries(std::max<std::size_t>(total / depth, 1), depth, rng);
+        std::vector<std::vector<double>> values;
+        auto slow = measure(queries, optional_reference, values);
+        auto fast = measure(queries, optional_fused, values);
+        std::printf("%8zu %10.2f %10.2f\n", depth, slow, fast);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+// Compares score parsing with `detail::parse_score` against `std::from_chars`, `strtod`
+// and `std::istringstream` on score distributions typical of TREC runs. That every
+// parsed value is bit-for-bit the one `strtod` produces is checked by
+// `tests/numeric_test`.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/detail/numeric.hpp"
+
+namespace {
+
+struct Distribution {
+    char const* name;
+    std::function<std::string(std::mt19937_64&)> generate;
+};
+
+[[nodiscard]] auto format(char const* pattern, double value) -> std::string
+{
+    std::array<char, 64> text{};
+    auto size = std::snprintf(text.data(), text.size(), pattern, value);
+    return {text.data(), static_cast<std::size_t>(size)};
+}
+
+[[nodiscard]] auto distributions() -> std::vector<Distribution>
+{
+    return {
+        {"bm25 %.4f",
+         [](auto& rng) { return format("%.4f", std::gamma_distribution<>(4.0, 3.0)(rng)); }},
+        {"bm25 %.17g",
+         [](auto& rng) { return format("%.17g", std::gamma_distribution<>(4.0, 3.0)(rng)); }},
+        {"logit %.6f",
+         [](auto& rng) { return format("%.6f", std::normal_distribution<>(0.0, 4.0)(rng)); }},
+        {"probability %g",
+         [](auto& rng) { return format("%g", std::exponential_distribution<>(50.0)(rng)); }},
+        {"tiny %.8e",
+         [](auto& rng) { return format("%.8e", std::exp(std::uniform_real_distribution<>(-60, 0)(rng))); }},
+        {"reciprocal rank",
+         [](auto& rng) { return format("%.10f", 1.0 / std::uniform_int_distribution<>(1, 1000)(rng)); }},
+    };
+}
+
+template <typename Parse>
+[[nodiscard]] auto measure(std::vector<std::string_view> const& fields, Parse parse, double& checksum)
+    -> double
+{
+    auto start = std::chrono::steady_clock::now();
+    double sum = 0.0;
+    for (auto field : fields) {
+        sum += parse(field);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    checksum += sum;
+    return elapsed.count() / static_cast<double>(fields.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::mt19937_64 rng(42);
+    double checksum = 0.0;
+    std::printf("%-18s %12s %12s %12s %12s   (ns per score)\n", "distribution", "parse_score",
+                "from_chars", "strtod", "istream");
+    for (auto const& distribution : distributions()) {
+        // Fields are views into one buffer, as they are into a mapped run file.
+        std::string buffer;
+        std::vector<std::size_t> bounds{0};
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            buffer += distribution.generate(rng);
+            bounds.push_back(buffer.size());
+            buffer += ' ';
+        }
+        std::vector<std::string_view> fields;
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            fields.emplace_back(buffer.data() + bounds[idx] + (idx > 0 ? 1 : 0),
+                                bounds[idx + 1] - bounds[idx] - (idx > 0 ? 1 : 0));
+        }
+
+        auto fast = measure(fields, [](std::string_view field) {
+            double value = 0.0;
+            (void)eval_metrics::detail::parse_score(field, value);
+            return value;
+        }, checksum);
+        auto from_chars = measure(fields, [](std::string_view field) {
+            double value = 0.0;
+            std::from_chars(field.data(), field.data() + field.size(), value);
+            return value;
+        }, checksum);
+        // strtod needs a terminator, which the mapped buffer does not have: copy, as
+        // callers must.
+        auto strtod = measure(fields, [](std::string_view field) {
+            std::array<char, 64> copy{};
+            std::memcpy(copy.data(), field.data(), std::min(field.size(), copy.size() - 1));
+            return std::strtod(copy.data(), nullptr);
+        }, checksum);
+        std::istringstream stream;
+        auto istream = measure(fields, [&](std::string_view field) {
+            stream.clear();
+            stream.str(std::string(field));
+            double value = 0.0;
+            stream >> value;
+            return value;
+        }, checksum);
+        std::printf("%-18s %12.1f %12.1f %12.1f %12.1f\n", distribution.name, fast, from_chars, strtod,
+                    istream);
+    }
+    std::printf("checksum %g\n", checksum);
+    return EXIT_SUCCESS;
+}
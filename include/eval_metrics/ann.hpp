@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/evaluator.hpp"
+
+namespace eval_metrics {
+
+/// Layouts of the dense vector files of nearest-neighbor benchmarks.
+enum class VectorFormat {
+    /// `.ivecs`/`.fvecs` (TEXMEX): each row is its dimension, a 32-bit integer,
+    /// followed by its values.
+    vecs,
+    /// `.ibin`/`.fbin` (big-ann-benchmarks): the number of rows and their dimension, two
+    /// 32-bit unsigned integers, followed by the rows.
+    bin,
+};
+
+/// A memory-mapped matrix of 32-bit values in little-endian order, one row per query:
+/// the IDs of its nearest neighbors (`NeighborMatrix`), nearest first, or their
+/// distances (`DistanceMatrix`). Rows are views into the underlying `Buffer`, so a
+/// matrix of 10M x 100 neighbors is only paged in as it is read.
+template <typename T>
+class VectorMatrix {
+  public:
+    /// Maps and loads a vector file, in the format of its extension: `.ivecs` and
+    /// `.fvecs` files are `vecs`, any other (`.ibin`, `.fbin`) `bin`. Throws `IoError` or
+    /// `ParseError`.
+    [[nodiscard]] static auto from_file(std::filesystem::path const& path) -> VectorMatrix;
+
+    /// Reads the matrix held by `buffer`. Throws `ParseError` for a truncated file or,
+    /// in the `vecs` format, rows of different dimensions.
+    [[nodiscard]] static auto parse(std::shared_ptr<Buffer const> buffer, VectorFormat format) -> VectorMatrix;
+
+    [[nodiscard]] auto rows() const noexcept -> std::size_t { return m_rows; }
+    [[nodiscard]] auto dim() const noexcept -> std::size_t { return m_dim; }
+
+    [[nodiscard]] auto row(std::size_t row) const noexcept -> std::span<T const>
+    {
+        return {m_data + row * m_stride, m_dim};
+    }
+
+  private:
+    VectorMatrix() = default;
+
+    std::shared_ptr<Buffer const> m_buffer;
+    T const* m_data = nullptr;
+    std::size_t m_rows = 0;
+    std::size_t m_dim = 0;
+    /// Distance between consecutive rows, one more than `m_dim` with `vecs` headers.
+    std::size_t m_stride = 0;
+};
+
+using NeighborMatrix = VectorMatrix<std::int32_t>;
+using DistanceMatrix = VectorMatrix<float>;
+
+extern template class VectorMatrix<std::int32_t>;
+extern template class VectorMatrix<float>;
+
+/// A measure of approximate nearest-neighbor search.
+struct AnnMeasure {
+    enum class Kind {
+        /// `|G_k ∩ R_depth| / k`: the fraction of the `k` true nearest neighbors `G_k`
+        /// found among the first `depth` results `R_depth`. Printed `recall@k` when
+        /// `depth == k`, and `k-recall@depth` otherwise.
+        recall,
+        /// The sum of the distances of the first `k` results over the sum of the
+        /// distances of the `k` true nearest neighbors; 1 for a perfect result, and 1
+        /// when both sums are 0. Distances are assumed non-negative. Printed `ratio@k`.
+        distance_ratio,
+    };
+
+    Kind kind;
+    std::size_t k;
+    std::size_t depth;
+
+    /// Parses `recall@k`, `k-recall@depth` or `ratio@k`. Throws `Error`.
+    [[nodiscard]] static auto parse(std::string_view spec) -> AnnMeasure;
+
+    [[nodiscard]] auto name() const -> std::string;
+};
+
+struct AnnOptions {
+    /// Measures to compute; see `AnnMeasure::parse`.
+    std::vector<std::string> measures{"recall@10"};
+    /// Number of worker threads (0 = all cores).
+    std::size_t threads = 0;
+};
+
+/// Evaluates nearest-neighbor search results, one row of neighbor IDs per query,
+/// against the ground truth of a vector-search benchmark.
+///
+/// The recall of each query counts the true neighbors found among the results: each
+/// block of eight true neighbors is compared with every result at once (AVX2 where
+/// available), so a true neighbor listed once counts once even if the results repeat
+/// it. Queries are evaluated in parallel over fixed blocks of rows, and the summary
+/// sums the blocks in order, so it does not depend on the number of threads.
+class AnnEvaluator {
+  public:
+    /// Parses the measures. `distances`, the distances of the true neighbors, is needed
+    /// by distance ratios and must outlive the evaluator, as must `ground_truth`. Throws
+    /// `Error` for an invalid measure, one deeper than the ground truth, or mismatched
+    /// distances.
+    explicit AnnEvaluator(
+        NeighborMatrix const& ground_truth, AnnOptions options = {}, DistanceMatrix const* distances = nullptr);
+
+    [[nodiscard]] auto metrics() const noexcept -> std::span<MetricInfo const> { return m_metrics; }
+    [[nodiscard]] auto measures() const noexcept -> std::span<AnnMeasure const> { return m_measures; }
+    [[nodiscard]] auto options() const noexcept -> AnnOptions const& { return m_options; }
+
+    /// Deepest result any measure reads.
+    [[nodiscard]] auto required_depth() const noexcept -> std::size_t { return m_depth; }
+
+    /// Writes the metric values of query `query`, with result IDs `found` and their
+    /// `distances` (empty without distance ratios), to `values`.
+    void evaluate_query(std::size_t query, std::span<std::int32_t const> found, std::span<float const> distances,
+                        std::span<double> values) const;
+
+    /// Evaluates every query and returns the mean of each metric. The values of each
+    /// query are also written, row by row, to `per_query` if given. Throws `Error` if
+    /// `results` has a different number of rows than the ground truth or fewer columns
+    /// than `required_depth()`, or if distance ratios are requested without
+    /// `distances` of the same shape.
+    [[nodiscard]] auto evaluate(NeighborMatrix const& results, DistanceMatrix const* distances = nullptr,
+                                std::vector<double>* per_query = nullptr) const -> std::vector<double>;
+
+  private:
+    NeighborMatrix const* m_truth;
+    DistanceMatrix const* m_distances;
+    AnnOptions m_options;
+    std::vector<AnnMeasure> m_measures;
+    std::vector<MetricInfo> m_metrics;
+    std::size_t m_depth = 0;
+    bool m_needs_distances = false;
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace eval_metrics {
+
+struct BatchOptions {
+    /// Number of runs evaluated concurrently; 0 uses all available cores. Spare threads
+    /// (more threads than runs) parse the runs in parallel.
+    std::size_t threads = 0;
+    /// Stream runs grouped by query instead of loading them, falling back to loading
+    /// runs that are not grouped.
+    bool stream = false;
+    RankingOrder order = RankingOrder::score;
+    /// Loads a run; defaults to `Run::from_file`. Must be safe to call concurrently.
+    std::function<Run(std::filesystem::path const&, RunParseOptions const&)> load_run = nullptr;
+};
+
+/// Outcome of evaluating one run of a batch: its results, or the error that stopped it.
+struct RunEvaluation {
+    std::filesystem::path path;
+    std::string tag;
+    std::optional<Results> results;
+    std::exception_ptr error;
+    /// Why the run was loaded whole although `BatchOptions::stream` asked to stream it
+    /// (the message of its `UngroupedRunError`); empty if it was not.
+    std::string stream_fallback;
+};
+
+/// Evaluates many runs against the qrels of one evaluator, concurrently.
+///
+/// The qrels and their dictionary are loaded and indexed once and shared read-only by
+/// all worker threads; each run is resolved against the shared dictionary while it is
+/// parsed. Returns one entry per run, in the order of `runs`; a run that fails to load
+/// does not stop the others.
+[[nodiscard]] auto evaluate_runs(
+    Evaluator const& evaluator, std::span<std::filesystem::path const> runs, BatchOptions const& options = {})
+    -> std::vector<RunEvaluation>;
+
+}  // namespace eval_metrics
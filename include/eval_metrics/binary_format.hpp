@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+
+/// Compact columnar binary format for qrels and runs.
+///
+/// A file starts with a fixed header (magic bytes, format version, kind, counts, the
+/// size and modification time of the text it was converted from, and a checksum),
+/// followed by 8-byte aligned sections:
+///
+///  - query IDs: `uint64` offsets into a blob of concatenated IDs, in ID order;
+///  - document dictionary: `uint64` offsets into a blob of the distinct document IDs,
+///    sorted byte-wise; for qrels, this is exactly its `DocDictionary`;
+///  - per-query offset table: `uint64` start of each query's entries, plus the end;
+///  - columns: `uint32` dictionary indices, and either `int32` grades (qrels) or
+///    `double` scores and `int64` ranks (runs), in evaluation order;
+///  - the run tag (runs only);
+///  - the `QrelsStatistics` columns (qrels only): per-query offsets into the distinct
+///    grades and their cumulative counts, and into the ideal gains and ideal DCG
+///    prefix sums, which are used from the mapping as they are.
+///
+/// All integers are little-endian. Loading maps the file and points the document and
+/// query IDs into the mapping, so no text is parsed and nothing is sorted.
+namespace eval_metrics {
+
+/// Format version written by this library; files of other versions are rejected.
+inline constexpr std::uint32_t binary_format_version = 2;
+
+/// Identifies the text file a binary file was converted from.
+struct SourceStamp {
+    std::uint64_t size = 0;
+    std::int64_t mtime_ns = 0;
+
+    /// Stamp of an existing file. Throws `IoError`.
+    [[nodiscard]] static auto of(std::filesystem::path const& path) -> SourceStamp;
+
+    [[nodiscard]] auto operator==(SourceStamp const&) const -> bool = default;
+};
+
+/// Whether the bytes start with the magic bytes of the binary format.
+[[nodiscard]] auto is_binary_format(std::string_view bytes) noexcept -> bool;
+
+/// Writes qrels or a run in the binary format. Throws `IoError`.
+void write_binary(std::filesystem::path const& path, Qrels const& qrels, SourceStamp source = {});
+void write_binary(std::filesystem::path const& path, Run const& run, SourceStamp source = {});
+
+/// Loads a binary file held by `buffer`, verifying its version and checksum.
+/// Throws `ParseError` if the file is of another kind, version, or is corrupt.
+[[nodiscard]] auto read_binary_qrels(std::shared_ptr<Buffer const> buffer) -> Qrels;
+
+/// Same as `read_binary_qrels` for runs; if a dictionary is given, the documents are
+/// resolved against it, looking up each distinct document once. Rankings keep the
+/// order they were written in (see `Run::reorder`).
+[[nodiscard]] auto read_binary_run(
+    std::shared_ptr<Buffer const> buffer, std::shared_ptr<DocDictionary const> dictionary = nullptr)
+    -> Run;
+
+/// The source stamp recorded in a binary file, or nothing if the file is missing, is
+/// not in the binary format, or has another version. Reads only the header.
+[[nodiscard]] auto binary_source_stamp(std::filesystem::path const& path)
+    -> std::optional<SourceStamp>;
+
+/// Loads qrels through a binary cache: if `cache` was converted from the current
+/// version of `source`, it is mapped; otherwise `source` is parsed and `cache` rewritten.
+[[nodiscard]] auto load_qrels_cached(
+    std::filesystem::path const& source, std::filesystem::path const& cache) -> Qrels;
+
+/// Same as `load_qrels_cached` for runs.
+[[nodiscard]] auto load_run_cached(
+    std::filesystem::path const& source,
+    std::filesystem::path const& cache,
+    RunParseOptions options = {}) -> Run;
+
+}  // namespace eval_metrics
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace eval_metrics {
+
+/// Immutable, contiguous input bytes: either a read-only memory mapping of a file
+/// or an owned string. Parsed structures keep `std::string_view`s into the buffer,
+/// so they share ownership of it through a `std::shared_ptr`.
+class Buffer {
+  public:
+    /// Maps the whole file read-only. Throws `IoError` on failure.
+    [[nodiscard]] static auto map_file(std::filesystem::path const& path)
+        -> std::shared_ptr<Buffer const>;
+
+    /// Takes ownership of an in-memory string.
+    [[nodiscard]] static auto from_string(std::string data) -> std::shared_ptr<Buffer const>;
+
+    Buffer(Buffer const&) = delete;
+    Buffer(Buffer&&) = delete;
+    auto operator=(Buffer const&) -> Buffer& = delete;
+    auto operator=(Buffer&&) -> Buffer& = delete;
+    ~Buffer();
+
+    [[nodiscard]] auto view() const noexcept -> std::string_view { return {m_data, m_size}; }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+    [[nodiscard]] auto is_mapped() const noexcept -> bool { return m_mapped; }
+
+  private:
+    Buffer() = default;
+
+    char const* m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_mapped = false;
+    std::string m_owned;
+};
+
+}  // namespace eval_metrics
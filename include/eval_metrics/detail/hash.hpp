@@ -0,0 +1,35 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace eval_metrics::detail {
+
+/// Fast non-cryptographic hash of short strings such as document IDs; consumes
+/// eight bytes per step.
+[[nodiscard]] inline auto hash_string(std::string_view str) noexcept -> std::uint64_t
+{
+    constexpr std::uint64_t multiplier = 0x9E3779B185EBCA87ULL;
+    std::uint64_t hash = str.size() * multiplier;
+    auto const* data = str.data();
+    auto remaining = str.size();
+    while (remaining >= 8) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, data, 8);
+        hash = std::rotl((hash ^ word) * multiplier, 29);
+        data += 8;
+        remaining -= 8;
+    }
+    if (remaining > 0) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, data, remaining);
+        hash = std::rotl((hash ^ word) * multiplier, 29);
+    }
+    hash ^= hash >> 32U;
+    hash *= multiplier;
+    return hash ^ (hash >> 29U);
+}
+
+}  // namespace eval_metrics::detail
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "eval_metrics/detail/simd_scan.hpp"
+
+namespace eval_metrics::detail {
+
+/// Counts the elements of `truth` that occur in `found`; an element of `truth` listed
+/// twice counts twice, one repeated in `found` once.
+using IntersectionKernel = std::size_t (*)(
+    std::span<std::int32_t const> truth, std::span<std::int32_t const> found) noexcept;
+
+/// The intersection kernel implemented with the given instruction set, which must be
+/// supported; AVX2 has its own, the others share the scalar one.
+[[nodiscard]] auto intersection_kernel(Isa isa) noexcept -> IntersectionKernel;
+
+/// Counts with the intersection kernel of `detected_isa()`.
+[[nodiscard]] inline auto count_common(
+    std::span<std::int32_t const> truth, std::span<std::int32_t const> found) noexcept -> std::size_t
+{
+    static IntersectionKernel const kernel = intersection_kernel(detected_isa());
+    return kernel(truth, found);
+}
+
+}  // namespace eval_metrics::detail
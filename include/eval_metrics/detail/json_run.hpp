@@ -0,0 +1,29 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/detail/run_line.hpp"
+
+namespace eval_metrics::detail {
+
+/// Whether a run file starting with `head` is in JSON Lines: its first non-blank byte
+/// is `{`, which cannot start a TREC run line.
+[[nodiscard]] auto is_json_run(std::string_view head) noexcept -> bool;
+
+/// Parses one JSON Lines ranking,
+///
+///     {"qid": "q1", "docs": [{"id": "d7", "score": 12.5}, ...], "tag": "bm25"}
+///
+/// appending a `RunLine` per document to `lines`. IDs may be strings or numbers; a
+/// document's rank is its `rank`, or its 1-based position in `docs`. The optional `tag`
+/// (or `run`) names the run; other members are skipped. Strings are views into `line`,
+/// except those with escapes, which are decoded into `arena`. Returns `false` for a
+/// blank line and throws `ParseError` (without a line number, which the caller adds)
+/// for a malformed one.
+[[nodiscard]] auto parse_json_ranking(
+    std::string_view line, std::deque<std::string>& arena, std::vector<RunLine>& lines) -> bool;
+
+}  // namespace eval_metrics::detail
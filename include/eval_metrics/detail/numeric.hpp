@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+namespace eval_metrics::detail {
+
+// Number parsing on fields of the mapped input: no locale, no copies, no allocation.
+// Unlike `std::from_chars`, a leading `+` is accepted, as `atoi` and `atof` (and so
+// `trec_eval`) accept it.
+
+/// Parses the whole field as a decimal integer with an optional sign.
+/// Returns `false` if it is not one or does not fit in `T`.
+template <std::integral T>
+[[nodiscard]] constexpr auto parse_integer(std::string_view field, T& value) noexcept -> bool
+{
+    using Unsigned = std::make_unsigned_t<T>;
+    auto const* pos = field.data();
+    auto const* end = pos + field.size();
+    bool negative = false;
+    if (pos != end && (*pos == '-' || *pos == '+')) {
+        negative = *pos == '-';
+        if (negative && !std::is_signed_v<T>) {
+            return false;
+        }
+        ++pos;
+    }
+    if (pos == end) {
+        return false;
+    }
+    Unsigned limit = negative ? Unsigned(Unsigned(std::numeric_limits<T>::max()) + 1)
+                              : Unsigned(std::numeric_limits<T>::max());
+    Unsigned magnitude = 0;
+    for (; pos != end; ++pos) {
+        auto digit = static_cast<unsigned>(*pos) - '0';
+        if (digit > 9 || magnitude > (limit - digit) / 10) {
+            return false;
+        }
+        magnitude = static_cast<Unsigned>(magnitude * 10 + digit);
+    }
+    value = negative ? static_cast<T>(Unsigned(~magnitude + 1)) : static_cast<T>(magnitude);
+    return true;
+}
+
+/// Parses the whole field as a floating point score, rounding correctly so that the
+/// result is bit-for-bit what `strtod` (and so `trec_eval`) computes.
+///
+/// Decimal scores with at most 19 significant digits whose value is `m * 10^e` with
+/// `m <= 2^53` and `|e| <= 22` take Clinger's fast path: `m` and `10^|e|` are exact
+/// doubles, so one IEEE multiplication or division rounds correctly. This covers the
+/// scores retrieval systems print; everything else defers to `std::from_chars`.
+[[nodiscard]] inline auto parse_score(std::string_view field, double& value) noexcept -> bool
+{
+    static constexpr std::array<double, 23> powers{
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    constexpr std::uint64_t max_exact = std::uint64_t{1} << 53U;
+    constexpr int max_digits = 19;
+
+    auto const* pos = field.data();
+    auto const* end = pos + field.size();
+    bool negative = false;
+    if (pos != end && (*pos == '-' || *pos == '+')) {
+        negative = *pos == '-';
+        ++pos;
+    }
+    auto const* number = pos;
+    auto fallback = [&]() noexcept {
+        // `from_chars` accepts a `-` of its own, which would let "--5" through.
+        if (number != end && (*number == '-' || *number == '+')) {
+            return false;
+        }
+        auto [ptr, ec] = std::from_chars(number, end, value);
+        if (ec == std::errc::result_out_of_range && ptr == end) {
+            // `strtod` saturates to infinity or flushes to zero, which `from_chars`
+            // leaves to the caller; let it decide on a terminated copy.
+            std::array<char, 128> copy{};
+            auto size = static_cast<std::size_t>(end - number);
+            if (size >= copy.size()) {
+                return false;
+            }
+            std::memcpy(copy.data(), number, size);
+            value = std::strtod(copy.data(), nullptr);
+        } else if (ec != std::errc() || ptr != end) {
+            return false;
+        }
+        value = negative ? -value : value;
+        return true;
+    };
+
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    for (; pos != end && static_cast<unsigned>(*pos - '0') <= 9; ++pos) {
+        mantissa = mantissa * 10 + static_cast<unsigned>(*pos - '0');
+        digits += mantissa != 0 ? 1 : 0;
+        any_digit = true;
+    }
+    if (pos != end && *pos == '.') {
+        for (++pos; pos != end && static_cast<unsigned>(*pos - '0') <= 9; ++pos) {
+            mantissa = mantissa * 10 + static_cast<unsigned>(*pos - '0');
+            digits += mantissa != 0 ? 1 : 0;
+            --exponent;
+            any_digit = true;
+        }
+    }
+    if (!any_digit || digits > max_digits) {
+        return fallback();
+    }
+    if (pos != end && (*pos == 'e' || *pos == 'E')) {
+        int explicit_exponent = 0;
+        if (!parse_integer(std::string_view(pos + 1, static_cast<std::size_t>(end - pos - 1)), explicit_exponent)
+            || explicit_exponent > 10000 || explicit_exponent < -10000) {
+            return fallback();
+        }
+        exponent += explicit_exponent;
+        pos = end;
+    }
+    if (pos != end) {
+        return false;
+    }
+    if (mantissa > max_exact || exponent < -22 || exponent > 22) {
+        return fallback();
+    }
+    auto magnitude = static_cast<double>(mantissa);
+    magnitude = exponent < 0 ? magnitude / powers[static_cast<std::size_t>(-exponent)]
+                             : magnitude * powers[static_cast<std::size_t>(exponent)];
+    value = negative ? -magnitude : magnitude;
+    return true;
+}
+
+}  // namespace eval_metrics::detail
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace eval_metrics::detail {
+
+/// Number of worker threads to use when the caller asked for `requested` (0 = all cores).
+[[nodiscard]] inline auto resolve_threads(std::size_t requested) noexcept -> std::size_t
+{
+    if (requested > 0) {
+        return requested;
+    }
+    return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+/// Calls `task(idx)` for every `idx < num_tasks` on up to `threads` threads, handing
+/// out tasks dynamically. If tasks throw, the exception of the lowest-indexed failing
+/// task is rethrown after all threads finish, so failures are reported deterministically.
+template <typename Task>
+void parallel_for(std::size_t num_tasks, std::size_t threads, Task&& task)
+{
+    threads = std::min(resolve_threads(threads), num_tasks);
+    if (threads <= 1) {
+        for (std::size_t idx = 0; idx < num_tasks; ++idx) {
+            task(idx);
+        }
+        return;
+    }
+    std::vector<std::exception_ptr> errors(num_tasks);
+    std::atomic_size_t next{0};
+    auto worker = [&] {
+        for (auto idx = next++; idx < num_tasks; idx = next++) {
+            try {
+                task(idx);
+            } catch (...) {
+                errors[idx] = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    for (auto const& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}  // namespace eval_metrics::detail
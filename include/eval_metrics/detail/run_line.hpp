@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+
+#include "eval_metrics/detail/numeric.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace eval_metrics::detail {
+
+/// One line of a TREC run.
+struct RunLine {
+    std::string_view query;
+    ScoredDoc doc;
+    std::string_view tag;
+};
+
+/// Fields of a run line, as read by `FieldTokenizer`.
+using RunFields = std::array<std::string_view, 6>;
+
+/// Parses the fields `qid Q0 docno rank score tag` of a line. Returns `false` for blank
+/// lines and throws `ParseError` (without a line number, which the caller adds) for
+/// malformed ones.
+[[nodiscard]] inline auto parse_run_fields(RunFields const& fields, std::size_t count, RunLine& parsed)
+    -> bool
+{
+    if (count == 0) {
+        return false;
+    }
+    if (count != fields.size()) {
+        throw ParseError("expected 6 fields: qid Q0 docno rank score tag");
+    }
+    parsed = RunLine{fields[0], {fields[2], 0.0, 0}, fields[5]};
+    if (!parse_integer(fields[3], parsed.doc.rank)) {
+        throw ParseError("invalid rank: " + std::string(fields[3]));
+    }
+    if (!parse_score(fields[4], parsed.doc.score)) {
+        throw ParseError("invalid score: " + std::string(fields[4]));
+    }
+    return true;
+}
+
+}  // namespace eval_metrics::detail
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "eval_metrics/input_stream.hpp"
+
+namespace eval_metrics::detail {
+
+/// Decompressed text that is never copied as a whole: the buffers handed over by an
+/// input stream, plus copies of the lines that straddle two of them.
+struct SegmentedText {
+    std::vector<std::vector<char>> buffers;
+    /// A deque, so that appending does not move (and invalidate views into) earlier lines.
+    std::deque<std::string> bridges;
+};
+
+/// Reads `input` to its end, calling `segment(lines, preceding_lines)` with runs of
+/// whole lines, in order, as each buffer arrives, so that decompression on the
+/// stream's thread overlaps with parsing. Each buffer's complete lines are passed in
+/// place; a line split across buffers is copied whole. The views stay valid as long as
+/// `text`, which keeps every buffer they point into. `taken`, if given, is a buffer
+/// already taken from `input`, read before the rest.
+template <typename Segment>
+void read_segments(
+    InputStream& input, SegmentedText& text, Segment&& segment, std::optional<std::vector<char>> taken = std::nullopt)
+{
+    std::string carry;
+    std::size_t lines_before = 0;
+    auto parse_segment = [&](std::string_view lines) {
+        segment(lines, lines_before);
+        lines_before += static_cast<std::size_t>(std::count(lines.begin(), lines.end(), '\n'));
+    };
+    for (auto buffer = taken ? std::move(taken) : input.take(); buffer; buffer = input.take()) {
+        std::string_view view(buffer->data(), buffer->size());
+        auto first = view.find('\n');
+        if (first == std::string_view::npos) {
+            carry.append(view);
+            input.recycle(std::move(*buffer));
+            continue;
+        }
+        carry.append(view.substr(0, first + 1));
+        parse_segment(text.bridges.emplace_back(std::move(carry)));
+        carry.clear();
+        auto last = view.rfind('\n');
+        carry.assign(view.substr(last + 1));
+        if (last > first) {
+            parse_segment(view.substr(first + 1, last - first));
+            text.buffers.push_back(std::move(*buffer));
+        } else {
+            input.recycle(std::move(*buffer));
+        }
+    }
+    if (!carry.empty()) {
+        parse_segment(text.bridges.emplace_back(std::move(carry)));
+    }
+}
+
+}  // namespace eval_metrics::detail
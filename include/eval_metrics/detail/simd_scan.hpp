@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace eval_metrics::detail {
+
+/// Bit `i` of each mask describes byte `i` of a 64-byte block.
+struct BlockMasks {
+    std::uint64_t newlines;
+    /// Field separators other than the newline; see `is_blank`.
+    std::uint64_t blanks;
+};
+
+/// Classifies the 64 bytes starting at `block`.
+using BlockScanner = BlockMasks (*)(char const* block) noexcept;
+
+enum class Isa { scalar, sse42, avx2 };
+
+[[nodiscard]] auto isa_name(Isa isa) noexcept -> std::string_view;
+
+/// The best instruction set supported by the CPU, unless lowered by setting the
+/// `EVAL_METRICS_ISA` environment variable to `scalar` or `sse42`. Detected once.
+[[nodiscard]] auto detected_isa() noexcept -> Isa;
+
+/// The block scanner implemented with the given instruction set, which must be supported.
+[[nodiscard]] auto block_scanner(Isa isa) noexcept -> BlockScanner;
+
+/// The block scanner of `detected_isa()`.
+[[nodiscard]] inline auto block_scanner() noexcept -> BlockScanner
+{
+    static BlockScanner const scanner = block_scanner(detected_isa());
+    return scanner;
+}
+
+}  // namespace eval_metrics::detail
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace eval_metrics::detail {
+
+/// Field separators of the TREC text formats; matches `isspace` minus the newline,
+/// so that tabs, spaces, and the `\r` of CRLF files are all treated alike.
+[[nodiscard]] constexpr auto is_blank(char c) noexcept -> bool
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// Iterates over the `\n`-terminated lines of a text, tracking 1-based line numbers.
+class LineReader {
+  public:
+    explicit LineReader(std::string_view text, std::size_t first_line = 1) noexcept
+        : m_text(text), m_line_number(first_line - 1)
+    {}
+
+    /// Reads the next line (without the terminator); returns `false` at the end.
+    [[nodiscard]] auto next(std::string_view& line) noexcept -> bool
+    {
+        if (m_pos >= m_text.size()) {
+            return false;
+        }
+        auto end = m_text.find('\n', m_pos);
+        if (end == std::string_view::npos) {
+            end = m_text.size();
+        }
+        line = m_text.substr(m_pos, end - m_pos);
+        m_pos = end + 1;
+        ++m_line_number;
+        return true;
+    }
+
+    [[nodiscard]] auto line_number() const noexcept -> std::size_t { return m_line_number; }
+
+  private:
+    std::string_view m_text;
+    std::size_t m_pos = 0;
+    std::size_t m_line_number;
+};
+
+/// Splits a line into blank-separated fields. Returns the number of fields found,
+/// stopping at `N + 1` so that callers can detect trailing garbage.
+template <std::size_t N>
+[[nodiscard]] auto split_fields(std::string_view line, std::array<std::string_view, N>& fields) noexcept
+    -> std::size_t
+{
+    std::size_t count = 0;
+    std::size_t pos = 0;
+    while (true) {
+        while (pos < line.size() && is_blank(line[pos])) {
+            ++pos;
+        }
+        if (pos == line.size()) {
+            return count;
+        }
+        if (count == N) {
+            return N + 1;
+        }
+        auto begin = pos;
+        while (pos < line.size() && !is_blank(line[pos])) {
+            ++pos;
+        }
+        fields[count++] = line.substr(begin, pos - begin);
+    }
+}
+
+}  // namespace eval_metrics::detail
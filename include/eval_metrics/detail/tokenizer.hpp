@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "eval_metrics/detail/simd_scan.hpp"
+
+namespace eval_metrics::detail {
+
+/// Splits a text into lines of blank-separated fields, 64 bytes at a time.
+///
+/// Each block is classified with the SIMD scanner selected at runtime, and field
+/// starts, field ends and newlines are then extracted from the bit masks, so the
+/// bytes inside fields are never looked at one by one. Separators follow `is_blank`:
+/// spaces and tabs are interchangeable, and the `\r` of CRLF line ends is ignored.
+class FieldTokenizer {
+  public:
+    explicit FieldTokenizer(
+        std::string_view text, std::size_t first_line = 1, BlockScanner scan = block_scanner()) noexcept
+        : m_text(text), m_scan(scan), m_line_number(first_line - 1)
+    {
+        load_block();
+    }
+
+    /// Reads the fields of the next line into `fields` and their number into `count`,
+    /// which stops at `N + 1` when the line has more fields than fit. Blank lines have
+    /// no fields. Returns `false` at the end of the text.
+    template <std::size_t N>
+    [[nodiscard]] auto next(std::array<std::string_view, N>& fields, std::size_t& count) noexcept
+        -> bool
+    {
+        if (m_pos >= m_text.size()) {
+            return false;
+        }
+        m_line_begin = m_pos;
+        ++m_line_number;
+        count = 0;
+        auto emit = [&](std::size_t end) {
+            if (count < N) {
+                fields[count] = m_text.substr(m_field_begin, end - m_field_begin);
+            }
+            count += count <= N ? 1 : 0;
+        };
+        while (true) {
+            auto events = m_starts | m_ends | m_newlines;
+            while (events != 0) {
+                auto bit = events & (~events + 1);
+                auto pos = m_block + static_cast<std::size_t>(std::countr_zero(events));
+                events ^= bit;
+                if ((m_starts & bit) != 0) {
+                    m_field_begin = pos;
+                } else {
+                    if ((m_ends & bit) != 0) {
+                        emit(pos);
+                    }
+                    if ((m_newlines & bit) != 0) {
+                        m_starts &= ~(bit | (bit - 1));
+                        m_ends &= ~(bit | (bit - 1));
+                        m_newlines &= ~(bit | (bit - 1));
+                        m_pos = pos + 1;
+                        return true;
+                    }
+                }
+            }
+            m_block += 64;
+            if (m_block >= m_text.size()) {
+                // The last line has no newline; a field still open ends with the text.
+                if (m_open) {
+                    emit(m_text.size());
+                    m_open = false;
+                }
+                m_starts = m_ends = m_newlines = 0;
+                m_pos = m_text.size();
+                return true;
+            }
+            load_block();
+        }
+    }
+
+    /// 1-based number of the line last read.
+    [[nodiscard]] auto line_number() const noexcept -> std::size_t { return m_line_number; }
+
+    /// Offset of the beginning of the line last read.
+    [[nodiscard]] auto line_begin() const noexcept -> std::size_t { return m_line_begin; }
+
+    /// Offset just past the line last read, including its newline.
+    [[nodiscard]] auto position() const noexcept -> std::size_t { return m_pos; }
+
+  private:
+    void load_block() noexcept
+    {
+        if (m_block >= m_text.size()) {
+            return;
+        }
+        char const* block = m_text.data() + m_block;
+        std::array<char, 64> tail;
+        if (m_text.size() - m_block < 64) {
+            // Pad with blanks so that a trailing field ends at the end of the text.
+            tail.fill(' ');
+            std::memcpy(tail.data(), block, m_text.size() - m_block);
+            block = tail.data();
+        }
+        auto masks = m_scan(block);
+        auto inside = ~(masks.blanks | masks.newlines);
+        auto previous = (inside << 1U) | static_cast<std::uint64_t>(m_carry);
+        m_carry = (inside >> 63U) != 0;
+        m_starts = inside & ~previous;
+        m_ends = ~inside & previous;
+        m_newlines = masks.newlines;
+        // Whether a field is still open at the end of this block.
+        m_open = m_carry;
+    }
+
+    std::string_view m_text;
+    BlockScanner m_scan;
+    std::size_t m_block = 0;
+    std::uint64_t m_starts = 0;
+    std::uint64_t m_ends = 0;
+    std::uint64_t m_newlines = 0;
+    bool m_carry = false;
+    bool m_open = false;
+    std::size_t m_field_begin = 0;
+    std::size_t m_pos = 0;
+    std::size_t m_line_begin = 0;
+    std::size_t m_line_number;
+};
+
+}  // namespace eval_metrics::detail
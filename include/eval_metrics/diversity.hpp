@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/dcg.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace eval_metrics {
+
+/// The intents a document is relevant to, one bit per intent of its query.
+using IntentMask = std::uint64_t;
+
+/// A judgment of a document for one intent of its query.
+struct IntentJudgment {
+    /// Position of the intent in `IntentQrels::intents`.
+    std::uint32_t intent;
+    std::int32_t grade;
+};
+
+/// Judgments of the intents (subtopics) of each query, in the TREC diversity qrels
+/// format: `qid intent docno grade`.
+///
+/// The judged documents of each query, with their highest grade over its intents, form
+/// regular `Qrels` (see `documents`), whose dictionary runs resolve their documents
+/// against; the intent judgments of each document follow it. Like `Qrels`, the IDs are
+/// views into the underlying `Buffer`.
+class IntentQrels {
+  public:
+    /// Intents of a query are tracked as the bits of an `IntentMask`.
+    static constexpr std::size_t max_intents = 64;
+
+    /// Maps and loads a diversity qrels file, possibly gzip- or zstd-compressed; unlike
+    /// `Qrels::from_file`, a compressed file is decompressed whole before it is parsed.
+    /// Throws `IoError` or `ParseError`.
+    [[nodiscard]] static auto from_file(std::filesystem::path const& path) -> IntentQrels;
+
+    /// Parses diversity qrels text held by `buffer`. Throws `ParseError`, also for a
+    /// query with more than `max_intents` intents.
+    [[nodiscard]] static auto parse(std::shared_ptr<Buffer const> buffer) -> IntentQrels;
+
+    /// The judged documents of each query, with their highest grade.
+    [[nodiscard]] auto documents() const noexcept -> Qrels const& { return m_documents; }
+    [[nodiscard]] auto dictionary() const noexcept -> std::shared_ptr<DocDictionary const> const&
+    {
+        return m_documents.dictionary();
+    }
+    [[nodiscard]] auto num_queries() const noexcept -> std::size_t { return m_documents.num_queries(); }
+    [[nodiscard]] auto query_id(std::size_t query) const noexcept -> std::string_view
+    {
+        return m_documents.query_id(query);
+    }
+    [[nodiscard]] auto find_query(std::string_view query_id) const noexcept -> std::optional<std::size_t>
+    {
+        return m_documents.find_query(query_id);
+    }
+
+    /// Labels of the query's intents, in increasing order.
+    [[nodiscard]] auto intents(std::size_t query) const noexcept -> std::span<std::string_view const>
+    {
+        return std::span<std::string_view const>(m_intents)
+            .subspan(m_intent_offsets[query], m_intent_offsets[query + 1] - m_intent_offsets[query]);
+    }
+
+    /// Intent judgments of the document at position `doc` of
+    /// `documents().judgments(query)`, by increasing intent.
+    [[nodiscard]] auto judgments(std::size_t query, std::size_t doc) const noexcept
+        -> std::span<IntentJudgment const>
+    {
+        auto first = m_judgment_offsets[m_doc_offsets[query] + doc];
+        auto last = m_judgment_offsets[m_doc_offsets[query] + doc + 1];
+        return std::span<IntentJudgment const>(m_judgments).subspan(first, last - first);
+    }
+
+  private:
+    explicit IntentQrels(Qrels documents) : m_documents(std::move(documents)) {}
+
+    Qrels m_documents;
+    /// Start of each query's documents among all the documents, plus the end.
+    std::vector<std::size_t> m_doc_offsets;
+    /// Start of each document's intent judgments, plus the end.
+    std::vector<std::size_t> m_judgment_offsets;
+    std::vector<IntentJudgment> m_judgments;
+    std::vector<std::size_t> m_intent_offsets;
+    std::vector<std::string_view> m_intents;
+};
+
+struct DiversityOptions {
+    /// Minimum grade of a document relevant to an intent.
+    std::int32_t relevance_level = 1;
+    /// Redundancy penalty: each document relevant to an intent already covered `c` times
+    /// gains only `(1 - alpha)^c` for it. Also the stop probability of ERR-IA.
+    double alpha = 0.5;
+    /// Persistence of NRBP.
+    double beta = 0.5;
+    /// Cutoffs of alpha-nDCG, ERR-IA and subtopic recall.
+    std::vector<std::size_t> cutoffs{5, 10, 20};
+    /// Also evaluate judged queries missing from the run, as empty rankings.
+    bool complete = false;
+};
+
+/// Evaluates the diversity of rankings against intent judgments, with the measures of
+/// the TREC Web track's `ndeval`: at each cutoff, ERR-IA (`ERR-IA@k`, intent-aware ERR
+/// with stop probability `alpha` at each relevant document), alpha-nDCG
+/// (`alpha-nDCG@k`) and subtopic recall (`strec@k`), and NRBP over the whole ranking.
+/// Intents are weighted equally, and only those with a relevant document count.
+///
+/// Each ranked document is looked up once into the mask of the intents it is relevant
+/// to; a single pass over the masks then keeps the number of times each intent was
+/// covered and accumulates every measure. alpha-nDCG divides by the alpha-DCG of the
+/// greedy ideal ranking, which picks the document of highest novel gain at each rank
+/// and only updates the gains of the documents sharing an intent with it. It is built
+/// once per query, as deep as the deepest cutoff, when the evaluator is constructed,
+/// and shared by every run evaluated.
+class DiversityEvaluator {
+  public:
+    /// Builds the intent masks and the ideal rankings. Throws `Error` for a zero cutoff.
+    explicit DiversityEvaluator(IntentQrels const& qrels, DiversityOptions options = {});
+
+    [[nodiscard]] auto metrics() const noexcept -> std::span<MetricInfo const> { return m_metrics; }
+    [[nodiscard]] auto qrels() const noexcept -> IntentQrels const& { return *m_qrels; }
+    [[nodiscard]] auto options() const noexcept -> DiversityOptions const& { return m_options; }
+
+    /// Number of intents of the query with a relevant document.
+    [[nodiscard]] auto num_intents(std::size_t query) const noexcept -> std::size_t
+    {
+        return m_num_intents[query];
+    }
+
+    /// alpha-DCG of the first `i` documents of the query's greedy ideal ranking, for
+    /// `i` from 0 to the deepest cutoff or the number of relevant documents.
+    [[nodiscard]] auto ideal_alpha_dcg(std::size_t query) const noexcept -> std::span<double const>
+    {
+        return std::span<double const>(m_ideal_dcg)
+            .subspan(m_ideal_offsets[query], m_ideal_offsets[query + 1] - m_ideal_offsets[query]);
+    }
+
+    /// Writes the metric values of one query's ranking to `values` (see
+    /// `Evaluator::evaluate_query`). Returns `false` if the query has no judgments.
+    auto evaluate_query(std::string_view query_id, RankingView ranking, std::span<double> values) const -> bool;
+
+    /// Evaluates every query of the run that has judgments.
+    [[nodiscard]] auto evaluate(Run const& run) const -> Results;
+
+  private:
+    /// Per-query arrays, reused from one query to the next by each evaluation.
+    struct Scratch {
+        std::vector<IntentMask> masks;
+        std::array<std::uint32_t, IntentQrels::max_intents> covered{};
+        std::vector<double> alpha_dcg_at;
+        std::vector<double> err_at;
+        std::vector<IntentMask> coverage_at;
+        /// Novel gain of each candidate of the ideal ranking being built, -1 once taken.
+        std::vector<double> gains;
+    };
+
+    /// Sum over the intents of `mask` of `(1 - alpha)^c`, `c` the times the intent was
+    /// covered, counting this one in `covered`.
+    [[nodiscard]] auto novel_gain(IntentMask mask, std::span<std::uint32_t, IntentQrels::max_intents> covered) const
+        noexcept -> double;
+
+    void mask_column(std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch) const;
+
+    void evaluate_ranking(
+        std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch, std::span<double> values) const;
+
+    void build_ideal(std::size_t query, std::size_t depth, Scratch& scratch);
+
+    IntentQrels const* m_qrels;
+    DiversityOptions m_options;
+    std::vector<MetricInfo> m_metrics;
+    DiscountTable m_discounts;
+    /// `(1 - alpha)^c` for the first counts.
+    std::vector<double> m_novelty;
+    /// Intent mask of each judged document, numbered as in `IntentQrels`.
+    std::vector<IntentMask> m_masks;
+    std::vector<std::size_t> m_doc_offsets;
+    std::vector<std::size_t> m_num_intents;
+    std::vector<std::size_t> m_ideal_offsets;
+    std::vector<double> m_ideal_dcg;
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace eval_metrics {
+
+/// ID of documents that are not in the dictionary, i.e., judged in no query.
+inline constexpr std::uint32_t unjudged_doc = std::numeric_limits<std::uint32_t>::max();
+
+/// ID of documents that have not been looked up in any dictionary yet.
+inline constexpr std::uint32_t unresolved_doc = unjudged_doc - 1;
+
+/// Interns the judged document IDs of a qrels as dense integers.
+///
+/// The IDs follow the byte-wise order of the strings, so a query's judgments sorted by
+/// document are also sorted by ID. Runs resolve their documents through the dictionary
+/// once, at parse time; documents that were never judged map to `unjudged_doc` and are
+/// not interned. Lookups probe a flat open-addressing table.
+class DocDictionary {
+  public:
+    /// Builds the dictionary of the given distinct documents, sorted byte-wise.
+    explicit DocDictionary(std::vector<std::string_view> sorted_docs);
+
+    /// Builds the dictionary of the documents in any order, with repetitions.
+    [[nodiscard]] static auto from_docs(std::vector<std::string_view> docs) -> DocDictionary;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_docs.size(); }
+
+    /// All documents, in ID order.
+    [[nodiscard]] auto docs() const noexcept -> std::span<std::string_view const> { return m_docs; }
+
+    [[nodiscard]] auto doc(std::uint32_t id) const noexcept -> std::string_view
+    {
+        return m_docs[id];
+    }
+
+    /// ID of the document, or `unjudged_doc` if it is not in the dictionary.
+    [[nodiscard]] auto lookup(std::string_view doc) const noexcept -> std::uint32_t;
+
+  private:
+    std::vector<std::string_view> m_docs;
+    /// Each slot holds the upper half of the hash and the ID, or `empty_slot`.
+    std::vector<std::uint64_t> m_slots;
+    std::uint64_t m_mask = 0;
+};
+
+}  // namespace eval_metrics
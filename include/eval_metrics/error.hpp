@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace eval_metrics {
+
+/// Base class of all exceptions thrown by the library.
+class Error : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/// Failure to open, map, or read an input file.
+class IoError : public Error {
+  public:
+    using Error::Error;
+};
+
+/// Malformed input; carries the 1-based line number when it is known.
+class ParseError : public Error {
+  public:
+    ParseError(std::string const& message, std::size_t line = 0)
+        : Error(line == 0 ? message : "line " + std::to_string(line) + ": " + message),
+          m_line(line)
+    {}
+
+    [[nodiscard]] auto line() const noexcept -> std::size_t { return m_line; }
+
+  private:
+    std::size_t m_line;
+};
+
+/// A streamed run whose lines are not grouped by query: a query ID reappears after
+/// lines of another query.
+class UngroupedRunError : public ParseError {
+  public:
+    using ParseError::ParseError;
+};
+
+}  // namespace eval_metrics
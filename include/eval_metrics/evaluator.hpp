@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/grade_index.hpp"
+#include "eval_metrics/metrics.hpp"
+#include "eval_metrics/plan.hpp"
+#include "eval_metrics/prefix.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+#include "eval_metrics/run_stream.hpp"
+
+namespace eval_metrics {
+
+struct EvaluationOptions {
+    /// Minimum grade of a relevant document (`trec_eval -l`).
+    std::int32_t relevance_level = 1;
+    /// Also evaluate judged queries missing from the run, as empty rankings (`trec_eval -c`).
+    bool complete = false;
+    /// Evaluate the condensed rankings, from which unjudged documents are dropped
+    /// (`trec_eval -J`; see `condense`).
+    bool condensed = false;
+    /// Thresholds of the per-query grade lookup tables.
+    GradeIndexOptions lookup;
+    /// Specifications of the measures to compute (see `EvaluationPlan`), e.g. `map`,
+    /// `P.10` or `ndcg_cut.5,10`; the standard measures if empty.
+    std::vector<std::string> measures;
+    /// Stop probabilities of ERR; the highest grade defaults to that of the qrels.
+    CascadeOptions cascade;
+};
+
+/// Per-query metric values, one row per evaluated query in query ID order.
+class Results {
+  public:
+    explicit Results(std::vector<MetricInfo> metrics);
+
+    [[nodiscard]] auto metrics() const noexcept -> std::span<MetricInfo const> { return m_metrics; }
+    [[nodiscard]] auto num_queries() const noexcept -> std::size_t { return m_query_ids.size(); }
+
+    [[nodiscard]] auto query_id(std::size_t query) const noexcept -> std::string const&
+    {
+        return m_query_ids[query];
+    }
+
+    [[nodiscard]] auto values(std::size_t query) const noexcept -> std::span<double const>
+    {
+        return std::span<double const>(m_values).subspan(query * m_metrics.size(), m_metrics.size());
+    }
+
+    /// Appends the row of a query; `values` must have one entry per metric.
+    void add(std::string query_id, std::span<double const> values);
+
+    /// Reorders the rows by query ID, the order `trec_eval` reports them in.
+    void sort_by_query();
+
+    /// Summary values over all queries, aggregated as each metric prescribes.
+    [[nodiscard]] auto aggregate() const -> std::vector<double>;
+
+  private:
+    std::vector<MetricInfo> m_metrics;
+    std::vector<std::string> m_query_ids;
+    std::vector<double> m_values;
+};
+
+/// Evaluates rankings against a set of judgments.
+///
+/// Computes the measures of `EvaluationOptions::measures`, compiled once into an
+/// `EvaluationPlan`, by default the standard `trec_eval` ones.
+class Evaluator {
+  public:
+    /// Indexes the judgments for lookup and compiles the measures once; the evaluator
+    /// can then be shared by threads evaluating different runs. Throws `Error` for an
+    /// invalid measure.
+    explicit Evaluator(Qrels const& qrels, EvaluationOptions options = {});
+
+    [[nodiscard]] auto metrics() const noexcept -> std::span<MetricInfo const> { return m_plan.metrics(); }
+    [[nodiscard]] auto plan() const noexcept -> EvaluationPlan const& { return m_plan; }
+    [[nodiscard]] auto qrels() const noexcept -> Qrels const& { return *m_qrels; }
+    [[nodiscard]] auto options() const noexcept -> EvaluationOptions const& { return m_options; }
+
+    /// Number of leading ranks whose order the selected metrics depend on: rankings
+    /// only need to be sorted that deep (see `RunParseOptions::depth`).
+    [[nodiscard]] auto required_depth() const noexcept -> std::size_t { return m_depth; }
+
+    /// Writes the metric values of one query's ranking (in evaluation order) to `values`.
+    /// Document IDs other than `unresolved_doc` must come from the qrels' dictionary;
+    /// unresolved documents are looked up by name. Returns `false`, leaving `values`
+    /// untouched, if the query has no judgments.
+    auto evaluate_query(std::string_view query_id, RankingView ranking, std::span<double> values) const
+        -> bool;
+
+    /// Computes the prefix sums of one query's ranking (see `evaluate_query`), from which
+    /// P, recall, nDCG and success are read at any cutoff. Returns `false`, leaving
+    /// `sums` untouched, if the query has no judgments.
+    auto prefix_sums(std::string_view query_id, RankingView ranking, PrefixSums& sums) const -> bool;
+
+    /// Evaluates every query of the run that has judgments.
+    [[nodiscard]] auto evaluate(Run const& run) const -> Results;
+
+    /// Evaluates a run query by query as it is read, holding one ranking at a time.
+    /// Produces the same results as evaluating the fully loaded run.
+    [[nodiscard]] auto evaluate(RunStream& stream) const -> Results;
+
+  private:
+    /// Per-query arrays, reused from one query to the next by each evaluation.
+    struct Scratch {
+        explicit Scratch(EvaluationPlan const& plan) : workspace(plan) {}
+
+        std::vector<std::uint32_t> ids;
+        /// The gain column: grades of the ranked documents, in ranking order.
+        std::vector<std::int32_t> grades;
+        EvaluationPlan::Workspace workspace;
+    };
+
+    /// Fills `scratch.grades` with the gain column of the ranking of the qrels query at
+    /// position `query`, condensed if the options say so. Document IDs are used as is if `trust_ids` and resolved, and
+    /// looked up by name otherwise.
+    void gain_column(std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch) const;
+
+    /// Evaluates the ranking of the qrels query at position `query` (see `gain_column`).
+    void evaluate_ranking(
+        std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch, std::span<double> values) const;
+
+    /// Whether IDs resolved against `dictionary` can be used as qrels IDs.
+    [[nodiscard]] auto is_own(std::shared_ptr<DocDictionary const> const& dictionary) const noexcept
+        -> bool;
+
+    Qrels const* m_qrels;
+    EvaluationOptions m_options;
+    GradeIndex m_grades;
+    EvaluationPlan m_plan;
+    std::size_t m_depth = 0;
+};
+
+/// Writes results in the `trec_eval` text format: `measure <TAB> qid <TAB> value`, with
+/// the per-query rows first if requested, then the `all` summary.
+void write_trec(std::ostream& os, Results const& results, std::string_view run_tag, bool per_query);
+
+}  // namespace eval_metrics
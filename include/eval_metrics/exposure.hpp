@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/doc_dictionary.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/qrels.hpp"
+
+namespace eval_metrics {
+
+/// Many sampled rankings of each query over a fixed set of candidate documents, as
+/// produced by stochastic rankers (e.g. Plackett-Luce samples), in a compact text
+/// format that names each candidate once and each sample by candidate positions:
+///
+///     qid D docno          the next candidate of the query (positions count from 0)
+///     qid S 3 0 7 1 ...    one sampled ranking, as candidate positions from the top
+///
+/// A sample of 100 documents takes one short line instead of 100 run lines. Queries are
+/// ordered by ID; the lines of a query need not be contiguous, but a sample may only
+/// name candidates declared before it, each at most once.
+class SampledRuns {
+  public:
+    /// Maps and loads a sampled runs file, possibly gzip- or zstd-compressed (and then
+    /// decompressed whole before it is parsed). Candidates are resolved against
+    /// `dictionary`, if any. Throws `IoError` or `ParseError`.
+    [[nodiscard]] static auto from_file(
+        std::filesystem::path const& path, std::shared_ptr<DocDictionary const> dictionary = nullptr)
+        -> SampledRuns;
+
+    /// Parses sampled runs held by `buffer`. Throws `ParseError`, also for a sample
+    /// that repeats a candidate position.
+    [[nodiscard]] static auto parse(
+        std::shared_ptr<Buffer const> buffer, std::shared_ptr<DocDictionary const> dictionary = nullptr)
+        -> SampledRuns;
+
+    [[nodiscard]] auto num_queries() const noexcept -> std::size_t { return m_query_ids.size(); }
+    [[nodiscard]] auto query_id(std::size_t query) const noexcept -> std::string_view
+    {
+        return m_query_ids[query];
+    }
+    [[nodiscard]] auto dictionary() const noexcept -> std::shared_ptr<DocDictionary const> const&
+    {
+        return m_dictionary;
+    }
+
+    /// Candidate documents of the query, in declaration order.
+    [[nodiscard]] auto candidates(std::size_t query) const noexcept -> std::span<std::string_view const>
+    {
+        return std::span<std::string_view const>(m_candidates)
+            .subspan(m_candidate_offsets[query], m_candidate_offsets[query + 1] - m_candidate_offsets[query]);
+    }
+
+    /// Dictionary IDs of the query's candidates, `unresolved_doc` without a dictionary.
+    [[nodiscard]] auto candidate_ids(std::size_t query) const noexcept -> std::span<std::uint32_t const>
+    {
+        return std::span<std::uint32_t const>(m_candidate_ids)
+            .subspan(m_candidate_offsets[query], m_candidate_offsets[query + 1] - m_candidate_offsets[query]);
+    }
+
+    [[nodiscard]] auto num_samples(std::size_t query) const noexcept -> std::size_t
+    {
+        return m_sample_offsets[query + 1] - m_sample_offsets[query];
+    }
+
+    /// Candidate positions of the query's sample `sample`, from the top.
+    [[nodiscard]] auto sample(std::size_t query, std::size_t sample) const noexcept
+        -> std::span<std::uint32_t const>
+    {
+        auto idx = m_sample_offsets[query] + sample;
+        return std::span<std::uint32_t const>(m_positions)
+            .subspan(m_sample_starts[idx], m_sample_starts[idx + 1] - m_sample_starts[idx]);
+    }
+
+  private:
+    SampledRuns() = default;
+
+    std::shared_ptr<Buffer const> m_buffer;
+    std::shared_ptr<DocDictionary const> m_dictionary;
+    std::vector<std::string_view> m_query_ids;
+    std::vector<std::size_t> m_candidate_offsets;
+    std::vector<std::string_view> m_candidates;
+    std::vector<std::uint32_t> m_candidate_ids;
+    /// Start of each query's samples in `m_sample_starts`, plus the end.
+    std::vector<std::size_t> m_sample_offsets;
+    /// Start of each sample in `m_positions`, plus the end.
+    std::vector<std::size_t> m_sample_starts;
+    std::vector<std::uint32_t> m_positions;
+};
+
+/// Groups that documents are attributed to, such as their authors' demographics, read
+/// from lines `docno group`; a document listed with several groups counts for each.
+class DocumentGroups {
+  public:
+    /// Maps and loads a group file, possibly gzip- or zstd-compressed (and then
+    /// decompressed whole before it is parsed). Throws `IoError` or `ParseError`.
+    [[nodiscard]] static auto from_file(std::filesystem::path const& path) -> DocumentGroups;
+
+    /// Parses group attributions held by `buffer`. Throws `ParseError`.
+    [[nodiscard]] static auto parse(std::shared_ptr<Buffer const> buffer) -> DocumentGroups;
+
+    [[nodiscard]] auto num_groups() const noexcept -> std::size_t { return m_names.size(); }
+    /// Names of the groups, in increasing order.
+    [[nodiscard]] auto names() const noexcept -> std::span<std::string_view const> { return m_names; }
+
+    /// Positions in `names()` of the groups of `doc`; empty if it has none.
+    [[nodiscard]] auto groups(std::string_view doc) const noexcept -> std::span<std::uint32_t const>;
+
+  private:
+    DocumentGroups() = default;
+
+    std::shared_ptr<Buffer const> m_buffer;
+    std::vector<std::string_view> m_names;
+    /// Documents in increasing order, each with the start of its groups, plus the end.
+    std::vector<std::string_view> m_docs;
+    std::vector<std::size_t> m_offsets;
+    std::vector<std::uint32_t> m_groups;
+};
+
+struct ExposureOptions {
+    /// Minimum grade of a relevant document.
+    std::int32_t relevance_level = 1;
+    /// Patience of the browsing model: the document at 0-based rank `r` is seen with
+    /// probability `patience^r`, as in RBP.
+    double patience = 0.5;
+};
+
+/// Evaluates stochastic rankings by expected exposure (Diaz et al., 2020): the exposure
+/// of each document, averaged over the sampled rankings of its query, is compared with
+/// its target exposure, the exposure it would get if the relevant documents were
+/// ranked by grade with ties shuffled (the average exposure of the ranks their grade
+/// occupies). Unlike Diaz et al., who share the exposure of the ranks below the
+/// relevant documents among the non-relevant candidates, non-relevant and unjudged
+/// documents get a target of zero: the targets then depend on the judgments alone, not
+/// on how many candidates a run has, and the exposure left to them counts as loss.
+/// Each query yields
+///
+///  - `EE-L`: the squared distance between the exposure and target exposure vectors;
+///  - `EE-D`: the squared norm of the exposure vector, its disparity;
+///  - `EE-R`: the dot product of the two vectors, its relevance;
+///
+/// so that `EE-L = EE-D - 2 EE-R + |target|^2`. With document groups, the same three
+/// measures of the groups' summed exposures follow (`EE-L_group` and so on).
+///
+/// Per sample, the loop only adds the exposure of each rank, precomputed, to the
+/// accumulator of the candidate at that rank; the relevance of the candidates is
+/// looked up once per query.
+class ExposureEvaluator {
+  public:
+    /// Computes the target exposures of each query; `groups`, if given, must outlive
+    /// the evaluator.
+    explicit ExposureEvaluator(
+        Qrels const& qrels, ExposureOptions options = {}, DocumentGroups const* groups = nullptr);
+
+    [[nodiscard]] auto metrics() const noexcept -> std::span<MetricInfo const> { return m_metrics; }
+    [[nodiscard]] auto qrels() const noexcept -> Qrels const& { return *m_qrels; }
+    [[nodiscard]] auto options() const noexcept -> ExposureOptions const& { return m_options; }
+
+    /// Target exposure of the query's judgment at position `doc` of
+    /// `qrels().judgments(query)`.
+    [[nodiscard]] auto target(std::size_t query, std::size_t doc) const noexcept -> double
+    {
+        return m_targets[m_qrels_offsets[query] + doc];
+    }
+
+    /// Evaluates every query of the sampled runs that has judgments.
+    [[nodiscard]] auto evaluate(SampledRuns const& runs) const -> Results;
+
+  private:
+    /// Per-query arrays, reused from one query to the next.
+    struct Scratch {
+        std::vector<double> exposure;
+        std::vector<double> weights;
+        /// Position of each candidate among the query's judgments, or `no_judgment`.
+        std::vector<std::size_t> judgment;
+        std::vector<bool> seen;
+        std::vector<double> group_exposure;
+        std::vector<double> group_target;
+    };
+
+    static constexpr std::size_t no_judgment = static_cast<std::size_t>(-1);
+
+    void evaluate_query(std::size_t query, SampledRuns const& runs, std::size_t run_query, Scratch& scratch,
+                        std::span<double> values) const;
+
+    Qrels const* m_qrels;
+    ExposureOptions m_options;
+    DocumentGroups const* m_groups;
+    std::vector<MetricInfo> m_metrics;
+    /// Start of each query's judgments, plus the end.
+    std::vector<std::size_t> m_qrels_offsets;
+    std::vector<double> m_targets;
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "eval_metrics/dcg.hpp"
+#include "eval_metrics/metrics.hpp"
+
+namespace eval_metrics {
+
+/// Whole-ranking totals of a `fused_pass`.
+struct FusedTotals {
+    /// Number of relevant documents retrieved.
+    std::size_t relevant = 0;
+    /// Number of relevant documents among the first `num_rel` retrieved.
+    std::size_t relevant_at_num_rel = 0;
+    /// 1-based rank of the first relevant document, or 0.
+    std::size_t first_relevant = 0;
+    /// Sum of the precision at each relevant rank.
+    double precision_sum = 0.0;
+    /// DCG of the whole ranking.
+    double dcg = 0.0;
+};
+
+/// Inputs and outputs of the cascade measures of a `fused_pass`: ERR at each cutoff
+/// and over the whole ranking, and RBP and its residual for each persistence.
+struct FusedCascade {
+    /// See `stop_probability`.
+    std::span<double const> stop_probabilities;
+    std::span<double const> persistences;
+    /// ERR at each cutoff of the pass.
+    std::span<double> err_at;
+    double err = 0.0;
+    /// RBP and its residual for each persistence; the pass also uses them as running sums.
+    std::span<double> rbp;
+    std::span<double> rbp_residual;
+    /// `p^rank` for each persistence, as the pass goes.
+    std::span<double> weights;
+};
+
+/// Inputs and outputs of the incomplete-judgment measures of a `fused_pass`: the number
+/// of judged documents at each cutoff and over the whole ranking, bpref and infAP.
+struct FusedIncomplete {
+    /// Number of judged non-relevant documents of the query (see `bpref`).
+    std::size_t num_nonrel = 0;
+    /// Number of judged documents at each cutoff of the pass.
+    std::span<std::size_t> judged_at;
+    std::size_t judged = 0;
+    double bpref = 0.0;
+    double infap = 0.0;
+};
+
+/// Accumulates, in a single pass over the gain column, everything `average_precision`,
+/// `r_precision`, `reciprocal_rank`, `relevant_retrieved`, `precision`, `recall`, `dcg`
+/// and `ndcg` need, instead of one pass per metric and cutoff. For each of the
+/// increasing `cutoffs`, `relevant_at` receives the number of relevant documents and
+/// `dcg_at` the DCG at that cutoff. Every sum is accumulated in the order of the
+/// reference functions, so the metrics derived below are identical to theirs. Without
+/// `WithDcg`, the DCG is not accumulated and `dcg_at` is not written. Discounts are
+/// read from `discounts`, which holds the same values `dcg` computes. `WithCascade`
+/// also accumulates the cascade measures of `cascade`, as `expected_reciprocal_rank`,
+/// `rank_biased_precision` and `rbp_residual` do, and `WithIncomplete` the measures of
+/// `incomplete`, as `judged_retrieved`, `bpref` and `inferred_average_precision` do.
+template <bool WithDcg = true, bool WithCascade = false, bool WithIncomplete = false>
+inline void fused_pass(
+    std::span<std::int32_t const> grades,
+    std::size_t num_rel,
+    std::int32_t relevance_level,
+    std::span<std::size_t const> cutoffs,
+    std::span<std::size_t> relevant_at,
+    std::span<double> dcg_at,
+    FusedTotals& totals,
+    DiscountTable const& discounts = DiscountTable::standard(),
+    FusedCascade* cascade = nullptr,
+    FusedIncomplete* incomplete = nullptr) noexcept
+{
+    totals = {};
+    std::size_t cutoff = 0;
+    std::size_t found = 0;
+    double dcg = 0.0;
+    double err = 0.0;
+    double not_stopped = 1.0;
+    std::size_t judged = 0;
+    std::size_t judged_rel = 0;
+    std::size_t judged_nonrel = 0;
+    std::size_t unsampled = 0;
+    double bpref = 0.0;
+    double infap = 0.0;
+    if constexpr (WithCascade) {
+        std::fill(cascade->rbp.begin(), cascade->rbp.end(), 0.0);
+        std::fill(cascade->rbp_residual.begin(), cascade->rbp_residual.end(), 0.0);
+        std::fill(cascade->weights.begin(), cascade->weights.end(), 1.0);
+    }
+    for (std::size_t rank = 0; rank < grades.size(); ++rank) {
+        for (; cutoff < cutoffs.size() && cutoffs[cutoff] == rank; ++cutoff) {
+            relevant_at[cutoff] = found;
+            if constexpr (WithDcg) {
+                dcg_at[cutoff] = dcg;
+            }
+            if constexpr (WithCascade) {
+                cascade->err_at[cutoff] = err;
+            }
+            if constexpr (WithIncomplete) {
+                incomplete->judged_at[cutoff] = judged;
+            }
+        }
+        if (rank == num_rel) {
+            totals.relevant_at_num_rel = found;
+        }
+        auto grade = grades[rank];
+        if (WithDcg && grade > 0) {
+            dcg += static_cast<double>(grade) / discounts.log2_rank(rank);
+        }
+        if (is_relevant(grade, relevance_level)) {
+            ++found;
+            totals.precision_sum += static_cast<double>(found) / static_cast<double>(rank + 1);
+            if (totals.first_relevant == 0) {
+                totals.first_relevant = rank + 1;
+            }
+        }
+        if constexpr (WithCascade) {
+            auto stop = stop_probability(grade, cascade->stop_probabilities);
+            err += not_stopped * stop / static_cast<double>(rank + 1);
+            not_stopped *= 1.0 - stop;
+            for (std::size_t idx = 0; idx < cascade->persistences.size(); ++idx) {
+                auto& weight = cascade->weights[idx];
+                if (is_relevant(grade, relevance_level)) {
+                    cascade->rbp[idx] += weight;
+                }
+                if (grade == unjudged) {
+                    cascade->rbp_residual[idx] += weight;
+                }
+                weight *= cascade->persistences[idx];
+            }
+        }
+        if constexpr (WithIncomplete) {
+            if (grade != unjudged) {
+                ++judged;
+                if (grade < 0) {
+                    ++unsampled;
+                } else if (grade < relevance_level) {
+                    ++judged_nonrel;
+                } else {
+                    bpref += judged_nonrel == 0
+                        ? 1.0
+                        : 1.0 - static_cast<double>(std::min(judged_nonrel, num_rel))
+                                / static_cast<double>(std::min(num_rel, incomplete->num_nonrel));
+                    infap += inferred_precision(rank, judged_rel, judged_nonrel, unsampled);
+                    ++judged_rel;
+                }
+            }
+        }
+    }
+    for (; cutoff < cutoffs.size(); ++cutoff) {
+        relevant_at[cutoff] = found;
+        if constexpr (WithDcg) {
+            dcg_at[cutoff] = dcg;
+        }
+        if constexpr (WithCascade) {
+            cascade->err_at[cutoff] = err;
+        }
+        if constexpr (WithIncomplete) {
+            incomplete->judged_at[cutoff] = judged;
+        }
+    }
+    if constexpr (WithIncomplete) {
+        incomplete->judged = judged;
+        incomplete->bpref = num_rel == 0 ? 0.0 : bpref / static_cast<double>(num_rel);
+        incomplete->infap = num_rel == 0 ? 0.0 : infap / static_cast<double>(num_rel);
+    }
+    if constexpr (WithCascade) {
+        cascade->err = err;
+        for (std::size_t idx = 0; idx < cascade->persistences.size(); ++idx) {
+            auto p = cascade->persistences[idx];
+            cascade->rbp[idx] = (1.0 - p) * cascade->rbp[idx];
+            cascade->rbp_residual[idx] = (1.0 - p) * cascade->rbp_residual[idx] + cascade->weights[idx];
+        }
+    }
+    if (num_rel >= grades.size()) {
+        totals.relevant_at_num_rel = found;
+    }
+    totals.relevant = found;
+    totals.dcg = dcg;
+}
+
+// The metrics of a fused pass, defined exactly as the reference functions.
+
+[[nodiscard]] inline auto fused_average_precision(FusedTotals const& totals, std::size_t num_rel) noexcept
+    -> double
+{
+    return num_rel == 0 ? 0.0 : totals.precision_sum / static_cast<double>(num_rel);
+}
+
+[[nodiscard]] inline auto fused_r_precision(FusedTotals const& totals, std::size_t num_rel) noexcept
+    -> double
+{
+    return num_rel == 0 ? 0.0
+                        : static_cast<double>(totals.relevant_at_num_rel) / static_cast<double>(num_rel);
+}
+
+[[nodiscard]] inline auto fused_reciprocal_rank(FusedTotals const& totals) noexcept -> double
+{
+    return totals.first_relevant == 0 ? 0.0 : 1.0 / static_cast<double>(totals.first_relevant);
+}
+
+[[nodiscard]] inline auto fused_precision(std::size_t relevant_at, std::size_t k) noexcept -> double
+{
+    return static_cast<double>(relevant_at) / static_cast<double>(k);
+}
+
+[[nodiscard]] inline auto fused_recall(std::size_t relevant_at, std::size_t num_rel) noexcept -> double
+{
+    return num_rel == 0 ? 0.0 : static_cast<double>(relevant_at) / static_cast<double>(num_rel);
+}
+
+[[nodiscard]] inline auto fused_success(std::size_t relevant_at) noexcept -> double
+{
+    return relevant_at > 0 ? 1.0 : 0.0;
+}
+
+[[nodiscard]] inline auto fused_judged(std::size_t judged_at, std::size_t k) noexcept -> double
+{
+    return static_cast<double>(judged_at) / static_cast<double>(k);
+}
+
+[[nodiscard]] inline auto fused_ndcg(double dcg, double ideal_dcg) noexcept -> double
+{
+    return ideal_dcg == 0.0 ? 0.0 : dcg / ideal_dcg;
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "eval_metrics/doc_dictionary.hpp"
+#include "eval_metrics/metrics.hpp"
+#include "eval_metrics/qrels.hpp"
+
+namespace eval_metrics {
+
+/// How the judgments of one query are laid out for grade lookups.
+enum class GradeLayout : std::uint8_t {
+    /// Document IDs in order, searched with a branchless binary search.
+    sorted,
+    /// A flat open-addressing table of document IDs, probed linearly.
+    hash,
+    /// One grade per ID between the smallest and largest judged ID.
+    dense,
+};
+
+[[nodiscard]] auto grade_layout_name(GradeLayout layout) noexcept -> char const*;
+
+/// Thresholds choosing each query's layout; `bench/lookup_bench` measures the
+/// crossovers they default to.
+struct GradeIndexOptions {
+    /// Queries whose judged IDs span at most `max_dense_span_ratio` times their number
+    /// of judgments (nearly contiguous IDs) get a dense grade array.
+    double max_dense_span_ratio = 2.0;
+    /// Otherwise, queries with at most this many judgments are binary-searched...
+    std::size_t max_sorted_size = 8;
+    /// ... and larger ones are hashed into tables at most this full.
+    double max_load_factor = 0.5;
+};
+
+/// Grades of a query's judgments, laid out for the lookup of each ranked document.
+class QueryGrades {
+  public:
+    [[nodiscard]] auto layout() const noexcept -> GradeLayout { return m_layout; }
+
+    /// Grade of the document with the given dictionary ID, or `unjudged`.
+    [[nodiscard]] auto grade(std::uint32_t id) const noexcept -> std::int32_t
+    {
+        switch (m_layout) {
+        case GradeLayout::sorted: return sorted_grade(id);
+        case GradeLayout::hash: return hashed_grade(id);
+        case GradeLayout::dense: return dense_grade(id);
+        }
+        return unjudged;
+    }
+
+    /// Writes the grade of each ID to `grades`, choosing the layout once for all.
+    void grades(std::span<std::uint32_t const> ids, std::span<std::int32_t> grades) const noexcept;
+
+  private:
+    friend class GradeIndex;
+
+    [[nodiscard]] auto sorted_grade(std::uint32_t id) const noexcept -> std::int32_t
+    {
+        if (m_size == 0) {
+            return unjudged;
+        }
+        // The comparison compiles to a conditional move: no branch to mispredict.
+        auto const* base = m_keys;
+        auto size = m_size;
+        while (size > 1) {
+            auto half = size / 2;
+            base = base[half] <= id ? base + half : base;
+            size -= half;
+        }
+        return *base == id ? m_grades[base - m_keys] : unjudged;
+    }
+
+    [[nodiscard]] auto hashed_grade(std::uint32_t id) const noexcept -> std::int32_t
+    {
+        // Empty slots hold `unjudged_doc` and an `unjudged` grade, so the probe stops at
+        // the document or at the first empty slot, and needs no other check.
+        auto slot = hash_slot(id);
+        while (m_keys[slot] != id && m_keys[slot] != unjudged_doc) {
+            slot = (slot + 1) & m_mask;
+        }
+        return m_grades[slot];
+    }
+
+    [[nodiscard]] auto dense_grade(std::uint32_t id) const noexcept -> std::int32_t
+    {
+        // IDs below the base wrap around to large offsets.
+        auto offset = id - m_base;
+        return offset < m_size ? m_grades[offset] : unjudged;
+    }
+
+    [[nodiscard]] auto hash_slot(std::uint32_t id) const noexcept -> std::size_t
+    {
+        return static_cast<std::size_t>((std::uint64_t{id} * 0x9E3779B97F4A7C15ULL) >> 32U) & m_mask;
+    }
+
+    GradeLayout m_layout = GradeLayout::sorted;
+    std::uint32_t const* m_keys = nullptr;
+    std::int32_t const* m_grades = nullptr;
+    /// Judgments (sorted), slots (hash), or grades (dense).
+    std::size_t m_size = 0;
+    std::size_t m_mask = 0;
+    std::uint32_t m_base = 0;
+};
+
+/// Per-query grade lookup tables of a qrels, each query in the layout that suits it.
+///
+/// Looking up the grade of every ranked document is the innermost loop of evaluation.
+/// Small queries fit a few cache lines of sorted IDs, large ones are hashed, and
+/// queries whose judged documents have (nearly) contiguous dictionary IDs, as with
+/// per-query pooled document names, get a direct grade array. All tables share two
+/// flat arrays.
+class GradeIndex {
+  public:
+    explicit GradeIndex(Qrels const& qrels, GradeIndexOptions const& options = {});
+
+    /// Index is not copyable: its views point into its own arrays.
+    GradeIndex(GradeIndex const&) = delete;
+    GradeIndex(GradeIndex&&) = default;
+    auto operator=(GradeIndex const&) -> GradeIndex& = delete;
+    auto operator=(GradeIndex&&) -> GradeIndex& = default;
+    ~GradeIndex() = default;
+
+    [[nodiscard]] auto num_queries() const noexcept -> std::size_t { return m_queries.size(); }
+
+    /// Lookup table of the qrels query at position `query`.
+    [[nodiscard]] auto query(std::size_t query) const noexcept -> QueryGrades const&
+    {
+        return m_queries[query];
+    }
+
+  private:
+    std::vector<std::uint32_t> m_keys;
+    std::vector<std::int32_t> m_grades;
+    std::vector<QueryGrades> m_queries;
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace eval_metrics {
+
+enum class Compression { none, gzip, zstd };
+
+/// Compression of a file judging by its first bytes (gzip: `1f 8b`, zstd: `28 b5 2f fd`).
+[[nodiscard]] auto detect_compression(std::string_view head) noexcept -> Compression;
+
+[[nodiscard]] auto compression_name(Compression compression) noexcept -> std::string_view;
+
+/// Whether the library was built with support for the compression.
+[[nodiscard]] auto is_supported(Compression compression) noexcept -> bool;
+
+struct InputStreamOptions {
+    /// Size of each buffer handed from the reading thread to the consumer.
+    std::size_t buffer_size = std::size_t{1} << 20U;
+    /// Maximum number of filled buffers waiting for the consumer.
+    std::size_t queue_depth = 4;
+};
+
+/// Reads a file, decompressing gzip or zstd transparently, on a background thread.
+///
+/// The reading thread fills buffers and queues them for the consumer; the queue is
+/// bounded, so the two stages overlap and throughput approaches that of the slower one
+/// while memory stays bounded. Buffers the consumer hands back with `recycle` are
+/// reused, forming a ring.
+class InputStream {
+  public:
+    /// Opens the file and starts reading it. Throws `IoError`, including for a
+    /// compression the library was built without.
+    explicit InputStream(std::filesystem::path const& path, InputStreamOptions options = {});
+
+    InputStream(InputStream const&) = delete;
+    InputStream(InputStream&&) = delete;
+    auto operator=(InputStream const&) -> InputStream& = delete;
+    auto operator=(InputStream&&) -> InputStream& = delete;
+    ~InputStream();
+
+    [[nodiscard]] auto compression() const noexcept -> Compression { return m_compression; }
+
+    /// Takes the next non-empty buffer of (decompressed) bytes, or nothing at the end.
+    /// Rethrows errors of the reading thread.
+    [[nodiscard]] auto take() -> std::optional<std::vector<char>>;
+
+    /// Hands a buffer obtained from `take` back for reuse.
+    void recycle(std::vector<char> buffer);
+
+    /// Copies up to `size` bytes to `out`; returns 0 only at the end.
+    [[nodiscard]] auto read(char* out, std::size_t size) -> std::size_t;
+
+    /// Reads the rest of the input into one string.
+    [[nodiscard]] auto read_all() -> std::string;
+
+  private:
+    struct Pipeline;
+
+    Compression m_compression = Compression::none;
+    std::unique_ptr<Pipeline> m_pipeline;
+    std::vector<char> m_current;
+    std::size_t m_current_pos = 0;
+};
+
+}  // namespace eval_metrics
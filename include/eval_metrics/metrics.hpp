@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+namespace eval_metrics {
+
+/// Grade given to retrieved documents that have no judgment for the query.
+inline constexpr std::int32_t unjudged = std::numeric_limits<std::int32_t>::min();
+
+/// Cutoff meaning "the whole ranking".
+inline constexpr std::size_t no_cutoff = std::numeric_limits<std::size_t>::max();
+
+// The functions below take the grades of the retrieved documents in ranking order
+// (`unjudged` for documents without a judgment): the gain column the evaluator
+// materializes once per query from the ranking's ID column, so that each metric is a
+// loop over one contiguous array. A document is relevant if its grade is at least
+// `relevance_level`. They follow the `trec_eval` definitions.
+
+[[nodiscard]] inline auto is_relevant(std::int32_t grade, std::int32_t relevance_level) noexcept
+    -> bool
+{
+    return grade != unjudged && grade >= relevance_level;
+}
+
+/// Number of relevant documents among the first `k` retrieved.
+[[nodiscard]] inline auto relevant_retrieved(
+    std::span<std::int32_t const> grades, std::int32_t relevance_level, std::size_t k = no_cutoff)
+    -> std::size_t
+{
+    auto depth = std::min(k, grades.size());
+    return static_cast<std::size_t>(
+        std::count_if(grades.begin(), grades.begin() + depth, [=](auto grade) {
+            return is_relevant(grade, relevance_level);
+        }));
+}
+
+/// Precision at `k`; like `trec_eval`, missing ranks count as non-relevant.
+[[nodiscard]] inline auto precision(
+    std::span<std::int32_t const> grades, std::int32_t relevance_level, std::size_t k) -> double
+{
+    return static_cast<double>(relevant_retrieved(grades, relevance_level, k))
+        / static_cast<double>(k);
+}
+
+/// Recall at `k` given `num_rel` relevant documents in total.
+[[nodiscard]] inline auto recall(
+    std::span<std::int32_t const> grades,
+    std::size_t num_rel,
+    std::int32_t relevance_level,
+    std::size_t k = no_cutoff) -> double
+{
+    if (num_rel == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(relevant_retrieved(grades, relevance_level, k))
+        / static_cast<double>(num_rel);
+}
+
+/// 1 if a relevant document is among the first `k` retrieved, 0 otherwise.
+[[nodiscard]] inline auto success(std::span<std::int32_t const> grades, std::int32_t relevance_level, std::size_t k)
+    -> double
+{
+    return relevant_retrieved(grades, relevance_level, k) > 0 ? 1.0 : 0.0;
+}
+
+/// Precision at rank `num_rel`.
+[[nodiscard]] inline auto r_precision(
+    std::span<std::int32_t const> grades, std::size_t num_rel, std::int32_t relevance_level)
+    -> double
+{
+    if (num_rel == 0) {
+        return 0.0;
+    }
+    return precision(grades, relevance_level, num_rel);
+}
+
+/// Average precision: mean of the precision at each relevant rank over `num_rel`.
+[[nodiscard]] inline auto average_precision(
+    std::span<std::int32_t const> grades, std::size_t num_rel, std::int32_t relevance_level)
+    -> double
+{
+    if (num_rel == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    std::size_t found = 0;
+    for (std::size_t rank = 0; rank < grades.size(); ++rank) {
+        if (is_relevant(grades[rank], relevance_level)) {
+            ++found;
+            sum += static_cast<double>(found) / static_cast<double>(rank + 1);
+        }
+    }
+    return sum / static_cast<double>(num_rel);
+}
+
+/// Reciprocal of the rank of the first relevant document, or zero.
+[[nodiscard]] inline auto reciprocal_rank(
+    std::span<std::int32_t const> grades, std::int32_t relevance_level) -> double
+{
+    for (std::size_t rank = 0; rank < grades.size(); ++rank) {
+        if (is_relevant(grades[rank], relevance_level)) {
+            return 1.0 / static_cast<double>(rank + 1);
+        }
+    }
+    return 0.0;
+}
+
+/// Discounted cumulative gain of the first `k` documents, with the grade as gain
+/// (non-positive and unjudged grades contribute nothing) and a `log2(rank + 1)` discount.
+[[nodiscard]] inline auto dcg(std::span<std::int32_t const> grades, std::size_t k = no_cutoff)
+    -> double
+{
+    auto depth = std::min(k, grades.size());
+    double sum = 0.0;
+    for (std::size_t rank = 0; rank < depth; ++rank) {
+        if (grades[rank] > 0) {
+            sum += static_cast<double>(grades[rank]) / std::log2(static_cast<double>(rank + 2));
+        }
+    }
+    return sum;
+}
+
+/// Normalized DCG at `k`. `ideal` holds the query's judged grades sorted in
+/// decreasing order, i.e., the grades of the best possible ranking.
+[[nodiscard]] inline auto ndcg(
+    std::span<std::int32_t const> grades,
+    std::span<std::int32_t const> ideal,
+    std::size_t k = no_cutoff) -> double
+{
+    auto ideal_dcg = dcg(ideal, k);
+    if (ideal_dcg == 0.0) {
+        return 0.0;
+    }
+    return dcg(grades, k) / ideal_dcg;
+}
+
+/// Normalized DCG at `k`, given the ideal DCG at `k` (see `QrelsStatistics::ideal_dcg`).
+[[nodiscard]] inline auto ndcg(std::span<std::int32_t const> grades, double ideal_dcg, std::size_t k = no_cutoff)
+    -> double
+{
+    if (ideal_dcg == 0.0) {
+        return 0.0;
+    }
+    return dcg(grades, k) / ideal_dcg;
+}
+
+/// Probability that a user stops at a document of the given grade, from a table indexed
+/// by grade: non-positive and unjudged grades never stop the user, and grades past the
+/// table get its last probability.
+[[nodiscard]] inline auto stop_probability(std::int32_t grade, std::span<double const> stop_probabilities) noexcept
+    -> double
+{
+    if (grade <= 0 || stop_probabilities.empty()) {
+        return 0.0;
+    }
+    return stop_probabilities[std::min(static_cast<std::size_t>(grade), stop_probabilities.size() - 1)];
+}
+
+/// Expected reciprocal rank at `k` (Chapelle et al., 2009): the expected reciprocal of
+/// the rank at which a user, scanning down the ranking and stopping at each document
+/// with its `stop_probability`, stops.
+[[nodiscard]] inline auto expected_reciprocal_rank(
+    std::span<std::int32_t const> grades, std::span<double const> stop_probabilities, std::size_t k = no_cutoff)
+    -> double
+{
+    auto depth = std::min(k, grades.size());
+    double err = 0.0;
+    double not_stopped = 1.0;
+    for (std::size_t rank = 0; rank < depth; ++rank) {
+        auto stop = stop_probability(grades[rank], stop_probabilities);
+        err += not_stopped * stop / static_cast<double>(rank + 1);
+        not_stopped *= 1.0 - stop;
+    }
+    return err;
+}
+
+/// Rank-biased precision (Moffat and Zobel, 2008) with persistence `p`: the expected
+/// rate at which a user, moving to the next document with probability `p`, sees
+/// relevant documents.
+[[nodiscard]] inline auto rank_biased_precision(
+    std::span<std::int32_t const> grades, std::int32_t relevance_level, double p) -> double
+{
+    double sum = 0.0;
+    double weight = 1.0;
+    for (auto grade : grades) {
+        if (is_relevant(grade, relevance_level)) {
+            sum += weight;
+        }
+        weight *= p;
+    }
+    return (1.0 - p) * sum;
+}
+
+/// Residual of `rank_biased_precision`: how much it could still grow if every unjudged
+/// document, and every document past the end of the ranking, were relevant.
+[[nodiscard]] inline auto rbp_residual(std::span<std::int32_t const> grades, double p) -> double
+{
+    double sum = 0.0;
+    double weight = 1.0;
+    for (auto grade : grades) {
+        if (grade == unjudged) {
+            sum += weight;
+        }
+        weight *= p;
+    }
+    return (1.0 - p) * sum + weight;
+}
+
+// Measures for incomplete judgments. Sampled qrels (the TREC infAP format) list the
+// pooled documents that were not sampled for judging with a negative grade; `bpref` and
+// `inferred_average_precision` count such documents as neither relevant nor non-relevant,
+// and only the documents missing from the qrels as outside the pool.
+
+/// Number of judged documents among the first `k` retrieved.
+[[nodiscard]] inline auto judged_retrieved(std::span<std::int32_t const> grades, std::size_t k = no_cutoff)
+    -> std::size_t
+{
+    auto depth = std::min(k, grades.size());
+    return static_cast<std::size_t>(
+        std::count_if(grades.begin(), grades.begin() + depth, [](auto grade) { return grade != unjudged; }));
+}
+
+/// Fraction of the first `k` ranks that hold a judged document; missing ranks count as
+/// unjudged.
+[[nodiscard]] inline auto judged(std::span<std::int32_t const> grades, std::size_t k) -> double
+{
+    return static_cast<double>(judged_retrieved(grades, k)) / static_cast<double>(k);
+}
+
+/// bpref (Buckley and Voorhees, 2004), as `trec_eval` computes it: each relevant
+/// document retrieved scores one minus the fraction of judged non-relevant documents
+/// ranked above it, counting at most `min(num_rel, num_nonrel)` of them; the sum is
+/// divided by `num_rel`. `num_nonrel` is the query's number of judgments with a grade
+/// from 0 to below `relevance_level`.
+[[nodiscard]] inline auto bpref(
+    std::span<std::int32_t const> grades, std::size_t num_rel, std::size_t num_nonrel, std::int32_t relevance_level)
+    -> double
+{
+    if (num_rel == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    std::size_t nonrel = 0;
+    for (auto grade : grades) {
+        if (grade < 0) {
+            continue;
+        }
+        if (grade >= relevance_level) {
+            sum += nonrel == 0 ? 1.0
+                               : 1.0 - static_cast<double>(std::min(nonrel, num_rel))
+                                           / static_cast<double>(std::min(num_rel, num_nonrel));
+        } else {
+            ++nonrel;
+        }
+    }
+    return sum / static_cast<double>(num_rel);
+}
+
+/// Smoothing of the judged precision of `inferred_average_precision`, as in `trec_eval`.
+inline constexpr double infap_epsilon = 0.00001;
+
+/// Expected precision at a relevant document at 0-based `rank`, above which `rel`
+/// relevant and `nonrel` non-relevant documents were judged, and `unsampled` pooled
+/// documents were not: the term of `inferred_average_precision`.
+[[nodiscard]] inline auto inferred_precision(
+    std::size_t rank, std::size_t rel, std::size_t nonrel, std::size_t unsampled) noexcept -> double
+{
+    if (rank == 0) {
+        return 1.0;
+    }
+    auto above = static_cast<double>(rank);
+    auto judged = static_cast<double>(rel + nonrel);
+    auto pooled = judged + static_cast<double>(unsampled);
+    return 1.0 / (above + 1.0)
+        + above / (above + 1.0) * (pooled / above)
+        * ((static_cast<double>(rel) + infap_epsilon) / (judged + 2.0 * infap_epsilon));
+}
+
+/// Inferred average precision (Yilmaz and Aslam, 2006) over sampled judgments: the
+/// expected precision at each relevant document retrieved counts the documents above it
+/// that are outside the pool as non-relevant, and estimates the relevant fraction of
+/// the pooled ones from the sampled judgments among them.
+[[nodiscard]] inline auto inferred_average_precision(
+    std::span<std::int32_t const> grades, std::size_t num_rel, std::int32_t relevance_level) -> double
+{
+    if (num_rel == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    std::size_t rel = 0;
+    std::size_t nonrel = 0;
+    std::size_t unsampled = 0;
+    for (std::size_t rank = 0; rank < grades.size(); ++rank) {
+        auto grade = grades[rank];
+        if (grade == unjudged) {
+            continue;
+        }
+        if (grade < 0) {
+            ++unsampled;
+        } else if (grade < relevance_level) {
+            ++nonrel;
+        } else {
+            sum += inferred_precision(rank, rel, nonrel, unsampled);
+            ++rel;
+        }
+    }
+    return sum / static_cast<double>(num_rel);
+}
+
+/// Moves the judged grades of `grades` to its front, in ranking order, and returns them:
+/// the condensed list (Sakai, 2007) on which any measure evaluates the ranking as if its
+/// unjudged documents had not been retrieved, without copying the ranking.
+[[nodiscard]] inline auto condense(std::span<std::int32_t> grades) noexcept -> std::span<std::int32_t>
+{
+    auto end = std::remove(grades.begin(), grades.end(), unjudged);
+    return grades.first(static_cast<std::size_t>(end - grades.begin()));
+}
+
+}  // namespace eval_metrics
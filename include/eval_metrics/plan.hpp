@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/dcg.hpp"
+#include "eval_metrics/metrics.hpp"
+#include "eval_metrics/qrels_statistics.hpp"
+
+namespace eval_metrics {
+
+/// How per-query values of a metric are combined into the summary value.
+enum class Aggregation { mean, sum };
+
+struct MetricInfo {
+    std::string name;
+    Aggregation aggregation = Aggregation::mean;
+    /// Integral metrics (counts) are printed without decimals.
+    bool integral = false;
+    /// Number of leading ranks whose order the metric depends on: 0 for counts, which
+    /// ignore the order, `no_cutoff` for the whole ranking.
+    std::size_t depth = no_cutoff;
+    /// Whether the metric also depends on the order of the first R ranks, R being the
+    /// query's number of relevant documents (as R-precision does).
+    bool depth_num_rel = false;
+};
+
+/// The measures an `EvaluationPlan` can compute.
+enum class Measure : std::uint8_t {
+    num_ret,
+    num_rel,
+    num_rel_ret,
+    map,
+    rprec,
+    recip_rank,
+    precision,
+    recall,
+    success,
+    ndcg,
+    ndcg_cut,
+    ndcg_exp,
+    ndcg_exp_cut,
+    err,
+    rbp,
+    rbp_residual,
+    bpref,
+    infap,
+    judged,
+};
+
+/// How ERR maps grades to the probability that the user stops at a document.
+struct CascadeOptions {
+    /// The probability of grade `g` is `gain(g) / (gain(max_grade) + 1)`: with the
+    /// default exponential gain, the usual `(2^g - 1) / 2^max_grade`.
+    Gain gain = Gain::exponential;
+    /// The highest grade; `Evaluator` replaces 0 with the highest grade of the qrels.
+    std::int32_t max_grade = 0;
+    /// Explicit probability of each grade, indexed by grade (see `stop_probability`);
+    /// overrides `gain` and `max_grade` if not empty.
+    std::vector<double> stop_probabilities;
+};
+
+/// Splits a comma-separated list of measure specifications, in which a number
+/// continues the cutoffs of the preceding measure: `"ndcg_cut.5,10,map"` holds
+/// `"ndcg_cut.5,10"` and `"map"`. Empty items are skipped.
+[[nodiscard]] auto split_measures(std::string_view list) -> std::vector<std::string>;
+
+/// A set of measures compiled for evaluation.
+///
+/// Measures are specified as `trec_eval` does: a name, optionally followed by a dot
+/// and comma-separated cutoffs for the measures that take them (`map`, `recip_rank`,
+/// `P.10`, `ndcg_cut.5,10,20`); a cutoff measure without cutoffs gets the standard
+/// ones (`success` is not standard; its default cutoffs are 1, 5 and 10, as in
+/// `trec_eval`). Printed names such as `P_10` are accepted too. Each cutoff yields one metric,
+/// named as printed (`ndcg_cut_5`).
+///
+/// The cascade measures are not standard either: `err.5,10` is ERR at each cutoff
+/// (5, 10 and 20 by default), with stop probabilities from `CascadeOptions`;
+/// `rbp.0.5,0.8` is rank-biased precision at each persistence (0.8 by default), and
+/// `rbp_res.0.8` its residual (see `rbp_residual`), printed as `rbp_0.8` and
+/// `rbp_res_0.8`.
+///
+/// So are the measures for incomplete judgments: `bpref`, `infAP` over sampled qrels,
+/// and `judged.10`, the fraction of the first 10 ranks that hold a judged document
+/// (see `metrics.hpp`).
+///
+/// And so are `ndcg_exp` and `ndcg_exp_cut.5,10`: nDCG with the exponential gain
+/// `2^grade - 1` of `Gain::exponential` instead of the grade itself. They are computed
+/// with `vector_dcg_at`, and so are within its tolerance of the ordered sum rather than
+/// bit-identical to it.
+///
+/// Compiling merges what the metrics share: a single increasing list of distinct
+/// cutoffs, at which one `fused_pass` collects both the relevant counts and the DCG
+/// every cutoff measure reads, and the depth up to which rankings must be ordered.
+/// The plan is immutable, so it can be shared by threads, and evaluating a query only
+/// writes to a `Workspace` sized once.
+class EvaluationPlan {
+  public:
+    /// One computed metric: a measure, and the position of its cutoff in `cutoffs()`
+    /// or of its persistence in `persistences()`.
+    struct Step {
+        Measure measure;
+        std::size_t slot = 0;
+    };
+
+    /// Per-query arrays of a plan, allocated once and reused for every query.
+    class Workspace {
+      public:
+        explicit Workspace(EvaluationPlan const& plan)
+            : m_relevant_at(plan.cutoffs().size()),
+              m_dcg_at(plan.cutoffs().size()),
+              m_exponential_dcg_at(plan.cutoffs().size()),
+              m_ideal_exponential_dcg_at(plan.cutoffs().size()),
+              m_err_at(plan.cutoffs().size()),
+              m_rbp(plan.persistences().size()),
+              m_rbp_residual(plan.persistences().size()),
+              m_weights(plan.persistences().size()),
+              m_judged_at(plan.cutoffs().size())
+        {}
+
+      private:
+        friend class EvaluationPlan;
+        std::vector<std::size_t> m_relevant_at;
+        std::vector<double> m_dcg_at;
+        std::vector<double> m_exponential_dcg_at;
+        std::vector<double> m_ideal_exponential_dcg_at;
+        std::vector<double> m_err_at;
+        std::vector<double> m_rbp;
+        std::vector<double> m_rbp_residual;
+        std::vector<double> m_weights;
+        std::vector<std::size_t> m_judged_at;
+    };
+
+    /// Compiles measure specifications. Throws `Error` for an unknown measure or an
+    /// invalid parameter.
+    [[nodiscard]] static auto compile(std::span<std::string const> specs, CascadeOptions const& cascade = {})
+        -> EvaluationPlan;
+
+    /// The standard `trec_eval` measures: `num_ret`, `num_rel`, `num_rel_ret`, `map`,
+    /// `Rprec`, `recip_rank`, `P` and `recall` at the usual cutoffs, `ndcg`, and
+    /// `ndcg_cut` at the usual cutoffs.
+    [[nodiscard]] static auto standard() -> EvaluationPlan;
+
+    [[nodiscard]] auto metrics() const noexcept -> std::span<MetricInfo const> { return m_metrics; }
+    [[nodiscard]] auto steps() const noexcept -> std::span<Step const> { return m_steps; }
+    /// Distinct cutoffs of all the metrics, in increasing order.
+    [[nodiscard]] auto cutoffs() const noexcept -> std::span<std::size_t const> { return m_cutoffs; }
+    /// Distinct RBP persistences of the metrics.
+    [[nodiscard]] auto persistences() const noexcept -> std::span<double const> { return m_persistences; }
+
+    /// Number of leading ranks whose order the metrics depend on, not counting the
+    /// first R ranks that `depends_on_num_rel` metrics need.
+    [[nodiscard]] auto depth() const noexcept -> std::size_t { return m_depth; }
+    [[nodiscard]] auto depends_on_num_rel() const noexcept -> bool { return m_depends_on_num_rel; }
+
+    /// Writes the value of each metric of the ranking with the given gain column, for
+    /// the qrels query at position `query`, to `values`.
+    void evaluate(
+        std::span<std::int32_t const> grades,
+        QrelsStatistics const& statistics,
+        std::size_t query,
+        std::int32_t relevance_level,
+        Workspace& workspace,
+        std::span<double> values) const;
+
+  private:
+    EvaluationPlan() = default;
+
+    void add(Measure measure, std::string name, std::size_t cutoff, double persistence);
+
+    std::vector<MetricInfo> m_metrics;
+    std::vector<Step> m_steps;
+    std::vector<std::size_t> m_cutoffs;
+    std::vector<double> m_persistences;
+    std::vector<double> m_stop_probabilities;
+    std::size_t m_depth = 0;
+    bool m_depends_on_num_rel = false;
+    bool m_needs_dcg = false;
+    bool m_needs_exponential_dcg = false;
+    bool m_needs_cascade = false;
+    bool m_needs_incomplete = false;
+    /// Discounts down to the depth of the metrics, or of usual runs.
+    DiscountTable m_discounts{0};
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "eval_metrics/dcg.hpp"
+#include "eval_metrics/metrics.hpp"
+
+namespace eval_metrics {
+
+/// Prefix sums of a ranking's gain column: the number of relevant documents and the
+/// DCG of each leading part of the ranking. After one pass over the ranking, P, recall,
+/// nDCG and success are answered at any cutoff in O(1), so that many cutoffs, or whole
+/// curves for plotting, cost no more than a few. The sums are accumulated in rank
+/// order, so the values are identical to the reference functions of `metrics.hpp`.
+class PrefixSums {
+  public:
+    /// Computes the prefix sums of the ranking with gain column `grades`, for a query
+    /// with `num_rel` relevant documents and the given ideal DCG prefix sums (see
+    /// `QrelsStatistics::ideal_dcg_prefix`). Reuses the storage of earlier rankings.
+    void assign(
+        std::span<std::int32_t const> grades,
+        std::int32_t relevance_level,
+        std::size_t num_rel,
+        std::span<double const> ideal_dcg,
+        DiscountTable const& discounts = DiscountTable::standard())
+    {
+        m_num_rel = num_rel;
+        m_ideal_dcg = ideal_dcg;
+        m_relevant.resize(grades.size() + 1);
+        m_dcg.resize(grades.size() + 1);
+        std::size_t found = 0;
+        double dcg = 0.0;
+        for (std::size_t rank = 0; rank < grades.size(); ++rank) {
+            auto grade = grades[rank];
+            if (grade > 0) {
+                dcg += static_cast<double>(grade) / discounts.log2_rank(rank);
+            }
+            found += is_relevant(grade, relevance_level) ? 1 : 0;
+            m_relevant[rank + 1] = found;
+            m_dcg[rank + 1] = dcg;
+        }
+    }
+
+    /// Number of ranked documents.
+    [[nodiscard]] auto depth() const noexcept -> std::size_t { return m_relevant.size() - 1; }
+    [[nodiscard]] auto num_rel() const noexcept -> std::size_t { return m_num_rel; }
+
+    /// DCG of the first `i` documents, for `i` from 0 to `depth()`.
+    [[nodiscard]] auto dcg_prefix() const noexcept -> std::span<double const> { return m_dcg; }
+
+    /// Number of relevant documents among the first `k` retrieved.
+    [[nodiscard]] auto relevant(std::size_t k) const noexcept -> std::size_t
+    {
+        return m_relevant[std::min(k, depth())];
+    }
+
+    [[nodiscard]] auto dcg(std::size_t k = no_cutoff) const noexcept -> double { return m_dcg[std::min(k, depth())]; }
+
+    /// Precision at `k`; missing ranks count as non-relevant. The empty prefix, `k == 0`,
+    /// has precision 0, as it has recall, nDCG and success 0.
+    [[nodiscard]] auto precision(std::size_t k) const noexcept -> double
+    {
+        return k == 0 ? 0.0 : static_cast<double>(relevant(k)) / static_cast<double>(k);
+    }
+
+    [[nodiscard]] auto recall(std::size_t k = no_cutoff) const noexcept -> double
+    {
+        return m_num_rel == 0 ? 0.0 : static_cast<double>(relevant(k)) / static_cast<double>(m_num_rel);
+    }
+
+    [[nodiscard]] auto ndcg(std::size_t k = no_cutoff) const noexcept -> double
+    {
+        if (m_ideal_dcg.empty()) {
+            return 0.0;
+        }
+        auto ideal = m_ideal_dcg[std::min(k, m_ideal_dcg.size() - 1)];
+        return ideal == 0.0 ? 0.0 : dcg(k) / ideal;
+    }
+
+    /// 1 if a relevant document is among the first `k` retrieved, 0 otherwise.
+    [[nodiscard]] auto success(std::size_t k) const noexcept -> double { return relevant(k) > 0 ? 1.0 : 0.0; }
+
+  private:
+    std::vector<std::size_t> m_relevant{0};
+    std::vector<double> m_dcg{0.0};
+    std::size_t m_num_rel = 0;
+    std::span<double const> m_ideal_dcg;
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/doc_dictionary.hpp"
+#include "eval_metrics/qrels_statistics.hpp"
+
+namespace eval_metrics {
+
+/// A single relevance judgment of a document within a query.
+struct Judgment {
+    std::string_view doc;
+    std::int32_t grade;
+    /// Position of `doc` in the qrels' `DocDictionary`.
+    std::uint32_t id = unresolved_doc;
+};
+
+/// Relevance judgments in the TREC qrels format: `qid iter docno grade`.
+///
+/// Query and document IDs are views into the underlying `Buffer`, which is usually
+/// a memory mapping of the qrels file, so loading does not allocate per line.
+/// Queries are ordered by ID and each query's judgments by document ID, the same
+/// byte-wise order `trec_eval` uses. The judged documents are interned in a
+/// `DocDictionary`, which runs use to resolve their documents to integer IDs.
+class Qrels {
+  public:
+    /// Assembles qrels from already ordered parts: `offsets` delimits each query's
+    /// judgments and has one more entry than `query_ids`; judgment IDs refer to
+    /// `dictionary`. All views point into `storage`, usually a `Buffer`. The statistics
+    /// are computed unless given (as read from a binary file).
+    Qrels(
+        std::shared_ptr<void const> storage,
+        std::shared_ptr<DocDictionary const> dictionary,
+        std::vector<std::string_view> query_ids,
+        std::vector<std::size_t> offsets,
+        std::vector<Judgment> judgments,
+        std::shared_ptr<QrelsStatistics const> statistics = nullptr);
+
+    /// Maps and loads a qrels file, either TREC text or the binary format of
+    /// `binary_format.hpp` (detected by its magic bytes), possibly gzip- or
+    /// zstd-compressed. Compressed text is parsed buffer by buffer as it is
+    /// decompressed, never held as one string. Throws `IoError` or `ParseError`.
+    [[nodiscard]] static auto from_file(std::filesystem::path const& path) -> Qrels;
+
+    /// Parses qrels text held by `buffer`. Throws `ParseError`.
+    [[nodiscard]] static auto parse(std::shared_ptr<Buffer const> buffer) -> Qrels;
+
+    [[nodiscard]] auto num_queries() const noexcept -> std::size_t { return m_query_ids.size(); }
+    [[nodiscard]] auto num_judgments() const noexcept -> std::size_t { return m_judgments.size(); }
+
+    /// The dictionary of all judged documents.
+    [[nodiscard]] auto dictionary() const noexcept -> std::shared_ptr<DocDictionary const> const&
+    {
+        return m_dictionary;
+    }
+
+    /// Run-independent per-query statistics (numbers of relevant documents, ideal gains
+    /// and DCG), computed once when the qrels are loaded.
+    [[nodiscard]] auto statistics() const noexcept -> QrelsStatistics const& { return *m_statistics; }
+
+    [[nodiscard]] auto query_id(std::size_t query) const noexcept -> std::string_view
+    {
+        return m_query_ids[query];
+    }
+
+    /// Judgments of the given query, sorted by document (and so by dictionary ID).
+    [[nodiscard]] auto judgments(std::size_t query) const noexcept -> std::span<Judgment const>
+    {
+        return std::span<Judgment const>(m_judgments)
+            .subspan(m_offsets[query], m_offsets[query + 1] - m_offsets[query]);
+    }
+
+    /// Position of the query with the given ID, if it has any judgments.
+    [[nodiscard]] auto find_query(std::string_view query_id) const noexcept
+        -> std::optional<std::size_t>;
+
+    /// Grade of the document with the given dictionary ID in the given query, or
+    /// nothing if it is unjudged there.
+    [[nodiscard]] auto grade(std::size_t query, std::uint32_t doc_id) const noexcept
+        -> std::optional<std::int32_t>;
+
+    /// Grade of `doc` in the given query, or nothing if it is unjudged.
+    [[nodiscard]] auto grade(std::size_t query, std::string_view doc) const noexcept
+        -> std::optional<std::int32_t>
+    {
+        return grade(query, m_dictionary->lookup(doc));
+    }
+
+  private:
+    Qrels() = default;
+
+    /// Keeps alive the text the views point into: a `Buffer`, or the buffers of a
+    /// decompressed file.
+    std::shared_ptr<void const> m_storage;
+    std::shared_ptr<DocDictionary const> m_dictionary;
+    std::vector<std::string_view> m_query_ids;
+    std::vector<std::size_t> m_offsets;
+    std::vector<Judgment> m_judgments;
+    std::shared_ptr<QrelsStatistics const> m_statistics;
+};
+
+}  // namespace eval_metrics
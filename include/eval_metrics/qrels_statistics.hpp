@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "eval_metrics/metrics.hpp"
+
+namespace eval_metrics {
+
+class Qrels;
+
+/// Per-query statistics of a set of judgments that do not depend on the evaluated run,
+/// computed once per qrels load and shared by every run evaluated against them:
+///
+///  - the number of judgments at or above each grade, from which the number of
+///    relevant documents at any relevance level is read;
+///  - the ideal gains: the positive grades in decreasing order, i.e., the gains of the
+///    best possible ranking;
+///  - the ideal DCG prefix sums, which give the ideal DCG at any cutoff in O(1) and
+///    are summed exactly as `dcg` sums them, so normalized values are bit-identical.
+///
+/// The columns are flat arrays delimited by per-query offset tables, so they can be
+/// stored in, and used directly from, a binary qrels file.
+class QrelsStatistics {
+  public:
+    struct Columns {
+        /// Start of each query's entries in `grade_values` and `grade_counts`, plus the end.
+        std::span<std::uint64_t const> grade_offsets;
+        /// Distinct grades of each query, in decreasing order.
+        std::span<std::int32_t const> grade_values;
+        /// Number of the query's judgments with a grade at least the matching value.
+        std::span<std::uint64_t const> grade_counts;
+        /// Start of each query's entries in `ideal_gains`, plus the end.
+        std::span<std::uint64_t const> ideal_offsets;
+        /// Positive grades of each query, in decreasing order.
+        std::span<std::int32_t const> ideal_gains;
+        /// DCG of the first `i` ideal gains, for `i` from 0 to the number of ideal gains:
+        /// query `q` starts at `ideal_offsets[q] + q`.
+        std::span<double const> ideal_dcg;
+    };
+
+    /// Computes the statistics of each query of `qrels`.
+    explicit QrelsStatistics(Qrels const& qrels);
+
+    /// Wraps already computed columns, which `storage` keeps alive.
+    QrelsStatistics(std::shared_ptr<void const> storage, Columns columns) noexcept;
+
+    [[nodiscard]] auto num_queries() const noexcept -> std::size_t
+    {
+        return m_columns.grade_offsets.size() - 1;
+    }
+
+    [[nodiscard]] auto columns() const noexcept -> Columns const& { return m_columns; }
+
+    /// Number of judgments of the query with a grade at least `relevance_level`.
+    [[nodiscard]] auto num_relevant(std::size_t query, std::int32_t relevance_level) const noexcept
+        -> std::size_t
+    {
+        std::size_t count = 0;
+        for (auto idx = m_columns.grade_offsets[query]; idx < m_columns.grade_offsets[query + 1]; ++idx) {
+            if (m_columns.grade_values[idx] < relevance_level) {
+                break;
+            }
+            count = m_columns.grade_counts[idx];
+        }
+        return count;
+    }
+
+    /// Number of judgments of the query with a grade from 0 to below `relevance_level`:
+    /// the judged non-relevant documents of `bpref`.
+    [[nodiscard]] auto num_nonrelevant(std::size_t query, std::int32_t relevance_level) const noexcept
+        -> std::size_t
+    {
+        return num_relevant(query, 0) - num_relevant(query, std::max(relevance_level, 0));
+    }
+
+    /// Highest grade of any query, or 0 if no judgment is positive.
+    [[nodiscard]] auto max_grade() const noexcept -> std::int32_t
+    {
+        std::int32_t grade = 0;
+        for (std::size_t query = 0; query < num_queries(); ++query) {
+            if (m_columns.grade_offsets[query] < m_columns.grade_offsets[query + 1]) {
+                grade = std::max(grade, m_columns.grade_values[m_columns.grade_offsets[query]]);
+            }
+        }
+        return grade;
+    }
+
+    /// Gains of the best possible ranking of the query.
+    [[nodiscard]] auto ideal_gains(std::size_t query) const noexcept -> std::span<std::int32_t const>
+    {
+        auto first = m_columns.ideal_offsets[query];
+        return m_columns.ideal_gains.subspan(first, m_columns.ideal_offsets[query + 1] - first);
+    }
+
+    /// DCG of the best possible ranking of the query at cutoff `k`; equal to
+    /// `dcg(ideal_gains(query), k)`.
+    [[nodiscard]] auto ideal_dcg(std::size_t query, std::size_t k = no_cutoff) const noexcept -> double
+    {
+        auto first = m_columns.ideal_offsets[query];
+        auto size = m_columns.ideal_offsets[query + 1] - first;
+        return m_columns.ideal_dcg[first + query + std::min<std::size_t>(k, size)];
+    }
+
+    /// Ideal DCG of the first `i` ideal gains of the query, for `i` from 0 to their number.
+    [[nodiscard]] auto ideal_dcg_prefix(std::size_t query) const noexcept -> std::span<double const>
+    {
+        auto first = m_columns.ideal_offsets[query];
+        return m_columns.ideal_dcg.subspan(first + query, m_columns.ideal_offsets[query + 1] - first + 1);
+    }
+
+  private:
+    std::shared_ptr<void const> m_storage;
+    Columns m_columns;
+};
+
+}  // namespace eval_metrics
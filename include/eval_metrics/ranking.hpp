@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/doc_dictionary.hpp"
+
+namespace eval_metrics {
+
+/// A retrieved document with the score and rank reported by the system.
+struct ScoredDoc {
+    std::string_view doc;
+    double score;
+    std::int64_t rank;
+    /// ID of `doc` in the dictionary the run was resolved against, `unjudged_doc` if it
+    /// is not in it, or `unresolved_doc` if the run was parsed without a dictionary.
+    std::uint32_t id = unresolved_doc;
+};
+
+/// Orders documents the way `trec_eval` ranks them: score descending, then document ID
+/// descending.
+[[nodiscard]] inline auto trec_order(ScoredDoc const& lhs, ScoredDoc const& rhs) noexcept -> bool
+{
+    if (lhs.score != rhs.score) {
+        return lhs.score > rhs.score;
+    }
+    return lhs.doc > rhs.doc;
+}
+
+/// How the documents of each ranking are ordered for evaluation.
+enum class RankingOrder {
+    /// `trec_order`: score descending, then document ID descending, whatever the ranks.
+    score,
+    /// The rank column, ascending, trusting the system's ranks. Documents with equal
+    /// ranks keep their file order, and rankings whose lines are already in rank order
+    /// are not sorted at all.
+    rank,
+};
+
+/// The documents of a ranking as parallel columns, one entry per rank.
+///
+/// Evaluation reads one column at a time (the IDs to look up grades, then the grades
+/// themselves), so each pass streams through a contiguous array instead of striding
+/// over records.
+struct RankingView {
+    std::span<std::string_view const> docs;
+    std::span<double const> scores;
+    std::span<std::int64_t const> ranks;
+    std::span<std::uint32_t const> ids;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return docs.size(); }
+    [[nodiscard]] auto empty() const noexcept -> bool { return docs.empty(); }
+
+    /// The document at the given position, gathered from the columns.
+    [[nodiscard]] auto operator[](std::size_t pos) const noexcept -> ScoredDoc
+    {
+        return {docs[pos], scores[pos], ranks[pos], ids[pos]};
+    }
+};
+
+/// Buffers reused by `RankingColumns::sort` from one ranking to the next.
+class SortBuffers {
+  private:
+    friend class RankingColumns;
+
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint64_t> key_scratch;
+    std::vector<std::uint32_t> order;
+    std::vector<std::uint32_t> sorted;
+    std::vector<std::uint32_t> order_scratch;
+    std::vector<std::string_view> docs;
+    std::vector<double> scores;
+    std::vector<std::int64_t> ranks;
+    std::vector<std::uint32_t> ids;
+};
+
+/// Owning columns of the rankings of one or more queries stored back to back.
+class RankingColumns {
+  public:
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return m_docs.size(); }
+    [[nodiscard]] auto empty() const noexcept -> bool { return m_docs.empty(); }
+
+    void reserve(std::size_t size);
+    void clear() noexcept;
+    void push_back(ScoredDoc const& doc);
+
+    /// The `count` documents starting at `first`.
+    [[nodiscard]] auto view(std::size_t first, std::size_t count) const noexcept -> RankingView
+    {
+        return {
+            std::span<std::string_view const>(m_docs).subspan(first, count),
+            std::span<double const>(m_scores).subspan(first, count),
+            std::span<std::int64_t const>(m_ranks).subspan(first, count),
+            std::span<std::uint32_t const>(m_ids).subspan(first, count)};
+    }
+
+    [[nodiscard]] auto view() const noexcept -> RankingView { return view(0, size()); }
+
+    /// Puts the `count` documents starting at `first` in the given order, or only the
+    /// first `depth` of them: those are then selected (with `std::nth_element`) and
+    /// sorted, while the rest follow in no particular order.
+    ///
+    /// Scores are sorted as integers: each is mapped to a 64-bit key whose unsigned
+    /// order is the descending order of the scores, and the keys are sorted by an LSD
+    /// radix sort that skips the bytes all keys share. A second pass orders the runs of
+    /// tied scores by document ID, which is the only place strings are compared. Short
+    /// rankings, and rankings already in order, are handled by comparison.
+    void sort(
+        std::size_t first,
+        std::size_t count,
+        RankingOrder order,
+        SortBuffers& buffers,
+        std::size_t depth = std::numeric_limits<std::size_t>::max());
+
+    void sort(std::size_t first, std::size_t count, RankingOrder order = RankingOrder::score)
+    {
+        SortBuffers buffers;
+        sort(first, count, order, buffers);
+    }
+
+  private:
+    std::vector<std::string_view> m_docs;
+    std::vector<double> m_scores;
+    std::vector<std::int64_t> m_ranks;
+    std::vector<std::uint32_t> m_ids;
+};
+
+}  // namespace eval_metrics
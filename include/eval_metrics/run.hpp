@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/doc_dictionary.hpp"
+#include "eval_metrics/ranking.hpp"
+
+namespace eval_metrics {
+
+namespace detail {
+struct RunLine;
+}  // namespace detail
+
+struct RunParseOptions {
+    /// Number of parsing threads; 0 uses all available cores.
+    std::size_t threads = 0;
+    /// Dictionary to resolve documents against while parsing, usually that of the
+    /// qrels the run is evaluated with.
+    std::shared_ptr<DocDictionary const> dictionary = nullptr;
+    /// Order of each ranking; `RankingOrder::rank` trusts the file's rank column.
+    RankingOrder order = RankingOrder::score;
+    /// Number of leading documents of each ranking that must be in order; the others
+    /// are kept, in no particular order. `Evaluator::required_depth` gives the depth
+    /// its metrics need.
+    std::size_t depth = std::numeric_limits<std::size_t>::max();
+};
+
+/// A retrieval run in the TREC format: `qid Q0 docno rank score tag`, or in JSON Lines
+/// with one ranking per line (see `detail::parse_json_ranking`).
+///
+/// The input is split into newline-aligned chunks that are parsed in parallel and
+/// stitched back in file order, so the result does not depend on the thread count.
+/// Queries are ordered by ID and each ranking is in `trec_eval` order: by score
+/// descending, ties broken by document ID descending. The rank column is kept but
+/// not used for ordering, unless `RunParseOptions::order` asks to trust it. When only
+/// shallow cutoffs are evaluated, `RunParseOptions::depth` limits the ordering to the
+/// top of each ranking. The rankings of all queries are stored back to back in
+/// parallel columns (see `RankingColumns`).
+class Run {
+  public:
+    /// Assembles a run from already ordered parts: `offsets` delimits each query's
+    /// ranking in `rankings` and has one more entry than `query_ids`; document IDs are
+    /// resolved against `dictionary`, if any. All views point into `buffer`.
+    Run(std::shared_ptr<Buffer const> buffer,
+        std::shared_ptr<DocDictionary const> dictionary,
+        std::string_view tag,
+        std::vector<std::string_view> query_ids,
+        std::vector<std::size_t> offsets,
+        RankingColumns rankings);
+
+    /// Maps and loads a run file, either TREC text or the binary format of
+    /// `binary_format.hpp` (detected by its magic bytes). Gzip- or zstd-compressed text
+    /// is decompressed on a background thread while it is parsed.
+    /// Throws `IoError` or `ParseError`.
+    [[nodiscard]] static auto from_file(std::filesystem::path const& path, RunParseOptions options = {})
+        -> Run;
+
+    /// Parses run text held by `buffer`. Throws `ParseError`.
+    [[nodiscard]] static auto parse(std::shared_ptr<Buffer const> buffer, RunParseOptions options = {})
+        -> Run;
+
+    [[nodiscard]] auto num_queries() const noexcept -> std::size_t { return m_query_ids.size(); }
+    [[nodiscard]] auto num_docs() const noexcept -> std::size_t { return m_rankings.size(); }
+
+    /// The dictionary the documents are resolved against, or null if they are unresolved.
+    [[nodiscard]] auto dictionary() const noexcept -> std::shared_ptr<DocDictionary const> const&
+    {
+        return m_dictionary;
+    }
+
+    /// The run tag of the first line, or empty if the run is empty.
+    [[nodiscard]] auto tag() const noexcept -> std::string_view { return m_tag; }
+
+    [[nodiscard]] auto query_id(std::size_t query) const noexcept -> std::string_view
+    {
+        return m_query_ids[query];
+    }
+
+    /// Ranked documents of the given query, in evaluation order.
+    [[nodiscard]] auto ranking(std::size_t query) const noexcept -> RankingView
+    {
+        return m_rankings.view(m_offsets[query], m_offsets[query + 1] - m_offsets[query]);
+    }
+
+    /// Puts (the first `depth` documents of) every ranking in the given order, sorting
+    /// on up to `threads` threads (0 uses all available cores).
+    void reorder(
+        RankingOrder order, std::size_t threads = 0, std::size_t depth = std::numeric_limits<std::size_t>::max());
+
+    /// Position of the query with the given ID, if the run retrieved anything for it.
+    [[nodiscard]] auto find_query(std::string_view query_id) const noexcept
+        -> std::optional<std::size_t>;
+
+  private:
+    Run() = default;
+
+    /// Assembles a run from parsed lines, chunk by chunk in input order; `storage`
+    /// owns the text the lines point into.
+    [[nodiscard]] static auto from_chunks(
+        std::shared_ptr<void const> storage,
+        std::vector<std::vector<detail::RunLine>> chunks,
+        RunParseOptions options) -> Run;
+
+    /// Owns the text the views point into: a `Buffer`, or the decompressed pieces of a
+    /// compressed run.
+    std::shared_ptr<void const> m_storage;
+    std::shared_ptr<DocDictionary const> m_dictionary;
+    std::string_view m_tag;
+    std::vector<std::string_view> m_query_ids;
+    std::vector<std::size_t> m_offsets;
+    RankingColumns m_rankings;
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "eval_metrics/detail/run_line.hpp"
+#include "eval_metrics/doc_dictionary.hpp"
+#include "eval_metrics/input_stream.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace eval_metrics {
+
+/// Reads a TREC or JSON Lines run one query at a time.
+///
+/// The file must be grouped by query ID (each query's lines contiguous; the groups
+/// themselves may come in any order). Only the current query's lines are held in
+/// memory, so the peak footprint is bounded by the largest ranking rather than the
+/// whole run. A query that reappears after another one raises `UngroupedRunError`.
+/// The file is read, and decompressed if it is gzip or zstd, on a background thread.
+class RunStream {
+  public:
+    /// Opens the run file. Documents are resolved against `options.dictionary`, if
+    /// given, and rankings are ordered as `options` asks; its thread count is ignored.
+    /// Throws `IoError`.
+    explicit RunStream(std::filesystem::path const& path, RunParseOptions options = {});
+
+    RunStream(RunStream const&) = delete;
+    RunStream(RunStream&&) = delete;
+    auto operator=(RunStream const&) -> RunStream& = delete;
+    auto operator=(RunStream&&) -> RunStream& = delete;
+    ~RunStream() = default;
+
+    /// Advances to the next query. Returns `false` at the end of the file.
+    /// Throws `ParseError`, `UngroupedRunError`, or `IoError`.
+    [[nodiscard]] auto next() -> bool;
+
+    /// The dictionary the documents are resolved against, or null if they are unresolved.
+    [[nodiscard]] auto dictionary() const noexcept -> std::shared_ptr<DocDictionary const> const&
+    {
+        return m_dictionary;
+    }
+
+    /// ID of the current query; valid until the next call to `next()`.
+    [[nodiscard]] auto query_id() const noexcept -> std::string_view { return m_query_id; }
+
+    /// Ranking of the current query in evaluation order; valid until the next call to `next()`.
+    [[nodiscard]] auto ranking() const noexcept -> RankingView { return m_docs.view(); }
+
+    /// The run tag of the first line, once it has been read.
+    [[nodiscard]] auto tag() const noexcept -> std::string_view { return m_tag; }
+
+  private:
+    /// Moves the current block to the front of the window and reads more input,
+    /// growing the window if the block fills it. Sets `m_eof` at the end of the file.
+    void refill(std::size_t block_begin);
+
+    [[nodiscard]] auto next_trec() -> bool;
+    [[nodiscard]] auto next_json() -> bool;
+
+    /// Checks that the block just read is the first of its query and orders its
+    /// ranking; returns `false` if it is empty (at the end of the file).
+    [[nodiscard]] auto finish_block(std::size_t query_line) -> bool;
+
+    InputStream m_input;
+    std::shared_ptr<DocDictionary const> m_dictionary;
+    RankingOrder m_order;
+    std::size_t m_depth;
+    std::vector<char> m_window;
+    std::size_t m_pos = 0;
+    std::size_t m_end = 0;
+    bool m_eof = false;
+    std::size_t m_line_number = 0;
+    bool m_format_known = false;
+    bool m_json = false;
+    /// Strings decoded from JSON escapes in the current block.
+    std::deque<std::string> m_arena;
+    std::vector<detail::RunLine> m_json_lines;
+
+    std::string_view m_query_id;
+    RankingColumns m_docs;
+    SortBuffers m_sort_buffers;
+    std::string m_tag;
+    std::unordered_set<std::string> m_seen;
+};
+
+}  // namespace eval_metrics
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#include "eval_metrics/fused.hpp"
+#include "eval_metrics/metrics.hpp"
+#include "eval_metrics/qrels_statistics.hpp"
+
+/// Metric sets fixed at compile time, for callers that evaluate many small rankings
+/// (such as a training loop) and cannot afford to parse specifications or dispatch on
+/// them per ranking:
+///
+///     using Set = Metrics<AP, NDCG<10>, P<5>, P<10>>;
+///     auto values = evaluate<Set>(grades, qrels.statistics(), query);
+///     double p10 = values.get<P<10>>();
+///
+/// The cutoffs of a set are merged at compile time, and the values come back in a
+/// fixed-size struct. The numbers come from the same `fused_pass` and `fused_*`
+/// functions as the runtime `EvaluationPlan`, so both paths agree exactly.
+namespace eval_metrics {
+
+namespace detail {
+
+/// Results of the fused passes over a ranking and its ideal ranking, at the cutoffs of
+/// the metric set `Set`.
+template <typename Set>
+struct StaticPass {
+    /// Position of cutoff `K` in `Set::cutoffs`.
+    template <std::size_t K>
+    static constexpr std::size_t slot = static_cast<std::size_t>(
+        std::find(Set::cutoffs.begin(), Set::cutoffs.end(), K) - Set::cutoffs.begin());
+
+    std::size_t num_ret = 0;
+    std::size_t num_rel = 0;
+    FusedTotals totals;
+    std::array<std::size_t, Set::cutoffs.size()> relevant_at{};
+    std::array<double, Set::cutoffs.size()> dcg_at{};
+    std::array<double, Set::cutoffs.size()> ideal_dcg_at{};
+    double ideal_dcg = 0.0;
+
+    void run(std::span<std::int32_t const> grades, std::int32_t relevance_level) noexcept
+    {
+        num_ret = grades.size();
+        fused_pass<Set::needs_dcg>(grades, num_rel, relevance_level, Set::cutoffs, relevant_at, dcg_at, totals);
+    }
+};
+
+/// Number of distinct cutoffs other than `no_cutoff`.
+template <std::size_t N>
+[[nodiscard]] constexpr auto count_distinct_cutoffs(std::array<std::size_t, N> cutoffs) noexcept -> std::size_t
+{
+    std::sort(cutoffs.begin(), cutoffs.end());
+    auto end = std::find(cutoffs.begin(), cutoffs.end(), no_cutoff);
+    return static_cast<std::size_t>(std::unique(cutoffs.begin(), end) - cutoffs.begin());
+}
+
+/// The distinct cutoffs other than `no_cutoff`, in increasing order.
+template <std::size_t Count, std::size_t N>
+[[nodiscard]] constexpr auto distinct_cutoffs(std::array<std::size_t, N> cutoffs) noexcept
+    -> std::array<std::size_t, Count>
+{
+    std::sort(cutoffs.begin(), cutoffs.end());
+    auto end = std::find(cutoffs.begin(), cutoffs.end(), no_cutoff);
+    std::unique(cutoffs.begin(), end);
+    std::array<std::size_t, Count> distinct{};
+    std::copy_n(cutoffs.begin(), Count, distinct.begin());
+    return distinct;
+}
+
+}  // namespace detail
+
+// Measures of a metric set. Each declares its cutoff (`no_cutoff` if it has none) and
+// whether it reads the DCG, and derives its value from a `detail::StaticPass`.
+
+struct NumRet {
+    static constexpr std::size_t cutoff = no_cutoff;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return static_cast<double>(pass.num_ret);
+    }
+};
+
+struct NumRel {
+    static constexpr std::size_t cutoff = no_cutoff;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return static_cast<double>(pass.num_rel);
+    }
+};
+
+struct NumRelRet {
+    static constexpr std::size_t cutoff = no_cutoff;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return static_cast<double>(pass.totals.relevant);
+    }
+};
+
+struct AP {
+    static constexpr std::size_t cutoff = no_cutoff;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return fused_average_precision(pass.totals, pass.num_rel);
+    }
+};
+
+struct RPrec {
+    static constexpr std::size_t cutoff = no_cutoff;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return fused_r_precision(pass.totals, pass.num_rel);
+    }
+};
+
+struct RR {
+    static constexpr std::size_t cutoff = no_cutoff;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return fused_reciprocal_rank(pass.totals);
+    }
+};
+
+template <std::size_t K>
+struct P {
+    static_assert(K > 0 && K != no_cutoff, "P needs a cutoff");
+    static constexpr std::size_t cutoff = K;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return fused_precision(pass.relevant_at[Pass::template slot<K>], K);
+    }
+};
+
+template <std::size_t K>
+struct Recall {
+    static_assert(K > 0 && K != no_cutoff, "Recall needs a cutoff");
+    static constexpr std::size_t cutoff = K;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return fused_recall(pass.relevant_at[Pass::template slot<K>], pass.num_rel);
+    }
+};
+
+template <std::size_t K>
+struct Success {
+    static_assert(K > 0 && K != no_cutoff, "Success needs a cutoff");
+    static constexpr std::size_t cutoff = K;
+    static constexpr bool needs_dcg = false;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        return fused_success(pass.relevant_at[Pass::template slot<K>]);
+    }
+};
+
+/// nDCG at `K`, or of the whole ranking by default.
+template <std::size_t K = no_cutoff>
+struct NDCG {
+    static_assert(K > 0, "NDCG needs a positive cutoff");
+    static constexpr std::size_t cutoff = K;
+    static constexpr bool needs_dcg = true;
+
+    template <typename Pass>
+    [[nodiscard]] static constexpr auto value(Pass const& pass) noexcept -> double
+    {
+        if constexpr (K == no_cutoff) {
+            return fused_ndcg(pass.totals.dcg, pass.ideal_dcg);
+        } else {
+            return fused_ndcg(pass.dcg_at[Pass::template slot<K>], pass.ideal_dcg_at[Pass::template slot<K>]);
+        }
+    }
+};
+
+/// A set of distinct measures, evaluated together by `evaluate`.
+template <typename... Measures>
+struct Metrics {
+    static constexpr std::size_t size = sizeof...(Measures);
+    static_assert(size > 0, "a metric set needs measures");
+    static constexpr bool needs_dcg = (Measures::needs_dcg || ...);
+
+    /// Distinct cutoffs of the measures, in increasing order.
+    static constexpr auto cutoffs =
+        detail::distinct_cutoffs<detail::count_distinct_cutoffs<size>({Measures::cutoff...})>(
+            std::array<std::size_t, size>{Measures::cutoff...});
+
+    /// Position of `Measure` in the set.
+    template <typename Measure>
+    static constexpr std::size_t index = [] {
+        constexpr std::array<bool, size> matches{std::is_same_v<Measure, Measures>...};
+        static_assert(std::count(matches.begin(), matches.end(), true) == 1, "measure not in the set exactly once");
+        return static_cast<std::size_t>(std::find(matches.begin(), matches.end(), true) - matches.begin());
+    }();
+
+    /// The values of the measures, in the order of the set.
+    struct Values {
+        std::array<double, size> values{};
+
+        template <typename Measure>
+        [[nodiscard]] constexpr auto get() const noexcept -> double
+        {
+            return values[index<Measure>];
+        }
+    };
+
+    [[nodiscard]] static auto values(detail::StaticPass<Metrics> const& pass) noexcept -> Values
+    {
+        return {{Measures::value(pass)...}};
+    }
+};
+
+/// Evaluates the ranking with the given gain column (see `metrics.hpp`) for the qrels
+/// query at position `query`, whose ideal DCG and number of relevant documents come
+/// from the qrels statistics.
+template <typename Set>
+[[nodiscard]] auto evaluate(
+    std::span<std::int32_t const> grades,
+    QrelsStatistics const& statistics,
+    std::size_t query,
+    std::int32_t relevance_level = 1) noexcept -> typename Set::Values
+{
+    detail::StaticPass<Set> pass;
+    pass.num_rel = statistics.num_relevant(query, relevance_level);
+    pass.run(grades, relevance_level);
+    if constexpr (Set::needs_dcg) {
+        for (std::size_t slot = 0; slot < Set::cutoffs.size(); ++slot) {
+            pass.ideal_dcg_at[slot] = statistics.ideal_dcg(query, Set::cutoffs[slot]);
+        }
+        pass.ideal_dcg = statistics.ideal_dcg(query);
+    }
+    return Set::values(pass);
+}
+
+/// Evaluates the ranking with the given gain column against the query's judged grades
+/// `ideal`, sorted in decreasing order, without qrels: for rankings whose judgments are
+/// at hand, as in training.
+template <typename Set>
+[[nodiscard]] auto evaluate(
+    std::span<std::int32_t const> grades, std::span<std::int32_t const> ideal, std::int32_t relevance_level = 1) noexcept
+    -> typename Set::Values
+{
+    detail::StaticPass<Set> pass;
+    pass.num_rel = relevant_retrieved(ideal, relevance_level);
+    pass.run(grades, relevance_level);
+    if constexpr (Set::needs_dcg) {
+        // The ideal DCG at each cutoff, summed exactly as `dcg` sums it.
+        FusedTotals ideal_totals;
+        std::array<std::size_t, Set::cutoffs.size()> unused{};
+        fused_pass<true>(ideal, 0, relevance_level, Set::cutoffs, unused, pass.ideal_dcg_at, ideal_totals);
+        pass.ideal_dcg = ideal_totals.dcg;
+    }
+    return Set::values(pass);
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,306 @@
+#include "eval_metrics/ann.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EVAL_METRICS_X86 1
+#include <immintrin.h>
+#endif
+
+#include "eval_metrics/detail/parallel.hpp"
+#include "eval_metrics/detail/intersection.hpp"
+#include "eval_metrics/error.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+/// Queries evaluated by each parallel task; fixed so that the summary, summed block
+/// by block, is the same with any number of threads.
+constexpr std::size_t block_size = 4096;
+
+[[nodiscard]] auto read_u32(char const* data) noexcept -> std::uint32_t
+{
+    std::uint32_t value = 0;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+[[nodiscard]] auto parse_count(std::string_view spec, std::string_view input) -> std::size_t
+{
+    std::size_t value = 0;
+    auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (input.empty() || ec != std::errc() || ptr != input.data() + input.size() || value == 0) {
+        throw Error("invalid measure " + std::string(spec));
+    }
+    return value;
+}
+
+[[nodiscard]] auto sum(std::span<float const> distances) noexcept -> double
+{
+    double total = 0.0;
+    for (auto distance : distances) {
+        total += distance;
+    }
+    return total;
+}
+
+}  // namespace
+
+namespace detail {
+
+namespace {
+
+auto count_common_scalar(std::span<std::int32_t const> truth, std::span<std::int32_t const> found) noexcept
+    -> std::size_t
+{
+    std::size_t common = 0;
+    for (auto id : truth) {
+        common += static_cast<std::size_t>(std::find(found.begin(), found.end(), id) != found.end());
+    }
+    return common;
+}
+
+#ifdef EVAL_METRICS_X86
+
+/// Holds eight true neighbors in a register at a time and compares each result with
+/// all of them, marking the lanes that matched.
+__attribute__((target("avx2"))) auto count_common_avx2(
+    std::span<std::int32_t const> truth, std::span<std::int32_t const> found) noexcept -> std::size_t
+{
+    auto const lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    std::size_t common = 0;
+    for (std::size_t base = 0; base < truth.size(); base += 8) {
+        auto lanes = static_cast<int>(std::min<std::size_t>(8, truth.size() - base));
+        auto const* ptr = truth.data() + base;
+        __m256i block;
+        if (lanes == 8) {
+            block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(ptr));
+        } else {
+            block = _mm256_maskload_epi32(ptr, _mm256_cmpgt_epi32(_mm256_set1_epi32(lanes), lane_index));
+        }
+        auto matched = _mm256_setzero_si256();
+        for (auto id : found) {
+            matched = _mm256_or_si256(matched, _mm256_cmpeq_epi32(block, _mm256_set1_epi32(id)));
+        }
+        auto mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(matched)));
+        common += static_cast<std::size_t>(std::popcount(mask & ((1U << lanes) - 1)));
+    }
+    return common;
+}
+
+#endif
+
+}  // namespace
+
+auto intersection_kernel(Isa isa) noexcept -> IntersectionKernel
+{
+#ifdef EVAL_METRICS_X86
+    if (isa == Isa::avx2) {
+        return count_common_avx2;
+    }
+#else
+    (void)isa;
+#endif
+    return count_common_scalar;
+}
+
+}  // namespace detail
+
+template <typename T>
+auto VectorMatrix<T>::from_file(std::filesystem::path const& path) -> VectorMatrix
+{
+    auto extension = path.extension();
+    auto format = extension == ".ivecs" || extension == ".fvecs" ? VectorFormat::vecs : VectorFormat::bin;
+    try {
+        return parse(Buffer::map_file(path), format);
+    } catch (ParseError const& error) {
+        throw ParseError(path.string() + ": " + error.what());
+    }
+}
+
+template <typename T>
+auto VectorMatrix<T>::parse(std::shared_ptr<Buffer const> buffer, VectorFormat format) -> VectorMatrix
+{
+    static_assert(sizeof(T) == 4);
+    VectorMatrix matrix;
+    auto const* data = buffer->view().data();
+    auto size = buffer->size();
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(T) != 0) {
+        throw ParseError("misaligned vector data");
+    }
+    if (format == VectorFormat::bin) {
+        if (size < 8) {
+            throw ParseError("missing vector file header");
+        }
+        matrix.m_rows = read_u32(data);
+        matrix.m_dim = read_u32(data + 4);
+        matrix.m_stride = matrix.m_dim;
+        if (matrix.m_rows * matrix.m_dim > (size - 8) / 4) {
+            throw ParseError("truncated vector file");
+        }
+        matrix.m_data = reinterpret_cast<T const*>(data + 8);
+    } else if (size > 0) {
+        if (size < 4) {
+            throw ParseError("truncated vector file");
+        }
+        matrix.m_dim = read_u32(data);
+        matrix.m_stride = matrix.m_dim + 1;
+        auto row_bytes = matrix.m_stride * 4;
+        if (size % row_bytes != 0) {
+            throw ParseError("truncated vector file");
+        }
+        matrix.m_rows = size / row_bytes;
+        for (std::size_t row = 1; row < matrix.m_rows; ++row) {
+            if (read_u32(data + row * row_bytes) != matrix.m_dim) {
+                throw ParseError("row " + std::to_string(row) + " has dimension "
+                                 + std::to_string(read_u32(data + row * row_bytes)) + " instead of "
+                                 + std::to_string(matrix.m_dim));
+            }
+        }
+        matrix.m_data = reinterpret_cast<T const*>(data + 4);
+    }
+    matrix.m_buffer = std::move(buffer);
+    return matrix;
+}
+
+template class VectorMatrix<std::int32_t>;
+template class VectorMatrix<float>;
+
+auto AnnMeasure::parse(std::string_view spec) -> AnnMeasure
+{
+    auto at = spec.find('@');
+    if (at == std::string_view::npos) {
+        throw Error("invalid measure " + std::string(spec));
+    }
+    auto name = spec.substr(0, at);
+    auto depth = parse_count(spec, spec.substr(at + 1));
+    if (name == "recall") {
+        return {Kind::recall, depth, depth};
+    }
+    if (name == "ratio") {
+        return {Kind::distance_ratio, depth, depth};
+    }
+    auto dash = name.find('-');
+    if (dash != std::string_view::npos && name.substr(dash + 1) == "recall") {
+        return {Kind::recall, parse_count(spec, name.substr(0, dash)), depth};
+    }
+    throw Error("unknown measure " + std::string(spec));
+}
+
+auto AnnMeasure::name() const -> std::string
+{
+    if (kind == Kind::distance_ratio) {
+        return "ratio@" + std::to_string(k);
+    }
+    if (k == depth) {
+        return "recall@" + std::to_string(k);
+    }
+    return std::to_string(k) + "-recall@" + std::to_string(depth);
+}
+
+AnnEvaluator::AnnEvaluator(NeighborMatrix const& ground_truth, AnnOptions options, DistanceMatrix const* distances)
+    : m_truth(&ground_truth), m_distances(distances), m_options(std::move(options))
+{
+    for (auto const& spec : m_options.measures) {
+        auto measure = AnnMeasure::parse(spec);
+        if (measure.k > ground_truth.dim()) {
+            throw Error(
+                "measure " + spec + " needs " + std::to_string(measure.k) + " true neighbors, the ground truth has "
+                + std::to_string(ground_truth.dim()));
+        }
+        if (measure.kind == AnnMeasure::Kind::distance_ratio) {
+            if (distances == nullptr) {
+                throw Error("measure " + spec + " needs the distances of the true neighbors");
+            }
+            if (distances->rows() != ground_truth.rows() || distances->dim() < measure.k) {
+                throw Error("distances of the true neighbors do not match the ground truth");
+            }
+            m_needs_distances = true;
+        }
+        m_depth = std::max(m_depth, measure.depth);
+        m_metrics.push_back(MetricInfo{measure.name()});
+        m_measures.push_back(measure);
+    }
+}
+
+void AnnEvaluator::evaluate_query(
+    std::size_t query, std::span<std::int32_t const> found, std::span<float const> distances,
+    std::span<double> values) const
+{
+    auto truth = m_truth->row(query);
+    for (std::size_t idx = 0; idx < m_measures.size(); ++idx) {
+        auto const& measure = m_measures[idx];
+        auto depth = std::min(measure.depth, found.size());
+        if (measure.kind == AnnMeasure::Kind::recall) {
+            auto common = detail::count_common(truth.first(measure.k), found.first(depth));
+            values[idx] = static_cast<double>(common) / static_cast<double>(measure.k);
+        } else {
+            auto ideal = sum(m_distances->row(query).first(measure.k));
+            auto actual = sum(distances.first(std::min(measure.k, distances.size())));
+            values[idx] = ideal == 0.0 && actual == 0.0 ? 1.0 : actual / ideal;
+        }
+    }
+}
+
+auto AnnEvaluator::evaluate(
+    NeighborMatrix const& results, DistanceMatrix const* distances, std::vector<double>* per_query) const
+    -> std::vector<double>
+{
+    if (results.rows() != m_truth->rows()) {
+        throw Error(
+            "results have " + std::to_string(results.rows()) + " queries, the ground truth "
+            + std::to_string(m_truth->rows()));
+    }
+    if (results.dim() < m_depth) {
+        throw Error(
+            "results have " + std::to_string(results.dim()) + " neighbors per query, the measures need "
+            + std::to_string(m_depth));
+    }
+    if (m_needs_distances
+        && (distances == nullptr || distances->rows() != results.rows() || distances->dim() != results.dim())) {
+        throw Error("distance ratios need the distances of the results, of the same shape as the results");
+    }
+
+    auto num_metrics = m_metrics.size();
+    auto num_queries = results.rows();
+    auto blocks = (num_queries + block_size - 1) / block_size;
+    if (per_query != nullptr) {
+        per_query->assign(num_queries * num_metrics, 0.0);
+    }
+    std::vector<double> block_sums(blocks * num_metrics, 0.0);
+    detail::parallel_for(blocks, m_options.threads, [&](std::size_t block) {
+        std::vector<double> values(num_metrics);
+        auto sums = std::span<double>(block_sums).subspan(block * num_metrics, num_metrics);
+        auto last = std::min(num_queries, (block + 1) * block_size);
+        for (auto query = block * block_size; query < last; ++query) {
+            auto found = results.row(query).first(m_depth);
+            auto found_distances = m_needs_distances ? distances->row(query) : std::span<float const>{};
+            evaluate_query(query, found, found_distances, values);
+            for (std::size_t idx = 0; idx < num_metrics; ++idx) {
+                sums[idx] += values[idx];
+            }
+            if (per_query != nullptr) {
+                std::copy(values.begin(), values.end(), per_query->begin() + query * num_metrics);
+            }
+        }
+    });
+
+    std::vector<double> summary(num_metrics, 0.0);
+    for (std::size_t block = 0; block < blocks; ++block) {
+        for (std::size_t idx = 0; idx < num_metrics; ++idx) {
+            summary[idx] += block_sums[block * num_metrics + idx];
+        }
+    }
+    if (num_queries > 0) {
+        for (auto& value : summary) {
+            value /= static_cast<double>(num_queries);
+        }
+    }
+    return summary;
+}
+
+}  // namespace eval_metrics
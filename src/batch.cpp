@@ -0,0 +1,49 @@
+#include "eval_metrics/batch.hpp"
+
+#include <algorithm>
+
+#include "eval_metrics/binary_format.hpp"
+#include "eval_metrics/detail/parallel.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/run_stream.hpp"
+
+namespace eval_metrics {
+
+auto evaluate_runs(
+    Evaluator const& evaluator, std::span<std::filesystem::path const> runs, BatchOptions const& options)
+    -> std::vector<RunEvaluation>
+{
+    std::vector<RunEvaluation> evaluations(runs.size());
+    auto threads = detail::resolve_threads(options.threads);
+    RunParseOptions parsing;
+    parsing.threads = std::max<std::size_t>(1, threads / std::max<std::size_t>(runs.size(), 1));
+    parsing.dictionary = evaluator.qrels().dictionary();
+    parsing.order = options.order;
+    parsing.depth = evaluator.required_depth();
+
+    detail::parallel_for(runs.size(), threads, [&](std::size_t idx) {
+        auto& evaluation = evaluations[idx];
+        evaluation.path = runs[idx];
+        try {
+            // Binary runs load without parsing, so they are never streamed.
+            if (options.stream && !binary_source_stamp(runs[idx])) {
+                try {
+                    RunStream stream(runs[idx], parsing);
+                    evaluation.results = evaluator.evaluate(stream);
+                    evaluation.tag = stream.tag();
+                    return;
+                } catch (UngroupedRunError const& error) {
+                    evaluation.stream_fallback = error.what();
+                }
+            }
+            auto run = options.load_run ? options.load_run(runs[idx], parsing) : Run::from_file(runs[idx], parsing);
+            evaluation.results = evaluator.evaluate(run);
+            evaluation.tag = run.tag();
+        } catch (...) {
+            evaluation.error = std::current_exception();
+        }
+    });
+    return evaluations;
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,472 @@
+#include "eval_metrics/binary_format.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "eval_metrics/error.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little, "the binary format is little-endian");
+
+constexpr std::array<char, 8> magic{'\x89', 'E', 'V', 'M', 'C', 'O', 'L', '\n'};
+
+enum class Kind : std::uint32_t { qrels = 1, run = 2 };
+
+enum SectionId : std::size_t {
+    query_offsets,
+    query_bytes,
+    doc_offsets,
+    doc_bytes,
+    entry_offsets,
+    doc_indices,
+    values,
+    ranks,
+    tag,
+    grade_offsets,
+    grade_values,
+    grade_counts,
+    ideal_offsets,
+    ideal_gains,
+    ideal_dcg,
+    num_sections
+};
+
+struct Section {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+struct Header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    Kind kind;
+    std::uint64_t num_queries;
+    std::uint64_t num_entries;
+    std::uint64_t num_docs;
+    std::uint64_t source_size;
+    std::int64_t source_mtime_ns;
+    std::uint64_t checksum;
+    std::array<Section, num_sections> sections;
+};
+static_assert(std::is_trivially_copyable_v<Header> && sizeof(Header) % 8 == 0);
+
+constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+[[nodiscard]] auto mix(std::uint64_t lane, std::uint64_t word) noexcept -> std::uint64_t
+{
+    return std::rotl(lane + word * prime2, 31) * prime1;
+}
+
+/// Word-wise 64-bit checksum with four independent lanes, fast enough to verify every
+/// load; it detects corruption and truncation, it is not a cryptographic hash.
+[[nodiscard]] auto checksum(std::string_view bytes, std::uint64_t seed) noexcept -> std::uint64_t
+{
+    std::array<std::uint64_t, 4> lanes{seed + prime1, seed ^ prime2, seed, seed - prime1};
+    auto const* data = bytes.data();
+    auto remaining = bytes.size();
+    while (remaining >= 32) {
+        for (auto& lane : lanes) {
+            std::uint64_t word = 0;
+            std::memcpy(&word, data, 8);
+            lane = mix(lane, word);
+            data += 8;
+        }
+        remaining -= 32;
+    }
+    std::uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12)
+        + std::rotl(lanes[3], 18) + bytes.size();
+    while (remaining > 0) {
+        std::uint64_t word = 0;
+        auto len = std::min<std::size_t>(remaining, 8);
+        std::memcpy(&word, data, len);
+        hash = mix(hash, word);
+        data += len;
+        remaining -= len;
+    }
+    hash ^= hash >> 33U;
+    hash *= prime2;
+    hash ^= hash >> 29U;
+    return hash;
+}
+
+[[nodiscard]] auto file_checksum(Header header, std::string_view payload) noexcept -> std::uint64_t
+{
+    header.checksum = 0;
+    auto seed = checksum({reinterpret_cast<char const*>(&header), sizeof(Header)}, 0);
+    return checksum(payload, seed);
+}
+
+/// Accumulates the sections of a file in memory.
+class FileBuilder {
+  public:
+    FileBuilder(Kind kind, SourceStamp source) : m_bytes(sizeof(Header), '\0')
+    {
+        m_header.magic = magic;
+        m_header.version = binary_format_version;
+        m_header.kind = kind;
+        m_header.source_size = source.size;
+        m_header.source_mtime_ns = source.mtime_ns;
+    }
+
+    [[nodiscard]] auto header() noexcept -> Header& { return m_header; }
+
+    template <typename T>
+    void append(SectionId id, std::span<T const> column)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_bytes.resize((m_bytes.size() + 7) / 8 * 8, '\0');
+        m_header.sections[id] = {m_bytes.size(), column.size_bytes()};
+        m_bytes.append(reinterpret_cast<char const*>(column.data()), column.size_bytes());
+    }
+
+    /// Appends a string table as an offsets section and a bytes section.
+    void append_strings(SectionId offsets_id, SectionId bytes_id, std::span<std::string_view const> strings)
+    {
+        std::vector<std::uint64_t> offsets{0};
+        std::string bytes;
+        for (auto str : strings) {
+            bytes.append(str);
+            offsets.push_back(bytes.size());
+        }
+        append(offsets_id, std::span<std::uint64_t const>(offsets));
+        append(bytes_id, std::span<char const>(bytes));
+    }
+
+    /// Writes the file through a temporary so that readers never see a partial file.
+    /// The temporary is unique to the writer, so concurrent writers of the same cache
+    /// (in a batch, or in other processes) do not clobber each other.
+    void write(std::filesystem::path const& path)
+    {
+        static std::atomic_size_t writers{0};
+        m_bytes.resize((m_bytes.size() + 7) / 8 * 8, '\0');
+        m_header.checksum = file_checksum(m_header, std::string_view(m_bytes).substr(sizeof(Header)));
+        std::memcpy(m_bytes.data(), &m_header, sizeof(Header));
+        auto temporary = path;
+        temporary += ".tmp." + std::to_string(::getpid()) + "." + std::to_string(writers++);
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(m_bytes.data(), static_cast<std::streamsize>(m_bytes.size()));
+            if (!out) {
+                throw IoError("cannot write " + temporary.string());
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temporary, path, ec);
+        if (ec) {
+            throw IoError("cannot write " + path.string() + ": " + ec.message());
+        }
+    }
+
+  private:
+    Header m_header{};
+    std::string m_bytes;
+};
+
+/// Validated access to the sections of a mapped binary file.
+class FileView {
+  public:
+    FileView(std::string_view bytes, Kind kind) : m_bytes(bytes)
+    {
+        if (!is_binary_format(bytes) || bytes.size() < sizeof(Header)) {
+            throw ParseError("not a binary eval_metrics file");
+        }
+        std::memcpy(&m_header, bytes.data(), sizeof(Header));
+        if (m_header.version != binary_format_version) {
+            throw ParseError(
+                "unsupported binary format version " + std::to_string(m_header.version)
+                + " (expected " + std::to_string(binary_format_version) + ")");
+        }
+        if (m_header.kind != kind) {
+            throw ParseError(kind == Kind::qrels ? "binary file holds a run, not qrels"
+                                                 : "binary file holds qrels, not a run");
+        }
+        if (file_checksum(m_header, bytes.substr(sizeof(Header))) != m_header.checksum) {
+            throw ParseError("binary file is corrupt: checksum mismatch");
+        }
+    }
+
+    [[nodiscard]] auto header() const noexcept -> Header const& { return m_header; }
+
+    template <typename T>
+    [[nodiscard]] auto section(SectionId id, std::uint64_t count) const -> std::span<T const>
+    {
+        auto const& section = m_header.sections[id];
+        if (section.offset % alignof(T) != 0 || section.offset > m_bytes.size()
+            || section.size > m_bytes.size() - section.offset || section.size != count * sizeof(T)) {
+            throw ParseError("binary file is corrupt: bad section " + std::to_string(id));
+        }
+        return {reinterpret_cast<T const*>(m_bytes.data() + section.offset), count};
+    }
+
+    [[nodiscard]] auto strings(SectionId offsets_id, SectionId bytes_id, std::uint64_t count) const
+        -> std::vector<std::string_view>
+    {
+        auto offsets = section<std::uint64_t>(offsets_id, count + 1);
+        auto bytes = section<char>(bytes_id, m_header.sections[bytes_id].size);
+        check_offsets(offsets, bytes.size());
+        std::vector<std::string_view> strings;
+        strings.reserve(count);
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            strings.emplace_back(bytes.data() + offsets[idx], offsets[idx + 1] - offsets[idx]);
+        }
+        return strings;
+    }
+
+    [[nodiscard]] auto query_ranges() const -> std::vector<std::size_t>
+    {
+        auto offsets = section<std::uint64_t>(entry_offsets, m_header.num_queries + 1);
+        check_offsets(offsets, m_header.num_entries);
+        return {offsets.begin(), offsets.end()};
+    }
+
+    /// A per-query offset table into a section of `T`, and that section.
+    template <typename T>
+    [[nodiscard]] auto query_column(SectionId offsets_id, SectionId column_id) const
+        -> std::pair<std::span<std::uint64_t const>, std::span<T const>>
+    {
+        auto offsets = section<std::uint64_t>(offsets_id, m_header.num_queries + 1);
+        auto column = section<T>(column_id, m_header.sections[column_id].size / sizeof(T));
+        check_offsets(offsets, column.size());
+        return {offsets, column};
+    }
+
+  private:
+    static void check_offsets(std::span<std::uint64_t const> offsets, std::uint64_t end)
+    {
+        if (offsets.front() != 0 || offsets.back() != end
+            || !std::is_sorted(offsets.begin(), offsets.end())) {
+            throw ParseError("binary file is corrupt: bad offset table");
+        }
+    }
+
+    std::string_view m_bytes;
+    Header m_header{};
+};
+
+[[nodiscard]] auto checked_index(std::uint32_t idx, std::size_t num_docs) -> std::uint32_t
+{
+    if (idx >= num_docs) {
+        throw ParseError("binary file is corrupt: document index out of range");
+    }
+    return idx;
+}
+
+}  // namespace
+
+auto SourceStamp::of(std::filesystem::path const& path) -> SourceStamp
+{
+    struct stat st {};
+    if (::stat(path.c_str(), &st) != 0) {
+        throw IoError("cannot stat " + path.string() + ": " + std::strerror(errno));
+    }
+    return {static_cast<std::uint64_t>(st.st_size),
+            static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec};
+}
+
+auto is_binary_format(std::string_view bytes) noexcept -> bool
+{
+    return bytes.size() >= magic.size() && std::equal(magic.begin(), magic.end(), bytes.begin());
+}
+
+void write_binary(std::filesystem::path const& path, Qrels const& qrels, SourceStamp source)
+{
+    std::vector<std::string_view> query_ids;
+    std::vector<std::uint64_t> offsets{0};
+    std::vector<std::uint32_t> indices;
+    std::vector<std::int32_t> grades;
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        query_ids.push_back(qrels.query_id(query));
+        for (auto const& judgment : qrels.judgments(query)) {
+            indices.push_back(judgment.id);
+            grades.push_back(judgment.grade);
+        }
+        offsets.push_back(indices.size());
+    }
+    auto const& dictionary = *qrels.dictionary();
+
+    FileBuilder builder(Kind::qrels, source);
+    builder.header().num_queries = query_ids.size();
+    builder.header().num_entries = indices.size();
+    builder.header().num_docs = dictionary.size();
+    builder.append_strings(query_offsets, query_bytes, query_ids);
+    builder.append_strings(doc_offsets, doc_bytes, dictionary.docs());
+    builder.append(entry_offsets, std::span<std::uint64_t const>(offsets));
+    builder.append(doc_indices, std::span<std::uint32_t const>(indices));
+    builder.append(values, std::span<std::int32_t const>(grades));
+    auto const& statistics = qrels.statistics().columns();
+    builder.append(grade_offsets, statistics.grade_offsets);
+    builder.append(grade_values, statistics.grade_values);
+    builder.append(grade_counts, statistics.grade_counts);
+    builder.append(ideal_offsets, statistics.ideal_offsets);
+    builder.append(ideal_gains, statistics.ideal_gains);
+    builder.append(ideal_dcg, statistics.ideal_dcg);
+    builder.write(path);
+}
+
+void write_binary(std::filesystem::path const& path, Run const& run, SourceStamp source)
+{
+    std::vector<std::string_view> query_ids;
+    std::vector<std::uint64_t> offsets{0};
+    std::vector<std::string_view> docs;
+    std::vector<double> scores;
+    std::vector<std::int64_t> rank_column;
+    for (std::size_t query = 0; query < run.num_queries(); ++query) {
+        query_ids.push_back(run.query_id(query));
+        auto ranking = run.ranking(query);
+        docs.insert(docs.end(), ranking.docs.begin(), ranking.docs.end());
+        scores.insert(scores.end(), ranking.scores.begin(), ranking.scores.end());
+        rank_column.insert(rank_column.end(), ranking.ranks.begin(), ranking.ranks.end());
+        offsets.push_back(docs.size());
+    }
+    std::vector<std::uint32_t> indices;
+    indices.reserve(docs.size());
+    auto dictionary = DocDictionary::from_docs(docs);
+    for (auto doc : docs) {
+        indices.push_back(dictionary.lookup(doc));
+    }
+
+    FileBuilder builder(Kind::run, source);
+    builder.header().num_queries = query_ids.size();
+    builder.header().num_entries = docs.size();
+    builder.header().num_docs = dictionary.size();
+    builder.append_strings(query_offsets, query_bytes, query_ids);
+    builder.append_strings(doc_offsets, doc_bytes, dictionary.docs());
+    builder.append(entry_offsets, std::span<std::uint64_t const>(offsets));
+    builder.append(doc_indices, std::span<std::uint32_t const>(indices));
+    builder.append(values, std::span<double const>(scores));
+    builder.append(ranks, std::span<std::int64_t const>(rank_column));
+    builder.append(tag, std::span<char const>(run.tag()));
+    builder.write(path);
+}
+
+auto read_binary_qrels(std::shared_ptr<Buffer const> buffer) -> Qrels
+{
+    FileView file(buffer->view(), Kind::qrels);
+    auto const& header = file.header();
+    auto query_ids = file.strings(query_offsets, query_bytes, header.num_queries);
+    auto dictionary = file.strings(doc_offsets, doc_bytes, header.num_docs);
+    auto offsets = file.query_ranges();
+    auto indices = file.section<std::uint32_t>(doc_indices, header.num_entries);
+    auto grades = file.section<std::int32_t>(values, header.num_entries);
+    std::vector<Judgment> judgments(header.num_entries);
+    for (std::size_t idx = 0; idx < judgments.size(); ++idx) {
+        auto id = checked_index(indices[idx], dictionary.size());
+        judgments[idx] = {dictionary[id], grades[idx], id};
+    }
+    QrelsStatistics::Columns statistics;
+    std::tie(statistics.grade_offsets, statistics.grade_values) =
+        file.query_column<std::int32_t>(grade_offsets, grade_values);
+    statistics.grade_counts = file.section<std::uint64_t>(grade_counts, statistics.grade_values.size());
+    std::tie(statistics.ideal_offsets, statistics.ideal_gains) =
+        file.query_column<std::int32_t>(ideal_offsets, ideal_gains);
+    statistics.ideal_dcg =
+        file.section<double>(ideal_dcg, statistics.ideal_gains.size() + header.num_queries);
+    return {
+        buffer,
+        std::make_shared<DocDictionary>(std::move(dictionary)),
+        std::move(query_ids),
+        std::move(offsets),
+        std::move(judgments),
+        std::make_shared<QrelsStatistics>(buffer, statistics)};
+}
+
+auto read_binary_run(
+    std::shared_ptr<Buffer const> buffer, std::shared_ptr<DocDictionary const> dictionary) -> Run
+{
+    FileView file(buffer->view(), Kind::run);
+    auto const& header = file.header();
+    auto query_ids = file.strings(query_offsets, query_bytes, header.num_queries);
+    auto docs_of_run = file.strings(doc_offsets, doc_bytes, header.num_docs);
+    std::vector<std::uint32_t> resolved(docs_of_run.size(), unresolved_doc);
+    if (dictionary) {
+        std::transform(docs_of_run.begin(), docs_of_run.end(), resolved.begin(), [&](auto doc) {
+            return dictionary->lookup(doc);
+        });
+    }
+    auto offsets = file.query_ranges();
+    auto indices = file.section<std::uint32_t>(doc_indices, header.num_entries);
+    auto scores = file.section<double>(values, header.num_entries);
+    auto rank_column = file.section<std::int64_t>(ranks, header.num_entries);
+    auto tag_bytes = file.section<char>(tag, header.sections[tag].size);
+    RankingColumns rankings;
+    rankings.reserve(header.num_entries);
+    for (std::size_t idx = 0; idx < header.num_entries; ++idx) {
+        auto local = checked_index(indices[idx], docs_of_run.size());
+        rankings.push_back({docs_of_run[local], scores[idx], rank_column[idx], resolved[local]});
+    }
+    std::string_view run_tag(tag_bytes.data(), tag_bytes.size());
+    return {
+        std::move(buffer),
+        std::move(dictionary),
+        run_tag,
+        std::move(query_ids),
+        std::move(offsets),
+        std::move(rankings)};
+}
+
+auto binary_source_stamp(std::filesystem::path const& path) -> std::optional<SourceStamp>
+{
+    std::ifstream in(path, std::ios::binary);
+    Header header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(Header))
+        || !is_binary_format({header.magic.data(), header.magic.size()})
+        || header.version != binary_format_version) {
+        return std::nullopt;
+    }
+    return SourceStamp{header.source_size, header.source_mtime_ns};
+}
+
+auto load_qrels_cached(std::filesystem::path const& source, std::filesystem::path const& cache)
+    -> Qrels
+{
+    auto stamp = SourceStamp::of(source);
+    if (binary_source_stamp(cache) == stamp) {
+        try {
+            return read_binary_qrels(Buffer::map_file(cache));
+        } catch (ParseError const&) {
+            // A corrupt cache is rebuilt below.
+        }
+    }
+    auto qrels = Qrels::from_file(source);
+    write_binary(cache, qrels, stamp);
+    return qrels;
+}
+
+auto load_run_cached(
+    std::filesystem::path const& source, std::filesystem::path const& cache, RunParseOptions options)
+    -> Run
+{
+    auto stamp = SourceStamp::of(source);
+    if (binary_source_stamp(cache) == stamp) {
+        try {
+            auto run = read_binary_run(Buffer::map_file(cache), options.dictionary);
+            run.reorder(options.order, options.threads, options.depth);
+            return run;
+        } catch (ParseError const&) {
+            // A corrupt cache is rebuilt below.
+        }
+    }
+    auto run = Run::from_file(source, options);
+    write_binary(cache, run, stamp);
+    return run;
+}
+
+}  // namespace eval_metrics
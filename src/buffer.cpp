@@ -0,0 +1,70 @@
+#include "eval_metrics/buffer.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "eval_metrics/error.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+[[nodiscard]] auto io_error(std::filesystem::path const& path, char const* what) -> IoError
+{
+    return IoError(std::string(what) + " " + path.string() + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+auto Buffer::map_file(std::filesystem::path const& path) -> std::shared_ptr<Buffer const>
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw io_error(path, "cannot open");
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        auto err = io_error(path, "cannot stat");
+        ::close(fd);
+        throw err;
+    }
+    std::shared_ptr<Buffer> buffer(new Buffer());
+    auto size = static_cast<std::size_t>(st.st_size);
+    if (size > 0) {
+        void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            auto err = io_error(path, "cannot map");
+            ::close(fd);
+            throw err;
+        }
+        ::madvise(addr, size, MADV_SEQUENTIAL);
+        buffer->m_data = static_cast<char const*>(addr);
+        buffer->m_size = size;
+        buffer->m_mapped = true;
+    }
+    ::close(fd);
+    return buffer;
+}
+
+auto Buffer::from_string(std::string data) -> std::shared_ptr<Buffer const>
+{
+    std::shared_ptr<Buffer> buffer(new Buffer());
+    buffer->m_owned = std::move(data);
+    buffer->m_data = buffer->m_owned.data();
+    buffer->m_size = buffer->m_owned.size();
+    return buffer;
+}
+
+Buffer::~Buffer()
+{
+    if (m_mapped) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+}  // namespace eval_metrics
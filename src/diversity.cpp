@@ -0,0 +1,359 @@
+#include "eval_metrics/diversity.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <string>
+
+#include "eval_metrics/detail/numeric.hpp"
+#include "eval_metrics/detail/tokenizer.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/input_stream.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+struct IntentLine {
+    std::string_view query;
+    std::string_view doc;
+    std::string_view intent;
+    std::int32_t grade;
+};
+
+[[nodiscard]] auto line_less(IntentLine const& lhs, IntentLine const& rhs) noexcept -> bool
+{
+    if (lhs.query != rhs.query) {
+        return lhs.query < rhs.query;
+    }
+    if (lhs.doc != rhs.doc) {
+        return lhs.doc < rhs.doc;
+    }
+    return lhs.intent < rhs.intent;
+}
+
+[[nodiscard]] auto parse_grade(std::string_view field, std::size_t line) -> std::int32_t
+{
+    std::int32_t grade = 0;
+    if (!detail::parse_integer(field, grade)) {
+        throw ParseError("invalid relevance grade: " + std::string(field), line);
+    }
+    return grade;
+}
+
+}  // namespace
+
+auto IntentQrels::from_file(std::filesystem::path const& path) -> IntentQrels
+{
+    auto buffer = Buffer::map_file(path);
+    if (detect_compression(buffer->view().substr(0, 4)) != Compression::none) {
+        buffer = Buffer::from_string(InputStream(path).read_all());
+    }
+    return parse(std::move(buffer));
+}
+
+auto IntentQrels::parse(std::shared_ptr<Buffer const> buffer) -> IntentQrels
+{
+    std::vector<IntentLine> lines;
+    detail::FieldTokenizer tokenizer(buffer->view());
+    std::array<std::string_view, 4> fields;
+    std::size_t count = 0;
+    while (tokenizer.next(fields, count)) {
+        if (count == 0) {
+            continue;
+        }
+        if (count != fields.size()) {
+            throw ParseError("expected 4 fields: qid intent docno rel", tokenizer.line_number());
+        }
+        lines.push_back({fields[0], fields[2], fields[1], parse_grade(fields[3], tokenizer.line_number())});
+    }
+    if (!std::is_sorted(lines.begin(), lines.end(), line_less)) {
+        std::stable_sort(lines.begin(), lines.end(), line_less);
+    }
+
+    // The documents, with their highest grade, and the distinct intents of each query.
+    std::vector<std::string_view> query_ids;
+    std::vector<std::size_t> offsets;
+    std::vector<Judgment> documents;
+    std::vector<std::size_t> intent_offsets;
+    std::vector<std::string_view> intents;
+    for (std::size_t idx = 0; idx < lines.size(); ++idx) {
+        auto const& line = lines[idx];
+        auto new_query = idx == 0 || line.query != lines[idx - 1].query;
+        if (new_query) {
+            query_ids.push_back(line.query);
+            offsets.push_back(documents.size());
+            intent_offsets.push_back(intents.size());
+        } else if (line.doc == lines[idx - 1].doc && line.intent == lines[idx - 1].intent) {
+            throw ParseError(
+                "duplicate judgment of document " + std::string(line.doc) + " for intent "
+                + std::string(line.intent) + " in query " + std::string(line.query));
+        }
+        if (new_query || line.doc != lines[idx - 1].doc) {
+            documents.push_back({line.doc, line.grade});
+        } else {
+            documents.back().grade = std::max(documents.back().grade, line.grade);
+        }
+        intents.push_back(line.intent);
+    }
+    offsets.push_back(documents.size());
+    intent_offsets.push_back(intents.size());
+    std::size_t num_intents = 0;
+    for (std::size_t query = 0; query < query_ids.size(); ++query) {
+        auto first = intents.begin() + static_cast<std::ptrdiff_t>(intent_offsets[query]);
+        auto last = intents.begin() + static_cast<std::ptrdiff_t>(intent_offsets[query + 1]);
+        std::sort(first, last);
+        auto end = std::unique(first, last);
+        if (static_cast<std::size_t>(end - first) > max_intents) {
+            throw ParseError(
+                "query " + std::string(query_ids[query]) + " has more than " + std::to_string(max_intents)
+                + " intents");
+        }
+        intent_offsets[query] = num_intents;
+        num_intents = static_cast<std::size_t>(std::move(first, end, intents.begin() + num_intents) - intents.begin());
+    }
+    intents.resize(num_intents);
+    intent_offsets.back() = num_intents;
+
+    std::vector<std::string_view> docs;
+    docs.reserve(documents.size());
+    for (auto const& document : documents) {
+        docs.push_back(document.doc);
+    }
+    auto dictionary = std::make_shared<DocDictionary>(DocDictionary::from_docs(std::move(docs)));
+    for (auto& document : documents) {
+        document.id = dictionary->lookup(document.doc);
+    }
+
+    IntentQrels qrels(Qrels(buffer, std::move(dictionary), std::move(query_ids), offsets, std::move(documents)));
+    qrels.m_doc_offsets = std::move(offsets);
+    qrels.m_intent_offsets = std::move(intent_offsets);
+    qrels.m_intents = std::move(intents);
+    qrels.m_judgments.reserve(lines.size());
+    qrels.m_judgment_offsets.reserve(qrels.m_doc_offsets.back() + 1);
+    std::size_t query = 0;
+    for (std::size_t idx = 0; idx < lines.size(); ++idx) {
+        auto const& line = lines[idx];
+        if (idx > 0 && line.query != lines[idx - 1].query) {
+            ++query;
+        }
+        if (idx == 0 || line.query != lines[idx - 1].query || line.doc != lines[idx - 1].doc) {
+            qrels.m_judgment_offsets.push_back(qrels.m_judgments.size());
+        }
+        auto labels = qrels.intents(query);
+        auto intent = std::lower_bound(labels.begin(), labels.end(), line.intent) - labels.begin();
+        qrels.m_judgments.push_back({static_cast<std::uint32_t>(intent), line.grade});
+    }
+    qrels.m_judgment_offsets.push_back(qrels.m_judgments.size());
+    return qrels;
+}
+
+DiversityEvaluator::DiversityEvaluator(IntentQrels const& qrels, DiversityOptions options)
+    : m_qrels(&qrels), m_options(std::move(options))
+{
+    auto& cutoffs = m_options.cutoffs;
+    std::sort(cutoffs.begin(), cutoffs.end());
+    cutoffs.erase(std::unique(cutoffs.begin(), cutoffs.end()), cutoffs.end());
+    if (!cutoffs.empty() && cutoffs.front() == 0) {
+        throw Error("diversity cutoffs must be positive");
+    }
+    for (auto k : cutoffs) {
+        m_metrics.push_back({"ERR-IA@" + std::to_string(k), Aggregation::mean, false, k});
+    }
+    for (auto k : cutoffs) {
+        m_metrics.push_back({"alpha-nDCG@" + std::to_string(k), Aggregation::mean, false, k});
+    }
+    m_metrics.push_back({"NRBP"});
+    for (auto k : cutoffs) {
+        m_metrics.push_back({"strec@" + std::to_string(k), Aggregation::mean, false, k});
+    }
+    auto depth = cutoffs.empty() ? std::size_t{0} : cutoffs.back();
+    m_discounts = DiscountTable(depth);
+
+    auto const& documents = qrels.documents();
+    m_doc_offsets.push_back(0);
+    std::size_t max_documents = 0;
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        auto judged = documents.judgments(query);
+        IntentMask intents = 0;
+        for (std::size_t doc = 0; doc < judged.size(); ++doc) {
+            IntentMask mask = 0;
+            for (auto [intent, grade] : qrels.judgments(query, doc)) {
+                if (is_relevant(grade, m_options.relevance_level)) {
+                    mask |= IntentMask{1} << intent;
+                }
+            }
+            m_masks.push_back(mask);
+            intents |= mask;
+        }
+        m_doc_offsets.push_back(m_masks.size());
+        m_num_intents.push_back(static_cast<std::size_t>(std::popcount(intents)));
+        max_documents = std::max(max_documents, judged.size());
+    }
+    // An intent is covered at most once per judged document, duplicates aside.
+    m_novelty.resize(max_documents + 1);
+    for (std::size_t count = 0; count < m_novelty.size(); ++count) {
+        m_novelty[count] = std::pow(1.0 - m_options.alpha, static_cast<double>(count));
+    }
+
+    Scratch scratch;
+    m_ideal_offsets.push_back(0);
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        build_ideal(query, depth, scratch);
+        m_ideal_offsets.push_back(m_ideal_dcg.size());
+    }
+}
+
+auto DiversityEvaluator::novel_gain(
+    IntentMask mask, std::span<std::uint32_t, IntentQrels::max_intents> covered) const noexcept -> double
+{
+    double gain = 0.0;
+    for (; mask != 0; mask &= mask - 1) {
+        auto& count = covered[static_cast<std::size_t>(std::countr_zero(mask))];
+        gain += count < m_novelty.size() ? m_novelty[count] : std::pow(1.0 - m_options.alpha, count);
+        ++count;
+    }
+    return gain;
+}
+
+void DiversityEvaluator::build_ideal(std::size_t query, std::size_t depth, Scratch& scratch)
+{
+    // The candidates: the documents relevant to some intent, with their novel gain.
+    std::span<IntentMask const> masks(m_masks.data() + m_doc_offsets[query], m_doc_offsets[query + 1] - m_doc_offsets[query]);
+    auto& candidates = scratch.masks;
+    candidates.clear();
+    std::copy_if(masks.begin(), masks.end(), std::back_inserter(candidates), [](auto mask) { return mask != 0; });
+    auto& gains = scratch.gains;
+    gains.clear();
+    for (auto mask : candidates) {
+        gains.push_back(static_cast<double>(std::popcount(mask)));
+    }
+    scratch.covered.fill(0);
+    std::array<std::uint32_t, IntentQrels::max_intents> probe{};
+    double dcg = 0.0;
+    m_ideal_dcg.push_back(dcg);
+    for (std::size_t rank = 0; rank < std::min(depth, candidates.size()); ++rank) {
+        // The first remaining document of highest gain; taken documents have gain -1.
+        auto best = static_cast<std::size_t>(std::max_element(gains.begin(), gains.end()) - gains.begin());
+        auto picked = candidates[best];
+        dcg += novel_gain(picked, scratch.covered) / m_discounts.log2_rank(rank);
+        m_ideal_dcg.push_back(dcg);
+        gains[best] = -1.0;
+        for (std::size_t doc = 0; doc < candidates.size(); ++doc) {
+            if (gains[doc] >= 0.0 && (candidates[doc] & picked) != 0) {
+                probe = scratch.covered;
+                gains[doc] = novel_gain(candidates[doc], probe);
+            }
+        }
+    }
+}
+
+void DiversityEvaluator::mask_column(std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch) const
+{
+    auto judged = m_qrels->documents().judgments(query);
+    auto const& dictionary = *m_qrels->dictionary();
+    scratch.masks.resize(ranking.size());
+    for (std::size_t pos = 0; pos < ranking.size(); ++pos) {
+        auto id = ranking.ids[pos];
+        if (!trust_ids || id == unresolved_doc) {
+            id = dictionary.lookup(ranking.docs[pos]);
+        }
+        auto doc = std::lower_bound(judged.begin(), judged.end(), id, [](Judgment const& judgment, std::uint32_t id) {
+            return judgment.id < id;
+        });
+        scratch.masks[pos] = doc != judged.end() && doc->id == id
+            ? m_masks[m_doc_offsets[query] + static_cast<std::size_t>(doc - judged.begin())]
+            : IntentMask{0};
+    }
+}
+
+void DiversityEvaluator::evaluate_ranking(
+    std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch, std::span<double> values) const
+{
+    mask_column(query, ranking, trust_ids, scratch);
+    auto const& cutoffs = m_options.cutoffs;
+    scratch.alpha_dcg_at.resize(cutoffs.size());
+    scratch.err_at.resize(cutoffs.size());
+    scratch.coverage_at.resize(cutoffs.size());
+    scratch.covered.fill(0);
+    std::size_t cutoff = 0;
+    double alpha_dcg = 0.0;
+    double err = 0.0;
+    double nrbp = 0.0;
+    double weight = 1.0;
+    IntentMask coverage = 0;
+    auto record = [&] {
+        scratch.alpha_dcg_at[cutoff] = alpha_dcg;
+        scratch.err_at[cutoff] = err;
+        scratch.coverage_at[cutoff] = coverage;
+    };
+    for (std::size_t rank = 0; rank < scratch.masks.size(); ++rank) {
+        for (; cutoff < cutoffs.size() && cutoffs[cutoff] == rank; ++cutoff) {
+            record();
+        }
+        if (auto mask = scratch.masks[rank]; mask != 0) {
+            auto gain = novel_gain(mask, scratch.covered);
+            alpha_dcg += gain / m_discounts.log2_rank(rank);
+            err += m_options.alpha * gain / static_cast<double>(rank + 1);
+            nrbp += weight * gain;
+            coverage |= mask;
+        }
+        weight *= m_options.beta;
+    }
+    for (; cutoff < cutoffs.size(); ++cutoff) {
+        record();
+    }
+
+    auto num_intents = static_cast<double>(m_num_intents[query]);
+    auto ideal = ideal_alpha_dcg(query);
+    auto value = values.begin();
+    for (std::size_t idx = 0; idx < cutoffs.size(); ++idx) {
+        *value++ = num_intents == 0.0 ? 0.0 : scratch.err_at[idx] / num_intents;
+    }
+    for (std::size_t idx = 0; idx < cutoffs.size(); ++idx) {
+        auto ideal_dcg = ideal[std::min(cutoffs[idx], ideal.size() - 1)];
+        *value++ = ideal_dcg == 0.0 ? 0.0 : scratch.alpha_dcg_at[idx] / ideal_dcg;
+    }
+    *value++ = num_intents == 0.0 ? 0.0 : (1.0 - (1.0 - m_options.alpha) * m_options.beta) / num_intents * nrbp;
+    for (std::size_t idx = 0; idx < cutoffs.size(); ++idx) {
+        *value++ = num_intents == 0.0 ? 0.0 : std::popcount(scratch.coverage_at[idx]) / num_intents;
+    }
+}
+
+auto DiversityEvaluator::evaluate_query(std::string_view query_id, RankingView ranking, std::span<double> values) const
+    -> bool
+{
+    auto query = m_qrels->find_query(query_id);
+    if (!query) {
+        return false;
+    }
+    Scratch scratch;
+    evaluate_ranking(*query, ranking, true, scratch, values);
+    return true;
+}
+
+auto DiversityEvaluator::evaluate(Run const& run) const -> Results
+{
+    Results results(m_metrics);
+    std::vector<double> values(m_metrics.size());
+    Scratch scratch;
+    auto trust_ids = run.dictionary() == nullptr || run.dictionary() == m_qrels->dictionary();
+    std::size_t run_query = 0;
+    for (std::size_t query = 0; query < m_qrels->num_queries(); ++query) {
+        auto query_id = m_qrels->query_id(query);
+        while (run_query < run.num_queries() && run.query_id(run_query) < query_id) {
+            ++run_query;
+        }
+        if (run_query < run.num_queries() && run.query_id(run_query) == query_id) {
+            evaluate_ranking(query, run.ranking(run_query), trust_ids, scratch, values);
+        } else if (m_options.complete) {
+            evaluate_ranking(query, {}, trust_ids, scratch, values);
+        } else {
+            continue;
+        }
+        results.add(std::string(query_id), values);
+    }
+    return results;
+}
+
+}  // namespace eval_metrics
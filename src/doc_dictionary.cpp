@@ -0,0 +1,57 @@
+#include "eval_metrics/doc_dictionary.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "eval_metrics/detail/hash.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+constexpr std::uint64_t empty_slot = std::numeric_limits<std::uint64_t>::max();
+
+[[nodiscard]] constexpr auto slot_tag(std::uint64_t hash) noexcept -> std::uint64_t
+{
+    return hash & ~std::uint64_t{0xFFFF'FFFF};
+}
+
+}  // namespace
+
+DocDictionary::DocDictionary(std::vector<std::string_view> sorted_docs)
+    : m_docs(std::move(sorted_docs)),
+      m_slots(std::bit_ceil(std::max<std::size_t>(2 * m_docs.size(), 16)), empty_slot),
+      m_mask(m_slots.size() - 1)
+{
+    for (std::uint32_t id = 0; id < m_docs.size(); ++id) {
+        auto hash = detail::hash_string(m_docs[id]);
+        auto pos = hash & m_mask;
+        while (m_slots[pos] != empty_slot) {
+            pos = (pos + 1) & m_mask;
+        }
+        m_slots[pos] = slot_tag(hash) | id;
+    }
+}
+
+auto DocDictionary::from_docs(std::vector<std::string_view> docs) -> DocDictionary
+{
+    std::sort(docs.begin(), docs.end());
+    docs.erase(std::unique(docs.begin(), docs.end()), docs.end());
+    return DocDictionary(std::move(docs));
+}
+
+auto DocDictionary::lookup(std::string_view doc) const noexcept -> std::uint32_t
+{
+    auto hash = detail::hash_string(doc);
+    auto tag = slot_tag(hash);
+    for (auto pos = hash & m_mask; m_slots[pos] != empty_slot; pos = (pos + 1) & m_mask) {
+        auto slot = m_slots[pos];
+        auto id = static_cast<std::uint32_t>(slot);
+        if (slot_tag(slot) == tag && m_docs[id] == doc) {
+            return id;
+        }
+    }
+    return unjudged_doc;
+}
+
+}  // namespace eval_metrics
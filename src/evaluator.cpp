@@ -0,0 +1,240 @@
+#include "eval_metrics/evaluator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/metrics.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+void write_row(std::ostream& os, std::string_view name, std::string_view query, double value, bool integral)
+{
+    os << std::left << std::setw(22) << name << '\t' << query << '\t';
+    if (integral) {
+        os << static_cast<long long>(value);
+    } else {
+        os << std::fixed << std::setprecision(4) << value;
+    }
+    os << '\n';
+}
+
+/// Compiles the measures of `options`, with the highest grade of `qrels` as the
+/// highest grade of ERR unless set.
+[[nodiscard]] auto compile_plan(Qrels const& qrels, EvaluationOptions const& options) -> EvaluationPlan
+{
+    if (options.measures.empty()) {
+        return EvaluationPlan::standard();
+    }
+    auto cascade = options.cascade;
+    if (cascade.max_grade == 0) {
+        cascade.max_grade = qrels.statistics().max_grade();
+    }
+    return EvaluationPlan::compile(options.measures, cascade);
+}
+
+}  // namespace
+
+Results::Results(std::vector<MetricInfo> metrics) : m_metrics(std::move(metrics)) {}
+
+void Results::add(std::string query_id, std::span<double const> values)
+{
+    m_query_ids.push_back(std::move(query_id));
+    m_values.insert(m_values.end(), values.begin(), values.end());
+}
+
+void Results::sort_by_query()
+{
+    std::vector<std::size_t> order(num_queries());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+        return m_query_ids[lhs] < m_query_ids[rhs];
+    });
+    std::vector<std::string> query_ids;
+    std::vector<double> values;
+    query_ids.reserve(m_query_ids.size());
+    values.reserve(m_values.size());
+    for (auto query : order) {
+        query_ids.push_back(std::move(m_query_ids[query]));
+        auto row = this->values(query);
+        values.insert(values.end(), row.begin(), row.end());
+    }
+    m_query_ids = std::move(query_ids);
+    m_values = std::move(values);
+}
+
+auto Results::aggregate() const -> std::vector<double>
+{
+    std::vector<double> summary(m_metrics.size(), 0.0);
+    for (std::size_t query = 0; query < num_queries(); ++query) {
+        auto row = values(query);
+        for (std::size_t metric = 0; metric < summary.size(); ++metric) {
+            summary[metric] += row[metric];
+        }
+    }
+    if (num_queries() > 0) {
+        for (std::size_t metric = 0; metric < summary.size(); ++metric) {
+            if (m_metrics[metric].aggregation == Aggregation::mean) {
+                summary[metric] /= static_cast<double>(num_queries());
+            }
+        }
+    }
+    return summary;
+}
+
+Evaluator::Evaluator(Qrels const& qrels, EvaluationOptions options)
+    : m_qrels(&qrels),
+      m_options(std::move(options)),
+      m_grades(qrels, m_options.lookup),
+      m_plan(compile_plan(qrels, m_options)),
+      m_depth(m_plan.depth())
+{
+    if (m_plan.depends_on_num_rel()) {
+        for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+            m_depth = std::max(m_depth, qrels.statistics().num_relevant(query, m_options.relevance_level));
+        }
+    }
+    // Which documents of the ranking make it into the condensed list is only known
+    // once it is sorted.
+    if (m_options.condensed && m_depth > 0) {
+        m_depth = no_cutoff;
+    }
+}
+
+auto Evaluator::is_own(std::shared_ptr<DocDictionary const> const& dictionary) const noexcept -> bool
+{
+    return dictionary == nullptr || dictionary == m_qrels->dictionary();
+}
+
+auto Evaluator::evaluate_query(std::string_view query_id, RankingView ranking, std::span<double> values) const
+    -> bool
+{
+    auto query = m_qrels->find_query(query_id);
+    if (!query) {
+        return false;
+    }
+    Scratch scratch(m_plan);
+    evaluate_ranking(*query, ranking, true, scratch, values);
+    return true;
+}
+
+auto Evaluator::prefix_sums(std::string_view query_id, RankingView ranking, PrefixSums& sums) const -> bool
+{
+    auto query = m_qrels->find_query(query_id);
+    if (!query) {
+        return false;
+    }
+    Scratch scratch(m_plan);
+    gain_column(*query, ranking, true, scratch);
+    auto const& statistics = m_qrels->statistics();
+    sums.assign(
+        scratch.grades,
+        m_options.relevance_level,
+        statistics.num_relevant(*query, m_options.relevance_level),
+        statistics.ideal_dcg_prefix(*query));
+    return true;
+}
+
+void Evaluator::gain_column(std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch) const
+{
+    // Resolved IDs are looked up straight from the ranking's ID column.
+    std::span<std::uint32_t const> ids = ranking.ids;
+    if (!trust_ids || std::find(ids.begin(), ids.end(), unresolved_doc) != ids.end()) {
+        auto const& dictionary = *m_qrels->dictionary();
+        scratch.ids.resize(ranking.size());
+        for (std::size_t pos = 0; pos < ranking.size(); ++pos) {
+            auto id = ranking.ids[pos];
+            scratch.ids[pos] = trust_ids && id != unresolved_doc ? id : dictionary.lookup(ranking.docs[pos]);
+        }
+        ids = scratch.ids;
+    }
+    scratch.grades.resize(ranking.size());
+    m_grades.query(query).grades(ids, scratch.grades);
+    if (m_options.condensed) {
+        scratch.grades.resize(condense(scratch.grades).size());
+    }
+}
+
+void Evaluator::evaluate_ranking(
+    std::size_t query, RankingView ranking, bool trust_ids, Scratch& scratch, std::span<double> values) const
+{
+    gain_column(query, ranking, trust_ids, scratch);
+    m_plan.evaluate(scratch.grades, m_qrels->statistics(), query, m_options.relevance_level, scratch.workspace, values);
+}
+
+auto Evaluator::evaluate(Run const& run) const -> Results
+{
+    Results results({metrics().begin(), metrics().end()});
+    std::vector<double> values(metrics().size());
+    Scratch scratch(m_plan);
+    auto trust_ids = is_own(run.dictionary());
+    // Merge the ID-ordered query lists of the qrels and the run.
+    std::size_t run_query = 0;
+    for (std::size_t query = 0; query < m_qrels->num_queries(); ++query) {
+        auto query_id = m_qrels->query_id(query);
+        while (run_query < run.num_queries() && run.query_id(run_query) < query_id) {
+            ++run_query;
+        }
+        if (run_query < run.num_queries() && run.query_id(run_query) == query_id) {
+            evaluate_ranking(query, run.ranking(run_query), trust_ids, scratch, values);
+        } else if (m_options.complete) {
+            evaluate_ranking(query, {}, trust_ids, scratch, values);
+        } else {
+            continue;
+        }
+        results.add(std::string(query_id), values);
+    }
+    return results;
+}
+
+auto Evaluator::evaluate(RunStream& stream) const -> Results
+{
+    Results results({metrics().begin(), metrics().end()});
+    std::vector<double> values(metrics().size());
+    std::vector<bool> evaluated(m_qrels->num_queries(), false);
+    Scratch scratch(m_plan);
+    auto trust_ids = is_own(stream.dictionary());
+    while (stream.next()) {
+        if (auto query = m_qrels->find_query(stream.query_id())) {
+            evaluate_ranking(*query, stream.ranking(), trust_ids, scratch, values);
+            results.add(std::string(stream.query_id()), values);
+            evaluated[*query] = true;
+        }
+    }
+    if (m_options.complete) {
+        for (std::size_t query = 0; query < m_qrels->num_queries(); ++query) {
+            if (!evaluated[query]) {
+                evaluate_ranking(query, {}, trust_ids, scratch, values);
+                results.add(std::string(m_qrels->query_id(query)), values);
+            }
+        }
+    }
+    results.sort_by_query();
+    return results;
+}
+
+void write_trec(std::ostream& os, Results const& results, std::string_view run_tag, bool per_query)
+{
+    auto metrics = results.metrics();
+    if (per_query) {
+        for (std::size_t query = 0; query < results.num_queries(); ++query) {
+            auto values = results.values(query);
+            for (std::size_t metric = 0; metric < metrics.size(); ++metric) {
+                write_row(os, metrics[metric].name, results.query_id(query), values[metric], metrics[metric].integral);
+            }
+        }
+    }
+    os << std::left << std::setw(22) << "runid" << "\tall\t" << run_tag << '\n';
+    write_row(os, "num_q", "all", static_cast<double>(results.num_queries()), true);
+    auto summary = results.aggregate();
+    for (std::size_t metric = 0; metric < metrics.size(); ++metric) {
+        write_row(os, metrics[metric].name, "all", summary[metric], metrics[metric].integral);
+    }
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,345 @@
+#include "eval_metrics/exposure.hpp"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <unordered_map>
+
+#include "eval_metrics/detail/numeric.hpp"
+#include "eval_metrics/detail/text.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/input_stream.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+/// Removes and returns the first blank-separated field of `rest`; empty at its end.
+[[nodiscard]] auto next_field(std::string_view& rest) noexcept -> std::string_view
+{
+    std::size_t begin = 0;
+    while (begin < rest.size() && detail::is_blank(rest[begin])) {
+        ++begin;
+    }
+    auto end = begin;
+    while (end < rest.size() && !detail::is_blank(rest[end])) {
+        ++end;
+    }
+    auto field = rest.substr(begin, end - begin);
+    rest.remove_prefix(end);
+    return field;
+}
+
+[[nodiscard]] auto map_input(std::filesystem::path const& path) -> std::shared_ptr<Buffer const>
+{
+    auto buffer = Buffer::map_file(path);
+    if (detect_compression(buffer->view().substr(0, 4)) != Compression::none) {
+        buffer = Buffer::from_string(InputStream(path).read_all());
+    }
+    return buffer;
+}
+
+/// The candidates and samples of one query while parsing.
+struct QuerySamples {
+    std::vector<std::string_view> candidates;
+    std::vector<std::size_t> starts;
+    std::vector<std::uint32_t> positions;
+};
+
+}  // namespace
+
+auto SampledRuns::from_file(std::filesystem::path const& path, std::shared_ptr<DocDictionary const> dictionary)
+    -> SampledRuns
+{
+    return parse(map_input(path), std::move(dictionary));
+}
+
+auto SampledRuns::parse(std::shared_ptr<Buffer const> buffer, std::shared_ptr<DocDictionary const> dictionary)
+    -> SampledRuns
+{
+    std::unordered_map<std::string_view, QuerySamples> queries;
+    // Candidates already placed in the current sample; cleared after each sample.
+    std::vector<bool> seen;
+    detail::LineReader lines(buffer->view());
+    for (std::string_view line; lines.next(line);) {
+        auto query_id = next_field(line);
+        if (query_id.empty()) {
+            continue;
+        }
+        auto kind = next_field(line);
+        auto& query = queries[query_id];
+        if (kind == "D") {
+            auto doc = next_field(line);
+            if (doc.empty() || !next_field(line).empty()) {
+                throw ParseError("expected 3 fields: qid D docno", lines.line_number());
+            }
+            query.candidates.push_back(doc);
+        } else if (kind == "S") {
+            auto start = query.positions.size();
+            query.starts.push_back(start);
+            seen.resize(std::max(seen.size(), query.candidates.size()));
+            for (auto field = next_field(line); !field.empty(); field = next_field(line)) {
+                std::uint32_t position = 0;
+                if (!detail::parse_integer(field, position) || position >= query.candidates.size()) {
+                    throw ParseError("invalid candidate position: " + std::string(field), lines.line_number());
+                }
+                if (seen[position]) {
+                    throw ParseError("candidate position repeated in sample", lines.line_number());
+                }
+                seen[position] = true;
+                query.positions.push_back(position);
+            }
+            for (auto idx = start; idx < query.positions.size(); ++idx) {
+                seen[query.positions[idx]] = false;
+            }
+        } else {
+            throw ParseError("expected D or S in the second field", lines.line_number());
+        }
+    }
+
+    SampledRuns runs;
+    runs.m_buffer = std::move(buffer);
+    runs.m_dictionary = std::move(dictionary);
+    for (auto const& [query_id, query] : queries) {
+        runs.m_query_ids.push_back(query_id);
+    }
+    std::sort(runs.m_query_ids.begin(), runs.m_query_ids.end());
+    runs.m_candidate_offsets.push_back(0);
+    runs.m_sample_offsets.push_back(0);
+    std::vector<std::string_view> sorted;
+    for (auto query_id : runs.m_query_ids) {
+        auto const& query = queries[query_id];
+        sorted.assign(query.candidates.begin(), query.candidates.end());
+        std::sort(sorted.begin(), sorted.end());
+        if (auto duplicate = std::adjacent_find(sorted.begin(), sorted.end()); duplicate != sorted.end()) {
+            throw ParseError(
+                "duplicate candidate " + std::string(*duplicate) + " in query " + std::string(query_id));
+        }
+        runs.m_candidates.insert(runs.m_candidates.end(), query.candidates.begin(), query.candidates.end());
+        runs.m_candidate_offsets.push_back(runs.m_candidates.size());
+        for (auto start : query.starts) {
+            runs.m_sample_starts.push_back(runs.m_positions.size() + start);
+        }
+        runs.m_positions.insert(runs.m_positions.end(), query.positions.begin(), query.positions.end());
+        runs.m_sample_offsets.push_back(runs.m_sample_starts.size());
+    }
+    runs.m_sample_starts.push_back(runs.m_positions.size());
+    runs.m_candidate_ids.reserve(runs.m_candidates.size());
+    for (auto doc : runs.m_candidates) {
+        runs.m_candidate_ids.push_back(runs.m_dictionary ? runs.m_dictionary->lookup(doc) : unresolved_doc);
+    }
+    return runs;
+}
+
+auto DocumentGroups::from_file(std::filesystem::path const& path) -> DocumentGroups
+{
+    return parse(map_input(path));
+}
+
+auto DocumentGroups::parse(std::shared_ptr<Buffer const> buffer) -> DocumentGroups
+{
+    std::vector<std::array<std::string_view, 2>> pairs;
+    detail::LineReader lines(buffer->view());
+    std::array<std::string_view, 2> fields;
+    for (std::string_view line; lines.next(line);) {
+        auto count = detail::split_fields(line, fields);
+        if (count == 0) {
+            continue;
+        }
+        if (count != fields.size()) {
+            throw ParseError("expected 2 fields: docno group", lines.line_number());
+        }
+        pairs.push_back(fields);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    DocumentGroups groups;
+    groups.m_buffer = std::move(buffer);
+    for (auto const& [doc, group] : pairs) {
+        groups.m_names.push_back(group);
+    }
+    std::sort(groups.m_names.begin(), groups.m_names.end());
+    groups.m_names.erase(std::unique(groups.m_names.begin(), groups.m_names.end()), groups.m_names.end());
+    for (std::size_t idx = 0; idx < pairs.size(); ++idx) {
+        auto const& [doc, group] = pairs[idx];
+        if (idx == 0 || doc != pairs[idx - 1][0]) {
+            groups.m_docs.push_back(doc);
+            groups.m_offsets.push_back(groups.m_groups.size());
+        }
+        auto name = std::lower_bound(groups.m_names.begin(), groups.m_names.end(), group);
+        groups.m_groups.push_back(static_cast<std::uint32_t>(name - groups.m_names.begin()));
+    }
+    groups.m_offsets.push_back(groups.m_groups.size());
+    return groups;
+}
+
+auto DocumentGroups::groups(std::string_view doc) const noexcept -> std::span<std::uint32_t const>
+{
+    auto pos = std::lower_bound(m_docs.begin(), m_docs.end(), doc);
+    if (pos == m_docs.end() || *pos != doc) {
+        return {};
+    }
+    auto idx = static_cast<std::size_t>(pos - m_docs.begin());
+    return std::span<std::uint32_t const>(m_groups).subspan(m_offsets[idx], m_offsets[idx + 1] - m_offsets[idx]);
+}
+
+ExposureEvaluator::ExposureEvaluator(Qrels const& qrels, ExposureOptions options, DocumentGroups const* groups)
+    : m_qrels(&qrels), m_options(options), m_groups(groups)
+{
+    for (auto const* name : {"EE-L", "EE-D", "EE-R"}) {
+        m_metrics.push_back({name});
+    }
+    if (m_groups != nullptr) {
+        for (auto const* name : {"EE-L_group", "EE-D_group", "EE-R_group"}) {
+            m_metrics.push_back({name});
+        }
+    }
+
+    // Relevant documents take the ranks of an ideal ranking, by decreasing grade; those
+    // of a grade share the average exposure of its ranks.
+    std::vector<std::pair<std::int32_t, std::size_t>> relevant;
+    m_qrels_offsets.push_back(0);
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        auto judged = qrels.judgments(query);
+        auto first = m_targets.size();
+        m_targets.resize(first + judged.size(), 0.0);
+        relevant.clear();
+        for (std::size_t doc = 0; doc < judged.size(); ++doc) {
+            if (is_relevant(judged[doc].grade, m_options.relevance_level)) {
+                relevant.emplace_back(judged[doc].grade, doc);
+            }
+        }
+        std::sort(relevant.begin(), relevant.end(), [](auto const& lhs, auto const& rhs) {
+            return lhs.first > rhs.first;
+        });
+        double exposure = 1.0;
+        for (std::size_t begin = 0; begin < relevant.size();) {
+            auto end = begin;
+            double sum = 0.0;
+            for (; end < relevant.size() && relevant[end].first == relevant[begin].first; ++end) {
+                sum += exposure;
+                exposure *= m_options.patience;
+            }
+            auto share = sum / static_cast<double>(end - begin);
+            for (; begin < end; ++begin) {
+                m_targets[first + relevant[begin].second] = share;
+            }
+        }
+        m_qrels_offsets.push_back(m_targets.size());
+    }
+}
+
+void ExposureEvaluator::evaluate_query(
+    std::size_t query, SampledRuns const& runs, std::size_t run_query, Scratch& scratch,
+    std::span<double> values) const
+{
+    auto candidates = runs.candidates(run_query);
+    auto ids = runs.candidate_ids(run_query);
+    auto judged = m_qrels->judgments(query);
+    auto trust_ids = runs.dictionary() == m_qrels->dictionary();
+
+    // The candidates' judgments, looked up once for all the samples.
+    scratch.judgment.assign(candidates.size(), no_judgment);
+    for (std::size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+        auto id = trust_ids && ids[candidate] != unresolved_doc ? ids[candidate]
+                                                                : m_qrels->dictionary()->lookup(candidates[candidate]);
+        auto pos = std::lower_bound(judged.begin(), judged.end(), id, [](Judgment const& judgment, std::uint32_t id) {
+            return judgment.id < id;
+        });
+        if (pos != judged.end() && pos->id == id) {
+            scratch.judgment[candidate] = static_cast<std::size_t>(pos - judged.begin());
+        }
+    }
+
+    // The exposure of each candidate, summed over the samples.
+    auto& exposure = scratch.exposure;
+    auto& weights = scratch.weights;
+    exposure.assign(candidates.size(), 0.0);
+    auto num_samples = runs.num_samples(run_query);
+    for (std::size_t sample = 0; sample < num_samples; ++sample) {
+        auto positions = runs.sample(run_query, sample);
+        while (weights.size() < positions.size()) {
+            weights.push_back(weights.empty() ? 1.0 : weights.back() * m_options.patience);
+        }
+        for (std::size_t rank = 0; rank < positions.size(); ++rank) {
+            exposure[positions[rank]] += weights[rank];
+        }
+    }
+
+    double loss = 0.0;
+    double disparity = 0.0;
+    double relevance = 0.0;
+    scratch.seen.assign(judged.size(), false);
+    for (std::size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+        auto expected = num_samples == 0 ? 0.0 : exposure[candidate] / static_cast<double>(num_samples);
+        exposure[candidate] = expected;
+        double target = 0.0;
+        if (auto doc = scratch.judgment[candidate]; doc != no_judgment) {
+            target = this->target(query, doc);
+            scratch.seen[doc] = true;
+        }
+        loss += (expected - target) * (expected - target);
+        disparity += expected * expected;
+        relevance += expected * target;
+    }
+    // Relevant documents never sampled miss all of their target exposure.
+    for (std::size_t doc = 0; doc < judged.size(); ++doc) {
+        if (!scratch.seen[doc]) {
+            loss += target(query, doc) * target(query, doc);
+        }
+    }
+    values[0] = loss;
+    values[1] = disparity;
+    values[2] = relevance;
+    if (m_groups == nullptr) {
+        return;
+    }
+
+    scratch.group_exposure.assign(m_groups->num_groups(), 0.0);
+    scratch.group_target.assign(m_groups->num_groups(), 0.0);
+    for (std::size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+        for (auto group : m_groups->groups(candidates[candidate])) {
+            scratch.group_exposure[group] += exposure[candidate];
+        }
+    }
+    for (std::size_t doc = 0; doc < judged.size(); ++doc) {
+        for (auto group : m_groups->groups(judged[doc].doc)) {
+            scratch.group_target[group] += target(query, doc);
+        }
+    }
+    double group_loss = 0.0;
+    double group_disparity = 0.0;
+    double group_relevance = 0.0;
+    for (std::size_t group = 0; group < m_groups->num_groups(); ++group) {
+        auto expected = scratch.group_exposure[group];
+        auto target = scratch.group_target[group];
+        group_loss += (expected - target) * (expected - target);
+        group_disparity += expected * expected;
+        group_relevance += expected * target;
+    }
+    values[3] = group_loss;
+    values[4] = group_disparity;
+    values[5] = group_relevance;
+}
+
+auto ExposureEvaluator::evaluate(SampledRuns const& runs) const -> Results
+{
+    Results results(m_metrics);
+    std::vector<double> values(m_metrics.size());
+    Scratch scratch;
+    std::size_t run_query = 0;
+    for (std::size_t query = 0; query < m_qrels->num_queries(); ++query) {
+        auto query_id = m_qrels->query_id(query);
+        while (run_query < runs.num_queries() && runs.query_id(run_query) < query_id) {
+            ++run_query;
+        }
+        if (run_query < runs.num_queries() && runs.query_id(run_query) == query_id) {
+            evaluate_query(query, runs, run_query, scratch, values);
+            results.add(std::string(query_id), values);
+        }
+    }
+    return results;
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,89 @@
+#include "eval_metrics/grade_index.hpp"
+
+#include <bit>
+
+namespace eval_metrics {
+
+auto grade_layout_name(GradeLayout layout) noexcept -> char const*
+{
+    switch (layout) {
+    case GradeLayout::sorted: return "sorted";
+    case GradeLayout::hash: return "hash";
+    case GradeLayout::dense: return "dense";
+    }
+    return "unknown";
+}
+
+void QueryGrades::grades(std::span<std::uint32_t const> ids, std::span<std::int32_t> grades) const noexcept
+{
+    auto lookup = [&](auto&& grade) {
+        for (std::size_t idx = 0; idx < ids.size(); ++idx) {
+            grades[idx] = grade(ids[idx]);
+        }
+    };
+    switch (m_layout) {
+    case GradeLayout::sorted: lookup([this](std::uint32_t id) { return sorted_grade(id); }); break;
+    case GradeLayout::hash: lookup([this](std::uint32_t id) { return hashed_grade(id); }); break;
+    case GradeLayout::dense: lookup([this](std::uint32_t id) { return dense_grade(id); }); break;
+    }
+}
+
+GradeIndex::GradeIndex(Qrels const& qrels, GradeIndexOptions const& options)
+    : m_queries(qrels.num_queries())
+{
+    // Offsets of the queries' tables, turned into pointers once the arrays are complete.
+    std::vector<std::size_t> key_offsets(qrels.num_queries());
+    std::vector<std::size_t> offsets(qrels.num_queries());
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        auto judgments = qrels.judgments(query);
+        auto& table = m_queries[query];
+        table.m_size = judgments.size();
+        key_offsets[query] = m_keys.size();
+        offsets[query] = m_grades.size();
+        if (judgments.empty()) {
+            continue;
+        }
+        // Judgments are sorted by document, and so by ID.
+        auto first = judgments.front().id;
+        auto span = std::size_t{judgments.back().id - first} + 1;
+        if (static_cast<double>(span) <= options.max_dense_span_ratio * static_cast<double>(judgments.size())) {
+            table.m_layout = GradeLayout::dense;
+            table.m_base = first;
+            table.m_size = span;
+            m_grades.resize(m_grades.size() + span, unjudged);
+            for (auto const& judgment : judgments) {
+                m_grades[offsets[query] + (judgment.id - first)] = judgment.grade;
+            }
+        } else if (judgments.size() <= options.max_sorted_size) {
+            table.m_layout = GradeLayout::sorted;
+            for (auto const& judgment : judgments) {
+                m_keys.push_back(judgment.id);
+                m_grades.push_back(judgment.grade);
+            }
+        } else {
+            table.m_layout = GradeLayout::hash;
+            auto load = options.max_load_factor > 0.0 && options.max_load_factor < 1.0 ? options.max_load_factor : 0.5;
+            auto slots = std::bit_ceil(static_cast<std::size_t>(static_cast<double>(judgments.size()) / load) + 1);
+            table.m_size = slots;
+            table.m_mask = slots - 1;
+            m_keys.resize(m_keys.size() + slots, unjudged_doc);
+            m_grades.resize(m_grades.size() + slots, unjudged);
+            auto* keys = m_keys.data() + key_offsets[query];
+            auto* grades = m_grades.data() + offsets[query];
+            for (auto const& judgment : judgments) {
+                auto slot = table.hash_slot(judgment.id);
+                while (keys[slot] != unjudged_doc) {
+                    slot = (slot + 1) & table.m_mask;
+                }
+                keys[slot] = judgment.id;
+                grades[slot] = judgment.grade;
+            }
+        }
+    }
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        m_queries[query].m_keys = m_keys.data() + key_offsets[query];
+        m_queries[query].m_grades = m_grades.data() + offsets[query];
+    }
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,387 @@
+#include "eval_metrics/input_stream.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef EVAL_METRICS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef EVAL_METRICS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/error.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+/// Produces the bytes of a file, decompressed if needed.
+class Source {
+  public:
+    Source() = default;
+    Source(Source const&) = delete;
+    Source(Source&&) = delete;
+    auto operator=(Source const&) -> Source& = delete;
+    auto operator=(Source&&) -> Source& = delete;
+    virtual ~Source() = default;
+
+    /// Fills as much of `out` as possible; returns less than `size` only at the end.
+    [[nodiscard]] virtual auto read(char* out, std::size_t size) -> std::size_t = 0;
+};
+
+class FileSource : public Source {
+  public:
+    FileSource(int fd, std::filesystem::path path) : m_fd(fd), m_path(std::move(path))
+    {
+        ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    FileSource(FileSource const&) = delete;
+    FileSource(FileSource&&) = delete;
+    auto operator=(FileSource const&) -> FileSource& = delete;
+    auto operator=(FileSource&&) -> FileSource& = delete;
+    ~FileSource() override { ::close(m_fd); }
+
+    [[nodiscard]] auto read(char* out, std::size_t size) -> std::size_t override
+    {
+        std::size_t filled = 0;
+        while (filled < size) {
+            auto bytes = ::read(m_fd, out + filled, size - filled);
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes < 0) {
+                throw IoError("cannot read " + m_path.string() + ": " + std::strerror(errno));
+            }
+            if (bytes == 0) {
+                break;
+            }
+            filled += static_cast<std::size_t>(bytes);
+        }
+        return filled;
+    }
+
+  private:
+    int m_fd;
+    std::filesystem::path m_path;
+};
+
+#ifdef EVAL_METRICS_HAVE_ZLIB
+
+/// Inflates a mapped gzip file, including files of several concatenated members.
+class GzipSource : public Source {
+  public:
+    GzipSource(std::shared_ptr<Buffer const> input, std::filesystem::path path)
+        : m_input(std::move(input)), m_path(std::move(path))
+    {
+        // 15 window bits, +16 to expect a gzip header.
+        if (inflateInit2(&m_stream, 15 + 16) != Z_OK) {
+            throw IoError("cannot initialize gzip decompression of " + m_path.string());
+        }
+    }
+    GzipSource(GzipSource const&) = delete;
+    GzipSource(GzipSource&&) = delete;
+    auto operator=(GzipSource const&) -> GzipSource& = delete;
+    auto operator=(GzipSource&&) -> GzipSource& = delete;
+    ~GzipSource() override { inflateEnd(&m_stream); }
+
+    [[nodiscard]] auto read(char* out, std::size_t size) -> std::size_t override
+    {
+        constexpr std::size_t max_chunk = std::numeric_limits<uInt>::max();
+        auto input = m_input->view();
+        std::size_t filled = 0;
+        while (filled < size && !m_finished) {
+            if (m_stream.avail_in == 0) {
+                auto chunk = std::min(max_chunk, input.size() - m_consumed);
+                m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data() + m_consumed));
+                m_stream.avail_in = static_cast<uInt>(chunk);
+                m_consumed += chunk;
+            }
+            auto want = std::min(max_chunk, size - filled);
+            m_stream.next_out = reinterpret_cast<Bytef*>(out + filled);
+            m_stream.avail_out = static_cast<uInt>(want);
+            auto status = inflate(&m_stream, Z_NO_FLUSH);
+            filled += want - m_stream.avail_out;
+            if (status == Z_STREAM_END) {
+                if (m_stream.avail_in == 0 && m_consumed == input.size()) {
+                    m_finished = true;
+                } else {
+                    inflateReset(&m_stream);
+                }
+            } else if (status == Z_BUF_ERROR && m_stream.avail_in == 0 && m_consumed == input.size()) {
+                throw IoError("truncated gzip file " + m_path.string());
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                throw IoError("corrupt gzip file " + m_path.string() + ": "
+                              + (m_stream.msg != nullptr ? m_stream.msg : "inflate failed"));
+            }
+        }
+        return filled;
+    }
+
+  private:
+    std::shared_ptr<Buffer const> m_input;
+    std::filesystem::path m_path;
+    z_stream m_stream{};
+    std::size_t m_consumed = 0;
+    bool m_finished = false;
+};
+
+#endif
+
+#ifdef EVAL_METRICS_HAVE_ZSTD
+
+/// Decompresses a mapped zstd file, including files of several frames.
+class ZstdSource : public Source {
+  public:
+    ZstdSource(std::shared_ptr<Buffer const> input, std::filesystem::path path)
+        : m_input(std::move(input)), m_path(std::move(path)), m_context(ZSTD_createDCtx())
+    {
+        if (m_context == nullptr) {
+            throw IoError("cannot initialize zstd decompression of " + m_path.string());
+        }
+        m_in = {m_input->view().data(), m_input->size(), 0};
+    }
+    ZstdSource(ZstdSource const&) = delete;
+    ZstdSource(ZstdSource&&) = delete;
+    auto operator=(ZstdSource const&) -> ZstdSource& = delete;
+    auto operator=(ZstdSource&&) -> ZstdSource& = delete;
+    ~ZstdSource() override { ZSTD_freeDCtx(m_context); }
+
+    [[nodiscard]] auto read(char* out, std::size_t size) -> std::size_t override
+    {
+        ZSTD_outBuffer output{out, size, 0};
+        while (output.pos < output.size) {
+            if (m_in.pos == m_in.size) {
+                if (m_pending != 0) {
+                    throw IoError("truncated zstd file " + m_path.string());
+                }
+                break;
+            }
+            m_pending = ZSTD_decompressStream(m_context, &output, &m_in);
+            if (ZSTD_isError(m_pending) != 0U) {
+                throw IoError("corrupt zstd file " + m_path.string() + ": " + ZSTD_getErrorName(m_pending));
+            }
+        }
+        return output.pos;
+    }
+
+  private:
+    std::shared_ptr<Buffer const> m_input;
+    std::filesystem::path m_path;
+    ZSTD_DCtx* m_context;
+    ZSTD_inBuffer m_in{};
+    std::size_t m_pending = 0;
+};
+
+#endif
+
+[[nodiscard]] auto open_source(std::filesystem::path const& path, Compression& compression)
+    -> std::unique_ptr<Source>
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw IoError("cannot open " + path.string() + ": " + std::strerror(errno));
+    }
+    std::array<char, 4> head{};
+    auto bytes = ::pread(fd, head.data(), head.size(), 0);
+    compression = detect_compression({head.data(), bytes > 0 ? static_cast<std::size_t>(bytes) : 0});
+    if (compression == Compression::none) {
+        return std::make_unique<FileSource>(fd, path);
+    }
+    ::close(fd);
+    if (!is_supported(compression)) {
+        throw IoError(
+            path.string() + " is " + std::string(compression_name(compression))
+            + "-compressed, but eval_metrics was built without " + std::string(compression_name(compression))
+            + " support");
+    }
+#ifdef EVAL_METRICS_HAVE_ZLIB
+    if (compression == Compression::gzip) {
+        return std::make_unique<GzipSource>(Buffer::map_file(path), path);
+    }
+#endif
+#ifdef EVAL_METRICS_HAVE_ZSTD
+    if (compression == Compression::zstd) {
+        return std::make_unique<ZstdSource>(Buffer::map_file(path), path);
+    }
+#endif
+    throw IoError("unsupported compression of " + path.string());
+}
+
+}  // namespace
+
+/// The reading thread and the bounded queue of filled buffers it shares with the consumer.
+struct InputStream::Pipeline {
+    std::unique_ptr<Source> source;
+    InputStreamOptions options;
+    std::mutex mutex;
+    std::condition_variable filled_cv;
+    std::condition_variable space_cv;
+    std::deque<std::vector<char>> filled;
+    std::vector<std::vector<char>> free;
+    bool finished = false;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::thread thread;
+
+    void run()
+    {
+        try {
+            while (true) {
+                std::vector<char> buffer;
+                {
+                    std::unique_lock lock(mutex);
+                    space_cv.wait(lock, [&] { return stopping || filled.size() < options.queue_depth; });
+                    if (stopping) {
+                        return;
+                    }
+                    if (!free.empty()) {
+                        buffer = std::move(free.back());
+                        free.pop_back();
+                    }
+                }
+                buffer.resize(options.buffer_size);
+                auto size = source->read(buffer.data(), buffer.size());
+                buffer.resize(size);
+                std::lock_guard lock(mutex);
+                if (size == 0) {
+                    finished = true;
+                    filled_cv.notify_one();
+                    return;
+                }
+                filled.push_back(std::move(buffer));
+                filled_cv.notify_one();
+            }
+        } catch (...) {
+            std::lock_guard lock(mutex);
+            error = std::current_exception();
+            finished = true;
+            filled_cv.notify_one();
+        }
+    }
+};
+
+auto detect_compression(std::string_view head) noexcept -> Compression
+{
+    if (head.size() >= 2 && head[0] == '\x1f' && head[1] == '\x8b') {
+        return Compression::gzip;
+    }
+    if (head.size() >= 4 && head.substr(0, 4) == std::string_view("\x28\xb5\x2f\xfd", 4)) {
+        return Compression::zstd;
+    }
+    return Compression::none;
+}
+
+auto compression_name(Compression compression) noexcept -> std::string_view
+{
+    switch (compression) {
+    case Compression::gzip: return "gzip";
+    case Compression::zstd: return "zstd";
+    case Compression::none: break;
+    }
+    return "none";
+}
+
+auto is_supported(Compression compression) noexcept -> bool
+{
+    switch (compression) {
+#ifdef EVAL_METRICS_HAVE_ZLIB
+    case Compression::gzip: return true;
+#endif
+#ifdef EVAL_METRICS_HAVE_ZSTD
+    case Compression::zstd: return true;
+#endif
+    case Compression::none: return true;
+    default: return false;
+    }
+}
+
+InputStream::InputStream(std::filesystem::path const& path, InputStreamOptions options)
+    : m_pipeline(std::make_unique<Pipeline>())
+{
+    m_pipeline->source = open_source(path, m_compression);
+    m_pipeline->options = options;
+    m_pipeline->options.buffer_size = std::max<std::size_t>(options.buffer_size, 1);
+    m_pipeline->options.queue_depth = std::max<std::size_t>(options.queue_depth, 1);
+    m_pipeline->thread = std::thread([pipeline = m_pipeline.get()] { pipeline->run(); });
+}
+
+InputStream::~InputStream()
+{
+    {
+        std::lock_guard lock(m_pipeline->mutex);
+        m_pipeline->stopping = true;
+    }
+    m_pipeline->space_cv.notify_one();
+    m_pipeline->thread.join();
+}
+
+auto InputStream::take() -> std::optional<std::vector<char>>
+{
+    std::unique_lock lock(m_pipeline->mutex);
+    m_pipeline->filled_cv.wait(lock, [&] { return m_pipeline->finished || !m_pipeline->filled.empty(); });
+    if (m_pipeline->filled.empty()) {
+        if (m_pipeline->error) {
+            std::rethrow_exception(m_pipeline->error);
+        }
+        return std::nullopt;
+    }
+    auto buffer = std::move(m_pipeline->filled.front());
+    m_pipeline->filled.pop_front();
+    m_pipeline->space_cv.notify_one();
+    return buffer;
+}
+
+void InputStream::recycle(std::vector<char> buffer)
+{
+    std::lock_guard lock(m_pipeline->mutex);
+    if (m_pipeline->free.size() < m_pipeline->options.queue_depth + 1) {
+        m_pipeline->free.push_back(std::move(buffer));
+    }
+}
+
+auto InputStream::read(char* out, std::size_t size) -> std::size_t
+{
+    std::size_t copied = 0;
+    while (copied < size) {
+        if (m_current_pos == m_current.size()) {
+            auto next = take();
+            if (!next) {
+                break;
+            }
+            recycle(std::move(m_current));
+            m_current = std::move(*next);
+            m_current_pos = 0;
+        }
+        auto count = std::min(size - copied, m_current.size() - m_current_pos);
+        std::memcpy(out + copied, m_current.data() + m_current_pos, count);
+        m_current_pos += count;
+        copied += count;
+    }
+    return copied;
+}
+
+auto InputStream::read_all() -> std::string
+{
+    std::string text(m_current.begin() + static_cast<std::ptrdiff_t>(m_current_pos), m_current.end());
+    m_current_pos = m_current.size();
+    while (auto buffer = take()) {
+        text.append(buffer->data(), buffer->size());
+        recycle(std::move(*buffer));
+    }
+    return text;
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,347 @@
+#include "eval_metrics/detail/json_run.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include "eval_metrics/detail/numeric.hpp"
+#include "eval_metrics/error.hpp"
+
+namespace eval_metrics::detail {
+
+namespace {
+
+/// Nesting limit of skipped values, so that hostile input cannot exhaust the stack.
+constexpr int max_depth = 64;
+
+[[nodiscard]] constexpr auto is_json_space(char c) noexcept -> bool
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+[[nodiscard]] constexpr auto is_number_char(char c) noexcept -> bool
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+[[nodiscard]] auto hex_value(char c) -> std::uint32_t
+{
+    if (c >= '0' && c <= '9') {
+        return static_cast<std::uint32_t>(c - '0');
+    }
+    if (c >= 'a' && c <= 'f') {
+        return static_cast<std::uint32_t>(c - 'a' + 10);
+    }
+    if (c >= 'A' && c <= 'F') {
+        return static_cast<std::uint32_t>(c - 'A' + 10);
+    }
+    throw ParseError("invalid \\u escape");
+}
+
+void append_utf8(std::string& out, std::uint32_t code)
+{
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6U)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3FU)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12U)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6U) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3FU)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18U)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12U) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6U) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3FU)));
+    }
+}
+
+/// A forward-only scanner over one line of JSON; strings without escapes are
+/// returned as views of the line.
+class Scanner {
+  public:
+    Scanner(std::string_view text, std::deque<std::string>& arena) noexcept : m_text(text), m_arena(arena) {}
+
+    void skip_space() noexcept
+    {
+        while (m_pos < m_text.size() && is_json_space(m_text[m_pos])) {
+            ++m_pos;
+        }
+    }
+
+    [[nodiscard]] auto at_end() noexcept -> bool
+    {
+        skip_space();
+        return m_pos == m_text.size();
+    }
+
+    [[nodiscard]] auto peek() noexcept -> char
+    {
+        skip_space();
+        return m_pos < m_text.size() ? m_text[m_pos] : '\0';
+    }
+
+    /// Consumes `c` if it is the next non-blank character.
+    [[nodiscard]] auto consume(char c) noexcept -> bool
+    {
+        if (peek() != c) {
+            return false;
+        }
+        ++m_pos;
+        return true;
+    }
+
+    void expect(char c)
+    {
+        if (!consume(c)) {
+            throw ParseError(std::string("expected '") + c + "' in JSON ranking");
+        }
+    }
+
+    /// Whether another member or element follows: consumes `,` or the closing `close`.
+    [[nodiscard]] auto more(char close) -> bool
+    {
+        if (consume(',')) {
+            return true;
+        }
+        expect(close);
+        return false;
+    }
+
+    [[nodiscard]] auto string() -> std::string_view
+    {
+        expect('"');
+        auto begin = m_pos;
+        auto const* data = m_text.data();
+        auto const* quote = static_cast<char const*>(std::memchr(data + begin, '"', m_text.size() - begin));
+        if (quote == nullptr) {
+            throw ParseError("unterminated JSON string");
+        }
+        auto end = static_cast<std::size_t>(quote - data);
+        if (std::memchr(data + begin, '\\', end - begin) == nullptr) {
+            m_pos = end + 1;
+            return m_text.substr(begin, end - begin);
+        }
+        return escaped_string(begin);
+    }
+
+    [[nodiscard]] auto number() -> std::string_view
+    {
+        skip_space();
+        auto begin = m_pos;
+        while (m_pos < m_text.size() && is_number_char(m_text[m_pos])) {
+            ++m_pos;
+        }
+        if (m_pos == begin) {
+            throw ParseError("expected a JSON value");
+        }
+        return m_text.substr(begin, m_pos - begin);
+    }
+
+    /// An ID given as a string or as a number (kept as written).
+    [[nodiscard]] auto id() -> std::string_view { return peek() == '"' ? string() : number(); }
+
+    void skip_value(int depth = 0)
+    {
+        if (depth > max_depth) {
+            throw ParseError("JSON nested too deeply");
+        }
+        switch (peek()) {
+        case '"': static_cast<void>(string()); return;
+        case '{':
+            ++m_pos;
+            if (!consume('}')) {
+                do {
+                    static_cast<void>(string());
+                    expect(':');
+                    skip_value(depth + 1);
+                } while (more('}'));
+            }
+            return;
+        case '[':
+            ++m_pos;
+            if (!consume(']')) {
+                do {
+                    skip_value(depth + 1);
+                } while (more(']'));
+            }
+            return;
+        case 't': literal("true"); return;
+        case 'f': literal("false"); return;
+        case 'n': literal("null"); return;
+        default: static_cast<void>(number());
+        }
+    }
+
+  private:
+    void literal(std::string_view word)
+    {
+        if (m_text.substr(m_pos, word.size()) != word) {
+            throw ParseError("invalid JSON literal");
+        }
+        m_pos += word.size();
+    }
+
+    [[nodiscard]] auto escaped_string(std::size_t begin) -> std::string_view
+    {
+        auto& out = m_arena.emplace_back();
+        auto pos = begin;
+        while (true) {
+            if (pos >= m_text.size()) {
+                throw ParseError("unterminated JSON string");
+            }
+            char c = m_text[pos++];
+            if (c == '"') {
+                break;
+            }
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (pos >= m_text.size()) {
+                throw ParseError("unterminated JSON string");
+            }
+            switch (char escape = m_text[pos++]) {
+            case '"':
+            case '\\':
+            case '/': out.push_back(escape); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                auto code = code_unit(pos);
+                if (code >= 0xD800 && code < 0xDC00 && m_text.substr(pos, 2) == "\\u") {
+                    pos += 2;
+                    auto low = code_unit(pos);
+                    if (low < 0xDC00 || low >= 0xE000) {
+                        throw ParseError("invalid surrogate pair in JSON string");
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10U) + (low - 0xDC00);
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default: throw ParseError("invalid escape in JSON string");
+            }
+        }
+        m_pos = pos;
+        return out;
+    }
+
+    [[nodiscard]] auto code_unit(std::size_t& pos) -> std::uint32_t
+    {
+        if (pos + 4 > m_text.size()) {
+            throw ParseError("invalid \\u escape");
+        }
+        std::uint32_t code = 0;
+        for (int digit = 0; digit < 4; ++digit) {
+            code = code * 16 + hex_value(m_text[pos++]);
+        }
+        return code;
+    }
+
+    std::string_view m_text;
+    std::deque<std::string>& m_arena;
+    std::size_t m_pos = 0;
+};
+
+/// Parses one element of `docs` into `parsed`, whose rank is preset to the position.
+void parse_doc(Scanner& scanner, RunLine& parsed)
+{
+    bool has_id = false;
+    bool has_score = false;
+    scanner.expect('{');
+    if (!scanner.consume('}')) {
+        do {
+            auto key = scanner.string();
+            scanner.expect(':');
+            if (key == "id" || key == "docid") {
+                parsed.doc.doc = scanner.id();
+                has_id = true;
+            } else if (key == "score") {
+                auto value = scanner.number();
+                if (!parse_score(value, parsed.doc.score)) {
+                    throw ParseError("invalid score: " + std::string(value));
+                }
+                has_score = true;
+            } else if (key == "rank") {
+                auto value = scanner.number();
+                if (!parse_integer(value, parsed.doc.rank)) {
+                    throw ParseError("invalid rank: " + std::string(value));
+                }
+            } else {
+                scanner.skip_value();
+            }
+        } while (scanner.more('}'));
+    }
+    if (!has_id || !has_score) {
+        throw ParseError("each document needs an \"id\" and a \"score\"");
+    }
+}
+
+}  // namespace
+
+auto is_json_run(std::string_view head) noexcept -> bool
+{
+    for (char c : head) {
+        if (!is_json_space(c) && c != '\v' && c != '\f') {
+            return c == '{';
+        }
+    }
+    return false;
+}
+
+auto parse_json_ranking(std::string_view line, std::deque<std::string>& arena, std::vector<RunLine>& lines)
+    -> bool
+{
+    Scanner scanner(line, arena);
+    if (scanner.at_end()) {
+        return false;
+    }
+    auto first = lines.size();
+    std::string_view query;
+    std::string_view tag;
+    bool has_query = false;
+    bool has_docs = false;
+    scanner.expect('{');
+    if (!scanner.consume('}')) {
+        do {
+            auto key = scanner.string();
+            scanner.expect(':');
+            if (key == "qid") {
+                query = scanner.id();
+                has_query = true;
+            } else if (key == "docs") {
+                has_docs = true;
+                scanner.expect('[');
+                if (!scanner.consume(']')) {
+                    std::int64_t position = 0;
+                    do {
+                        auto& parsed = lines.emplace_back();
+                        parsed.doc.rank = ++position;
+                        parse_doc(scanner, parsed);
+                    } while (scanner.more(']'));
+                }
+            } else if (key == "tag" || key == "run") {
+                tag = scanner.string();
+            } else {
+                scanner.skip_value();
+            }
+        } while (scanner.more('}'));
+    }
+    if (!scanner.at_end()) {
+        throw ParseError("unexpected characters after the JSON ranking");
+    }
+    if (!has_query || !has_docs) {
+        throw ParseError("a JSON ranking needs a \"qid\" and \"docs\"");
+    }
+    for (auto idx = first; idx < lines.size(); ++idx) {
+        lines[idx].query = query;
+        lines[idx].tag = tag;
+    }
+    return true;
+}
+
+}  // namespace eval_metrics::detail
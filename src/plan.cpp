@@ -0,0 +1,394 @@
+#include "eval_metrics/plan.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <optional>
+
+#include "eval_metrics/detail/numeric.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/fused.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+constexpr std::array<std::size_t, 9> standard_cutoffs{5, 10, 15, 20, 30, 100, 200, 500, 1000};
+
+constexpr std::array<std::size_t, 3> success_cutoffs{1, 5, 10};
+constexpr std::array<std::size_t, 3> err_cutoffs{5, 10, 20};
+constexpr double default_persistence = 0.8;
+
+/// What the parameters of a measure specification are.
+enum class Parameters { none, cutoffs, persistences };
+
+struct MeasureDefinition {
+    std::string_view name;
+    Measure measure;
+    Parameters parameters = Parameters::none;
+    /// Whether `EvaluationPlan::standard` includes the measure.
+    bool standard = true;
+};
+
+constexpr std::array<MeasureDefinition, 19> definitions{{
+    {"num_ret", Measure::num_ret},
+    {"num_rel", Measure::num_rel},
+    {"num_rel_ret", Measure::num_rel_ret},
+    {"map", Measure::map},
+    {"Rprec", Measure::rprec},
+    {"recip_rank", Measure::recip_rank},
+    {"P", Measure::precision, Parameters::cutoffs},
+    {"recall", Measure::recall, Parameters::cutoffs},
+    {"success", Measure::success, Parameters::cutoffs, false},
+    {"ndcg", Measure::ndcg},
+    {"ndcg_cut", Measure::ndcg_cut, Parameters::cutoffs},
+    {"ndcg_exp", Measure::ndcg_exp, Parameters::none, false},
+    {"ndcg_exp_cut", Measure::ndcg_exp_cut, Parameters::cutoffs, false},
+    {"err", Measure::err, Parameters::cutoffs, false},
+    {"rbp", Measure::rbp, Parameters::persistences, false},
+    {"rbp_res", Measure::rbp_residual, Parameters::persistences, false},
+    {"bpref", Measure::bpref, Parameters::none, false},
+    {"infAP", Measure::infap, Parameters::none, false},
+    {"judged", Measure::judged, Parameters::cutoffs, false},
+}};
+
+[[nodiscard]] auto find_definition(std::string_view name) -> MeasureDefinition const*
+{
+    auto pos = std::find_if(definitions.begin(), definitions.end(), [&](auto const& definition) {
+        return definition.name == name;
+    });
+    return pos == definitions.end() ? nullptr : &*pos;
+}
+
+[[nodiscard]] auto parse_cutoff(std::string_view text) -> std::optional<std::size_t>
+{
+    std::size_t cutoff = 0;
+    if (!detail::parse_integer(text, cutoff) || cutoff == 0) {
+        return std::nullopt;
+    }
+    return cutoff;
+}
+
+[[nodiscard]] auto parse_persistence(std::string_view text) -> std::optional<double>
+{
+    double p = 0.0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), p);
+    if (text.empty() || ec != std::errc() || end != text.data() + text.size() || !(p > 0.0 && p < 1.0)) {
+        return std::nullopt;
+    }
+    return p;
+}
+
+/// The shortest text that reads back as `p`, as in `rbp_0.8`.
+[[nodiscard]] auto persistence_name(double p) -> std::string
+{
+    std::array<char, 32> text{};
+    auto [end, ec] = std::to_chars(text.begin(), text.end(), p);
+    return {text.data(), end};
+}
+
+/// A measure specification split into its definition and its parameters: either
+/// `name.param,param`, or a printed name `name_param`.
+struct ParsedSpec {
+    MeasureDefinition const* definition = nullptr;
+    std::vector<std::string_view> parameters;
+};
+
+[[nodiscard]] auto parse_spec(std::string_view spec) -> ParsedSpec
+{
+    ParsedSpec parsed;
+    auto dot = spec.find('.');
+    parsed.definition = find_definition(spec.substr(0, dot));
+    if (parsed.definition != nullptr) {
+        for (auto list = spec.substr(std::min(dot, spec.size())); !list.empty();) {
+            list.remove_prefix(1);
+            auto comma = std::min(list.find(','), list.size());
+            parsed.parameters.push_back(list.substr(0, comma));
+            list.remove_prefix(comma);
+        }
+        return parsed;
+    }
+    auto underscore = spec.rfind('_');
+    if (underscore != std::string_view::npos) {
+        parsed.definition = find_definition(spec.substr(0, underscore));
+        parsed.parameters.push_back(spec.substr(underscore + 1));
+        if (parsed.definition != nullptr && parsed.definition->parameters == Parameters::none) {
+            parsed.definition = nullptr;
+        }
+    }
+    return parsed;
+}
+
+template <bool WithDcg, bool WithCascade, bool WithIncomplete>
+void run_pass(
+    std::span<std::int32_t const> grades,
+    std::size_t num_rel,
+    std::int32_t relevance_level,
+    std::span<std::size_t const> cutoffs,
+    std::span<std::size_t> relevant_at,
+    std::span<double> dcg_at,
+    FusedTotals& totals,
+    DiscountTable const& discounts,
+    FusedCascade& cascade,
+    FusedIncomplete& incomplete) noexcept
+{
+    fused_pass<WithDcg, WithCascade, WithIncomplete>(
+        grades, num_rel, relevance_level, cutoffs, relevant_at, dcg_at, totals, discounts, &cascade, &incomplete);
+}
+
+using PassFunction = decltype(&run_pass<true, true, true>);
+
+/// The `fused_pass` that accumulates what a plan needs and nothing more.
+[[nodiscard]] auto select_pass(bool dcg, bool cascade, bool incomplete) noexcept -> PassFunction
+{
+    constexpr std::array<PassFunction, 8> passes{
+        run_pass<false, false, false>,
+        run_pass<false, false, true>,
+        run_pass<false, true, false>,
+        run_pass<false, true, true>,
+        run_pass<true, false, false>,
+        run_pass<true, false, true>,
+        run_pass<true, true, false>,
+        run_pass<true, true, true>};
+    return passes[(dcg ? 4U : 0U) | (cascade ? 2U : 0U) | (incomplete ? 1U : 0U)];
+}
+
+[[nodiscard]] auto is_number(std::string_view text) -> bool
+{
+    return !text.empty() && text.front() >= '0' && text.front() <= '9'
+        && std::all_of(text.begin(), text.end(), [](char c) { return (c >= '0' && c <= '9') || c == '.'; });
+}
+
+}  // namespace
+
+auto split_measures(std::string_view list) -> std::vector<std::string>
+{
+    std::vector<std::string> specs;
+    while (!list.empty()) {
+        auto comma = list.find(',');
+        auto item = list.substr(0, comma);
+        if (is_number(item) && !specs.empty() && specs.back().find('.') != std::string::npos) {
+            specs.back().append(",").append(item);
+        } else if (!item.empty()) {
+            specs.emplace_back(item);
+        }
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+    return specs;
+}
+
+auto EvaluationPlan::compile(std::span<std::string const> specs, CascadeOptions const& cascade) -> EvaluationPlan
+{
+    EvaluationPlan plan;
+    for (std::string_view spec : specs) {
+        auto [definition, parameters] = parse_spec(spec);
+        if (definition == nullptr) {
+            throw Error("unknown measure " + std::string(spec));
+        }
+        std::string name(definition->name);
+        switch (definition->parameters) {
+        case Parameters::none:
+            if (!parameters.empty()) {
+                throw Error("measure " + name + " takes no parameters");
+            }
+            plan.add(definition->measure, name, 0, 0.0);
+            break;
+        case Parameters::cutoffs: {
+            std::vector<std::size_t> cutoffs;
+            for (auto parameter : parameters) {
+                auto cutoff = parse_cutoff(parameter);
+                if (!cutoff) {
+                    throw Error("invalid cutoff in measure " + std::string(spec));
+                }
+                cutoffs.push_back(*cutoff);
+            }
+            if (cutoffs.empty() && definition->measure == Measure::success) {
+                cutoffs.assign(success_cutoffs.begin(), success_cutoffs.end());
+            } else if (cutoffs.empty() && definition->measure == Measure::err) {
+                cutoffs.assign(err_cutoffs.begin(), err_cutoffs.end());
+            } else if (cutoffs.empty()) {
+                cutoffs.assign(standard_cutoffs.begin(), standard_cutoffs.end());
+            }
+            for (auto cutoff : cutoffs) {
+                plan.add(definition->measure, name + "_" + std::to_string(cutoff), cutoff, 0.0);
+            }
+            break;
+        }
+        case Parameters::persistences: {
+            std::vector<double> persistences;
+            for (auto parameter : parameters) {
+                auto p = parse_persistence(parameter);
+                if (!p) {
+                    throw Error("invalid persistence in measure " + std::string(spec) + " (must be in (0, 1))");
+                }
+                persistences.push_back(*p);
+            }
+            if (persistences.empty()) {
+                persistences.push_back(default_persistence);
+            }
+            for (auto p : persistences) {
+                plan.add(definition->measure, name + "_" + persistence_name(p), 0, p);
+            }
+            break;
+        }
+        }
+    }
+
+    // Merge the cutoffs of all the metrics, and point each step at its position.
+    std::sort(plan.m_cutoffs.begin(), plan.m_cutoffs.end());
+    plan.m_cutoffs.erase(std::unique(plan.m_cutoffs.begin(), plan.m_cutoffs.end()), plan.m_cutoffs.end());
+    for (auto& step : plan.m_steps) {
+        if (step.measure == Measure::rbp || step.measure == Measure::rbp_residual) {
+            continue;
+        }
+        step.slot = static_cast<std::size_t>(
+            std::lower_bound(plan.m_cutoffs.begin(), plan.m_cutoffs.end(), step.slot) - plan.m_cutoffs.begin());
+    }
+    if (plan.m_needs_cascade) {
+        if (!cascade.stop_probabilities.empty()) {
+            plan.m_stop_probabilities = cascade.stop_probabilities;
+        } else {
+            auto max_grade = std::max(cascade.max_grade, 1);
+            auto scale = gain_of(max_grade, cascade.gain) + 1.0;
+            for (std::int32_t grade = 0; grade <= max_grade; ++grade) {
+                plan.m_stop_probabilities.push_back(gain_of(grade, cascade.gain) / scale);
+            }
+        }
+    }
+    if (plan.m_needs_dcg || plan.m_needs_exponential_dcg) {
+        plan.m_discounts = DiscountTable(plan.m_depth == no_cutoff ? DiscountTable::default_depth : plan.m_depth);
+    }
+    return plan;
+}
+
+auto EvaluationPlan::standard() -> EvaluationPlan
+{
+    std::vector<std::string> specs;
+    for (auto const& definition : definitions) {
+        if (definition.standard) {
+            specs.emplace_back(definition.name);
+        }
+    }
+    return compile(specs);
+}
+
+void EvaluationPlan::add(Measure measure, std::string name, std::size_t cutoff, double persistence)
+{
+    auto duplicate = std::find_if(m_metrics.begin(), m_metrics.end(), [&](auto const& info) {
+        return info.name == name;
+    });
+    if (duplicate != m_metrics.end()) {
+        return;
+    }
+    MetricInfo info{std::move(name)};
+    std::size_t slot = cutoff;
+    switch (measure) {
+    case Measure::num_ret:
+    case Measure::num_rel:
+    case Measure::num_rel_ret:
+        info.aggregation = Aggregation::sum;
+        info.integral = true;
+        info.depth = 0;
+        break;
+    case Measure::rprec:
+        info.depth = 0;
+        info.depth_num_rel = true;
+        break;
+    case Measure::precision:
+    case Measure::recall:
+    case Measure::success:
+    case Measure::ndcg_cut:
+    case Measure::ndcg_exp_cut:
+    case Measure::err:
+    case Measure::judged:
+        info.depth = cutoff;
+        m_cutoffs.push_back(cutoff);
+        break;
+    case Measure::rbp:
+    case Measure::rbp_residual: {
+        auto pos = std::find(m_persistences.begin(), m_persistences.end(), persistence);
+        slot = static_cast<std::size_t>(pos - m_persistences.begin());
+        if (pos == m_persistences.end()) {
+            m_persistences.push_back(persistence);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    m_depth = std::max(m_depth, info.depth);
+    m_depends_on_num_rel = m_depends_on_num_rel || info.depth_num_rel;
+    m_needs_dcg = m_needs_dcg || measure == Measure::ndcg || measure == Measure::ndcg_cut;
+    m_needs_exponential_dcg = m_needs_exponential_dcg || measure == Measure::ndcg_exp_cut;
+    m_needs_cascade = m_needs_cascade || measure == Measure::err || measure == Measure::rbp
+        || measure == Measure::rbp_residual;
+    m_needs_incomplete = m_needs_incomplete || measure == Measure::bpref || measure == Measure::infap
+        || measure == Measure::judged;
+    m_metrics.push_back(std::move(info));
+    m_steps.push_back({measure, slot});
+}
+
+void EvaluationPlan::evaluate(
+    std::span<std::int32_t const> grades,
+    QrelsStatistics const& statistics,
+    std::size_t query,
+    std::int32_t relevance_level,
+    Workspace& workspace,
+    std::span<double> values) const
+{
+    auto num_rel = statistics.num_relevant(query, relevance_level);
+    FusedTotals totals;
+    FusedCascade cascade{
+        m_stop_probabilities,
+        m_persistences,
+        workspace.m_err_at,
+        0.0,
+        workspace.m_rbp,
+        workspace.m_rbp_residual,
+        workspace.m_weights};
+    FusedIncomplete incomplete{
+        m_needs_incomplete ? statistics.num_nonrelevant(query, relevance_level) : 0, workspace.m_judged_at};
+    auto pass = select_pass(m_needs_dcg, m_needs_cascade, m_needs_incomplete);
+    pass(grades, num_rel, relevance_level, m_cutoffs, workspace.m_relevant_at, workspace.m_dcg_at, totals,
+         m_discounts, cascade, incomplete);
+    if (m_needs_exponential_dcg) {
+        vector_dcg_at(grades, m_discounts, Gain::exponential, m_cutoffs, workspace.m_exponential_dcg_at);
+        vector_dcg_at(statistics.ideal_gains(query), m_discounts, Gain::exponential, m_cutoffs,
+                      workspace.m_ideal_exponential_dcg_at);
+    }
+    for (std::size_t idx = 0; idx < m_steps.size(); ++idx) {
+        auto [measure, slot] = m_steps[idx];
+        auto& value = values[idx];
+        switch (measure) {
+        case Measure::num_ret: value = static_cast<double>(grades.size()); break;
+        case Measure::num_rel: value = static_cast<double>(num_rel); break;
+        case Measure::num_rel_ret: value = static_cast<double>(totals.relevant); break;
+        case Measure::map: value = fused_average_precision(totals, num_rel); break;
+        case Measure::rprec: value = fused_r_precision(totals, num_rel); break;
+        case Measure::recip_rank: value = fused_reciprocal_rank(totals); break;
+        case Measure::precision:
+            value = fused_precision(workspace.m_relevant_at[slot], m_cutoffs[slot]);
+            break;
+        case Measure::recall: value = fused_recall(workspace.m_relevant_at[slot], num_rel); break;
+        case Measure::success: value = fused_success(workspace.m_relevant_at[slot]); break;
+        case Measure::ndcg: value = fused_ndcg(totals.dcg, statistics.ideal_dcg(query)); break;
+        case Measure::ndcg_cut:
+            value = fused_ndcg(workspace.m_dcg_at[slot], statistics.ideal_dcg(query, m_cutoffs[slot]));
+            break;
+        case Measure::ndcg_exp:
+            value = vector_ndcg(grades, statistics.ideal_gains(query), m_discounts, Gain::exponential);
+            break;
+        case Measure::ndcg_exp_cut:
+            value = fused_ndcg(workspace.m_exponential_dcg_at[slot], workspace.m_ideal_exponential_dcg_at[slot]);
+            break;
+        case Measure::err: value = workspace.m_err_at[slot]; break;
+        case Measure::rbp: value = workspace.m_rbp[slot]; break;
+        case Measure::rbp_residual: value = workspace.m_rbp_residual[slot]; break;
+        case Measure::bpref: value = incomplete.bpref; break;
+        case Measure::infap: value = incomplete.infap; break;
+        case Measure::judged: value = fused_judged(workspace.m_judged_at[slot], m_cutoffs[slot]); break;
+        }
+    }
+}
+
+}  // namespace eval_metrics
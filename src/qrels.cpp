@@ -0,0 +1,180 @@
+#include "eval_metrics/qrels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+#include "eval_metrics/binary_format.hpp"
+#include "eval_metrics/detail/numeric.hpp"
+#include "eval_metrics/detail/segmented_text.hpp"
+#include "eval_metrics/detail/tokenizer.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/input_stream.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+struct QrelsLine {
+    std::string_view query;
+    Judgment judgment;
+};
+
+[[nodiscard]] auto line_less(QrelsLine const& lhs, QrelsLine const& rhs) noexcept -> bool
+{
+    if (lhs.query != rhs.query) {
+        return lhs.query < rhs.query;
+    }
+    return lhs.judgment.doc < rhs.judgment.doc;
+}
+
+[[nodiscard]] auto parse_grade(std::string_view field, std::size_t line) -> std::int32_t
+{
+    std::int32_t grade = 0;
+    if (!detail::parse_integer(field, grade)) {
+        throw ParseError("invalid relevance grade: " + std::string(field), line);
+    }
+    return grade;
+}
+
+/// Appends the judgments of the lines of `text`, which starts after `preceding_lines`
+/// lines of the input.
+void parse_lines(std::string_view text, std::size_t preceding_lines, std::vector<QrelsLine>& lines)
+{
+    detail::FieldTokenizer tokenizer(text, preceding_lines + 1);
+    std::array<std::string_view, 4> fields;
+    std::size_t count = 0;
+    while (tokenizer.next(fields, count)) {
+        if (count == 0) {
+            continue;
+        }
+        if (count != fields.size()) {
+            throw ParseError("expected 4 fields: qid iter docno rel", tokenizer.line_number());
+        }
+        lines.push_back({fields[0], {fields[2], parse_grade(fields[3], tokenizer.line_number())}});
+    }
+}
+
+/// Orders the parsed judgments into qrels whose views point into `storage`.
+[[nodiscard]] auto assemble(std::shared_ptr<void const> storage, std::vector<QrelsLine> lines) -> Qrels
+{
+    if (!std::is_sorted(lines.begin(), lines.end(), line_less)) {
+        std::stable_sort(lines.begin(), lines.end(), line_less);
+    }
+
+    std::vector<std::string_view> query_ids;
+    std::vector<std::size_t> offsets;
+    std::vector<Judgment> judgments;
+    judgments.reserve(lines.size());
+    for (std::size_t idx = 0; idx < lines.size(); ++idx) {
+        auto const& current = lines[idx];
+        if (idx == 0 || current.query != lines[idx - 1].query) {
+            query_ids.push_back(current.query);
+            offsets.push_back(idx);
+        } else if (current.judgment.doc == lines[idx - 1].judgment.doc) {
+            throw ParseError(
+                "duplicate judgment of document " + std::string(current.judgment.doc)
+                + " in query " + std::string(current.query));
+        }
+        judgments.push_back(current.judgment);
+    }
+    offsets.push_back(lines.size());
+
+    std::vector<std::string_view> docs;
+    docs.reserve(lines.size());
+    for (auto const& judgment : judgments) {
+        docs.push_back(judgment.doc);
+    }
+    auto dictionary = std::make_shared<DocDictionary>(DocDictionary::from_docs(std::move(docs)));
+    for (auto& judgment : judgments) {
+        judgment.id = dictionary->lookup(judgment.doc);
+    }
+    return Qrels(
+        std::move(storage), std::move(dictionary), std::move(query_ids), std::move(offsets), std::move(judgments));
+}
+
+/// Parses compressed qrels as they are decompressed, one buffer at a time (see
+/// `detail::read_segments`); compressed binary qrels are read whole.
+[[nodiscard]] auto parse_compressed(InputStream& input) -> Qrels
+{
+    auto head = input.take();
+    if (head && is_binary_format({head->data(), head->size()})) {
+        std::string bytes(head->data(), head->size());
+        bytes += input.read_all();
+        return read_binary_qrels(Buffer::from_string(std::move(bytes)));
+    }
+    auto text = std::make_shared<detail::SegmentedText>();
+    std::vector<QrelsLine> lines;
+    detail::read_segments(
+        input, *text,
+        [&](std::string_view segment, std::size_t lines_before) { parse_lines(segment, lines_before, lines); },
+        std::move(head));
+    return assemble(std::move(text), std::move(lines));
+}
+
+}  // namespace
+
+Qrels::Qrels(
+    std::shared_ptr<void const> storage,
+    std::shared_ptr<DocDictionary const> dictionary,
+    std::vector<std::string_view> query_ids,
+    std::vector<std::size_t> offsets,
+    std::vector<Judgment> judgments,
+    std::shared_ptr<QrelsStatistics const> statistics)
+    : m_storage(std::move(storage)),
+      m_dictionary(std::move(dictionary)),
+      m_query_ids(std::move(query_ids)),
+      m_offsets(std::move(offsets)),
+      m_judgments(std::move(judgments)),
+      m_statistics(std::move(statistics))
+{
+    if (!m_statistics) {
+        m_statistics = std::make_shared<QrelsStatistics>(*this);
+    }
+}
+
+auto Qrels::from_file(std::filesystem::path const& path) -> Qrels
+{
+    auto buffer = Buffer::map_file(path);
+    if (detect_compression(buffer->view().substr(0, 4)) != Compression::none) {
+        buffer.reset();
+        InputStream input(path);
+        return parse_compressed(input);
+    }
+    if (is_binary_format(buffer->view())) {
+        return read_binary_qrels(std::move(buffer));
+    }
+    return parse(std::move(buffer));
+}
+
+auto Qrels::parse(std::shared_ptr<Buffer const> buffer) -> Qrels
+{
+    std::vector<QrelsLine> lines;
+    parse_lines(buffer->view(), 0, lines);
+    return assemble(std::move(buffer), std::move(lines));
+}
+
+auto Qrels::find_query(std::string_view query_id) const noexcept -> std::optional<std::size_t>
+{
+    auto pos = std::lower_bound(m_query_ids.begin(), m_query_ids.end(), query_id);
+    if (pos == m_query_ids.end() || *pos != query_id) {
+        return std::nullopt;
+    }
+    return static_cast<std::size_t>(std::distance(m_query_ids.begin(), pos));
+}
+
+auto Qrels::grade(std::size_t query, std::uint32_t doc_id) const noexcept
+    -> std::optional<std::int32_t>
+{
+    auto judged = judgments(query);
+    auto pos = std::lower_bound(
+        judged.begin(), judged.end(), doc_id, [](Judgment const& j, std::uint32_t id) {
+            return j.id < id;
+        });
+    if (pos == judged.end() || pos->id != doc_id) {
+        return std::nullopt;
+    }
+    return pos->grade;
+}
+
+}  // namespace eval_metrics
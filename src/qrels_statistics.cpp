@@ -0,0 +1,68 @@
+#include "eval_metrics/qrels_statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "eval_metrics/qrels.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+struct OwnedColumns {
+    std::vector<std::uint64_t> grade_offsets{0};
+    std::vector<std::int32_t> grade_values;
+    std::vector<std::uint64_t> grade_counts;
+    std::vector<std::uint64_t> ideal_offsets{0};
+    std::vector<std::int32_t> ideal_gains;
+    std::vector<double> ideal_dcg;
+};
+
+}  // namespace
+
+QrelsStatistics::QrelsStatistics(Qrels const& qrels)
+{
+    auto owned = std::make_shared<OwnedColumns>();
+    std::vector<std::int32_t> grades;
+    for (std::size_t query = 0; query < qrels.num_queries(); ++query) {
+        grades.clear();
+        for (auto const& judgment : qrels.judgments(query)) {
+            grades.push_back(judgment.grade);
+        }
+        std::sort(grades.begin(), grades.end(), std::greater<>());
+        for (std::size_t pos = 0; pos < grades.size(); ++pos) {
+            if (pos > 0 && grades[pos] == grades[pos - 1]) {
+                owned->grade_counts.back() = pos + 1;
+            } else {
+                owned->grade_values.push_back(grades[pos]);
+                owned->grade_counts.push_back(pos + 1);
+            }
+        }
+        owned->grade_offsets.push_back(owned->grade_values.size());
+
+        // Same summation order as `dcg`, so that the prefix sums are exact.
+        double sum = 0.0;
+        owned->ideal_dcg.push_back(sum);
+        for (std::size_t rank = 0; rank < grades.size() && grades[rank] > 0; ++rank) {
+            owned->ideal_gains.push_back(grades[rank]);
+            sum += static_cast<double>(grades[rank]) / std::log2(static_cast<double>(rank + 2));
+            owned->ideal_dcg.push_back(sum);
+        }
+        owned->ideal_offsets.push_back(owned->ideal_gains.size());
+    }
+    m_columns = {
+        owned->grade_offsets,
+        owned->grade_values,
+        owned->grade_counts,
+        owned->ideal_offsets,
+        owned->ideal_gains,
+        owned->ideal_dcg};
+    m_storage = std::move(owned);
+}
+
+QrelsStatistics::QrelsStatistics(std::shared_ptr<void const> storage, Columns columns) noexcept
+    : m_storage(std::move(storage)), m_columns(columns)
+{}
+
+}  // namespace eval_metrics
@@ -0,0 +1,198 @@
+#include "eval_metrics/ranking.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <numeric>
+#include <span>
+#include <utility>
+
+namespace eval_metrics {
+
+namespace {
+
+/// Rankings shorter than this are sorted by comparison, which beats the fixed cost of
+/// the radix sort's histograms.
+constexpr std::size_t min_radix_size = 64;
+
+constexpr std::uint64_t sign_bit = std::uint64_t{1} << 63U;
+
+/// A key whose unsigned order is the descending order of the scores. Both zeros map
+/// to the same key, since `trec_eval` considers them equal.
+[[nodiscard]] auto descending_key(double score) noexcept -> std::uint64_t
+{
+    auto bits = std::bit_cast<std::uint64_t>(score == 0.0 ? 0.0 : score);
+    auto ascending = (bits & sign_bit) != 0 ? ~bits : bits | sign_bit;
+    return ~ascending;
+}
+
+[[nodiscard]] auto ascending_key(std::int64_t rank) noexcept -> std::uint64_t
+{
+    return std::bit_cast<std::uint64_t>(rank) ^ sign_bit;
+}
+
+/// Stably sorts `order` by `keys` (moved along), one byte at a time from the least
+/// significant, skipping the bytes in which all keys agree.
+void radix_sort(
+    std::vector<std::uint64_t>& keys,
+    std::vector<std::uint32_t>& order,
+    std::vector<std::uint64_t>& key_scratch,
+    std::vector<std::uint32_t>& order_scratch)
+{
+    auto size = keys.size();
+    std::array<std::array<std::uint32_t, 256>, 8> counts{};
+    for (auto key : keys) {
+        for (std::size_t byte = 0; byte < 8; ++byte) {
+            ++counts[byte][(key >> (8 * byte)) & 0xFFU];
+        }
+    }
+    key_scratch.resize(size);
+    order_scratch.resize(size);
+    for (std::size_t byte = 0; byte < 8; ++byte) {
+        auto& count = counts[byte];
+        if (count[(keys[0] >> (8 * byte)) & 0xFFU] == size) {
+            continue;
+        }
+        std::uint32_t offset = 0;
+        for (auto& bucket : count) {
+            offset += std::exchange(bucket, offset);
+        }
+        for (std::size_t pos = 0; pos < size; ++pos) {
+            auto target = count[(keys[pos] >> (8 * byte)) & 0xFFU]++;
+            key_scratch[target] = keys[pos];
+            order_scratch[target] = order[pos];
+        }
+        keys.swap(key_scratch);
+        order.swap(order_scratch);
+    }
+}
+
+/// Reorders `column[first, first + order.size())` so that position `pos` receives the
+/// element at `first + order[pos]`.
+template <typename T>
+void permute(std::vector<T>& column, std::size_t first, std::vector<std::uint32_t> const& order, std::vector<T>& scratch)
+{
+    scratch.resize(order.size());
+    for (std::size_t pos = 0; pos < order.size(); ++pos) {
+        scratch[pos] = column[first + order[pos]];
+    }
+    std::copy(scratch.begin(), scratch.end(), column.begin() + static_cast<std::ptrdiff_t>(first));
+}
+
+}  // namespace
+
+void RankingColumns::reserve(std::size_t size)
+{
+    m_docs.reserve(size);
+    m_scores.reserve(size);
+    m_ranks.reserve(size);
+    m_ids.reserve(size);
+}
+
+void RankingColumns::clear() noexcept
+{
+    m_docs.clear();
+    m_scores.clear();
+    m_ranks.clear();
+    m_ids.clear();
+}
+
+void RankingColumns::push_back(ScoredDoc const& doc)
+{
+    m_docs.push_back(doc.doc);
+    m_scores.push_back(doc.score);
+    m_ranks.push_back(doc.rank);
+    m_ids.push_back(doc.id);
+}
+
+void RankingColumns::sort(
+    std::size_t first, std::size_t count, RankingOrder order, SortBuffers& buffers, std::size_t depth)
+{
+    auto const* scores = m_scores.data() + first;
+    auto const* ranks = m_ranks.data() + first;
+    auto const* docs = m_docs.data() + first;
+    auto by_score = [&](std::uint32_t lhs, std::uint32_t rhs) {
+        if (scores[lhs] != scores[rhs]) {
+            return scores[lhs] > scores[rhs];
+        }
+        return docs[lhs] > docs[rhs];
+    };
+    // Equal ranks keep their file order, also through the unstable partial selection.
+    auto by_rank = [&](std::uint32_t lhs, std::uint32_t rhs) {
+        return ranks[lhs] != ranks[rhs] ? ranks[lhs] < ranks[rhs] : lhs < rhs;
+    };
+    depth = std::min(depth, count);
+
+    auto& positions = buffers.order;
+    positions.resize(count);
+    std::iota(positions.begin(), positions.end(), 0U);
+    auto in_order = [&](auto const& before) {
+        // The first `depth` documents are in order, and none of the others should
+        // precede the last of them.
+        auto top = positions.begin() + static_cast<std::ptrdiff_t>(depth);
+        return std::is_sorted(positions.begin(), top, before)
+            && (depth == 0 || depth == count
+                || std::none_of(top, positions.end(), [&](std::uint32_t pos) { return before(pos, *(top - 1)); }));
+    };
+    if (order == RankingOrder::score ? in_order(by_score) : in_order(by_rank)) {
+        return;
+    }
+    if (depth < count) {
+        auto top = positions.begin() + static_cast<std::ptrdiff_t>(depth);
+        if (order == RankingOrder::score) {
+            std::nth_element(positions.begin(), top, positions.end(), by_score);
+        } else {
+            std::nth_element(positions.begin(), top, positions.end(), by_rank);
+        }
+    }
+    std::span<std::uint32_t> top(positions.data(), depth);
+    if (depth < min_radix_size) {
+        if (order == RankingOrder::score) {
+            std::sort(top.begin(), top.end(), by_score);
+        } else {
+            std::sort(top.begin(), top.end(), by_rank);
+        }
+    } else {
+        auto& keys = buffers.keys;
+        keys.resize(depth);
+        for (std::size_t idx = 0; idx < depth; ++idx) {
+            keys[idx] = order == RankingOrder::score ? descending_key(scores[top[idx]]) : ascending_key(ranks[top[idx]]);
+        }
+        auto& sorted = buffers.sorted;
+        sorted.assign(top.begin(), top.end());
+        radix_sort(keys, sorted, buffers.key_scratch, buffers.order_scratch);
+        if (order == RankingOrder::score) {
+            // Tie pass: equal keys are equal scores, ordered by document ID descending.
+            for (std::size_t begin = 0; begin < depth;) {
+                auto end = begin + 1;
+                while (end < depth && keys[end] == keys[begin]) {
+                    ++end;
+                }
+                if (end - begin > 1) {
+                    std::sort(sorted.begin() + static_cast<std::ptrdiff_t>(begin),
+                              sorted.begin() + static_cast<std::ptrdiff_t>(end),
+                              [&](std::uint32_t lhs, std::uint32_t rhs) { return docs[lhs] > docs[rhs]; });
+                }
+                begin = end;
+            }
+        } else if (depth < count) {
+            // The selection scrambled the file order of equal ranks: restore it.
+            for (std::size_t begin = 0; begin < depth;) {
+                auto end = begin + 1;
+                while (end < depth && keys[end] == keys[begin]) {
+                    ++end;
+                }
+                std::sort(sorted.begin() + static_cast<std::ptrdiff_t>(begin),
+                          sorted.begin() + static_cast<std::ptrdiff_t>(end));
+                begin = end;
+            }
+        }
+        std::copy(sorted.begin(), sorted.end(), top.begin());
+    }
+    permute(m_docs, first, positions, buffers.docs);
+    permute(m_scores, first, positions, buffers.scores);
+    permute(m_ranks, first, positions, buffers.ranks);
+    permute(m_ids, first, positions, buffers.ids);
+}
+
+}  // namespace eval_metrics
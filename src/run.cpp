@@ -0,0 +1,258 @@
+#include "eval_metrics/run.hpp"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <optional>
+#include <string>
+
+#include "eval_metrics/binary_format.hpp"
+#include "eval_metrics/detail/json_run.hpp"
+#include "eval_metrics/detail/parallel.hpp"
+#include "eval_metrics/detail/run_line.hpp"
+#include "eval_metrics/detail/segmented_text.hpp"
+#include "eval_metrics/detail/tokenizer.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/input_stream.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+/// Chunks smaller than this are not worth handing to another thread.
+constexpr std::size_t min_chunk_size = std::size_t{1} << 20U;
+
+using detail::RunLine;
+
+/// Splits `text` into at most `count` chunks, each ending right after a newline
+/// (or at the end of the text).
+[[nodiscard]] auto chunk_boundaries(std::string_view text, std::size_t count)
+    -> std::vector<std::size_t>
+{
+    std::vector<std::size_t> bounds{0};
+    auto step = std::max(min_chunk_size, text.size() / std::max<std::size_t>(count, 1) + 1);
+    while (bounds.back() < text.size()) {
+        auto target = bounds.back() + step;
+        if (target >= text.size()) {
+            bounds.push_back(text.size());
+            break;
+        }
+        auto newline = text.find('\n', target);
+        bounds.push_back(newline == std::string_view::npos ? text.size() : newline + 1);
+    }
+    return bounds;
+}
+
+/// Text formats of a run, told apart by `detail::is_json_run`.
+enum class TextFormat { trec, json_lines };
+
+[[nodiscard]] auto text_format(std::string_view head) noexcept -> TextFormat
+{
+    return detail::is_json_run(head) ? TextFormat::json_lines : TextFormat::trec;
+}
+
+/// Parses the lines of `text[begin, end)`, appending them to `lines` with their
+/// documents resolved against `dictionary`, if any. `text` itself starts after
+/// `preceding_lines` lines of the input. Strings decoded from JSON escapes are kept
+/// in `arena`.
+void parse_chunk(
+    TextFormat format,
+    std::string_view text,
+    std::size_t begin,
+    std::size_t end,
+    std::size_t preceding_lines,
+    DocDictionary const* dictionary,
+    std::deque<std::string>& arena,
+    std::vector<RunLine>& lines)
+{
+    auto fail = [&](ParseError const& error, std::size_t line) {
+        auto preceding = std::count(text.begin(), text.begin() + begin, '\n');
+        throw ParseError(error.what(), preceding_lines + static_cast<std::size_t>(preceding) + line);
+    };
+    auto first = lines.size();
+    if (format == TextFormat::json_lines) {
+        auto chunk = text.substr(begin, end - begin);
+        std::size_t line = 0;
+        while (!chunk.empty()) {
+            ++line;
+            auto newline = chunk.find('\n');
+            auto length = newline == std::string_view::npos ? chunk.size() : newline + 1;
+            try {
+                static_cast<void>(detail::parse_json_ranking(chunk.substr(0, length), arena, lines));
+            } catch (ParseError const& error) {
+                fail(error, line);
+            }
+            chunk.remove_prefix(length);
+        }
+    } else {
+        detail::FieldTokenizer tokenizer(text.substr(begin, end - begin));
+        detail::RunFields fields;
+        std::size_t count = 0;
+        RunLine parsed;
+        while (tokenizer.next(fields, count)) {
+            try {
+                if (detail::parse_run_fields(fields, count, parsed)) {
+                    lines.push_back(parsed);
+                }
+            } catch (ParseError const& error) {
+                fail(error, tokenizer.line_number());
+            }
+        }
+    }
+    if (dictionary != nullptr) {
+        for (auto idx = first; idx < lines.size(); ++idx) {
+            lines[idx].doc.id = dictionary->lookup(lines[idx].doc.doc);
+        }
+    }
+}
+
+[[nodiscard]] auto query_less(RunLine const& lhs, RunLine const& rhs) noexcept -> bool
+{
+    return lhs.query < rhs.query;
+}
+
+/// A decompressed run and the strings decoded from its JSON escapes.
+struct SegmentedRun {
+    detail::SegmentedText text;
+    std::deque<std::string> arena;
+};
+
+/// Parses a compressed run as it is decompressed, one buffer at a time (see
+/// `detail::read_segments`).
+[[nodiscard]] auto parse_compressed(
+    InputStream& input, DocDictionary const* dictionary, std::vector<std::vector<RunLine>>& chunks)
+    -> std::shared_ptr<SegmentedRun const>
+{
+    auto run = std::make_shared<SegmentedRun>();
+    std::optional<TextFormat> format;
+    detail::read_segments(input, run->text, [&](std::string_view segment, std::size_t lines_before) {
+        if (!format) {
+            // The format shows at the first character that is not blank.
+            if (segment.find_first_not_of(" \t\r\n\v\f") == std::string_view::npos) {
+                return;
+            }
+            format = text_format(segment);
+        }
+        parse_chunk(*format, segment, 0, segment.size(), lines_before, dictionary, run->arena, chunks.emplace_back());
+    });
+    return run;
+}
+
+/// A mapped run text and the strings decoded from its JSON escapes, one arena per chunk.
+struct ParsedText {
+    std::shared_ptr<Buffer const> buffer;
+    std::vector<std::deque<std::string>> arenas;
+};
+
+}  // namespace
+
+Run::Run(
+    std::shared_ptr<Buffer const> buffer,
+    std::shared_ptr<DocDictionary const> dictionary,
+    std::string_view tag,
+    std::vector<std::string_view> query_ids,
+    std::vector<std::size_t> offsets,
+    RankingColumns rankings)
+    : m_storage(std::move(buffer)),
+      m_dictionary(std::move(dictionary)),
+      m_tag(tag),
+      m_query_ids(std::move(query_ids)),
+      m_offsets(std::move(offsets)),
+      m_rankings(std::move(rankings))
+{}
+
+auto Run::from_file(std::filesystem::path const& path, RunParseOptions options) -> Run
+{
+    auto buffer = Buffer::map_file(path);
+    if (detect_compression(buffer->view().substr(0, 4)) != Compression::none) {
+        buffer.reset();
+        InputStream input(path);
+        std::vector<std::vector<RunLine>> chunks;
+        auto text = parse_compressed(input, options.dictionary.get(), chunks);
+        return from_chunks(std::move(text), std::move(chunks), std::move(options));
+    }
+    if (is_binary_format(buffer->view())) {
+        auto run = read_binary_run(std::move(buffer), std::move(options.dictionary));
+        run.reorder(options.order, options.threads, options.depth);
+        return run;
+    }
+    return parse(std::move(buffer), options);
+}
+
+auto Run::parse(std::shared_ptr<Buffer const> buffer, RunParseOptions options) -> Run
+{
+    auto text = buffer->view();
+    auto format = text_format(text);
+    auto threads = detail::resolve_threads(options.threads);
+    auto bounds = chunk_boundaries(text, threads * 4);
+    auto parsed = std::make_shared<ParsedText>();
+    parsed->buffer = std::move(buffer);
+    parsed->arenas.resize(bounds.size() - 1);
+    std::vector<std::vector<RunLine>> chunks(bounds.size() - 1);
+    detail::parallel_for(chunks.size(), threads, [&](std::size_t chunk) {
+        parse_chunk(
+            format, text, bounds[chunk], bounds[chunk + 1], 0, options.dictionary.get(), parsed->arenas[chunk],
+            chunks[chunk]);
+    });
+    return from_chunks(std::move(parsed), std::move(chunks), std::move(options));
+}
+
+auto Run::from_chunks(
+    std::shared_ptr<void const> storage, std::vector<std::vector<detail::RunLine>> chunks, RunParseOptions options)
+    -> Run
+{
+    std::vector<RunLine> lines;
+    std::size_t total = 0;
+    for (auto const& chunk : chunks) {
+        total += chunk.size();
+    }
+    lines.reserve(total);
+    for (auto& chunk : chunks) {
+        lines.insert(lines.end(), chunk.begin(), chunk.end());
+        std::vector<RunLine>().swap(chunk);
+    }
+    Run run;
+    if (!lines.empty()) {
+        run.m_tag = lines.front().tag;
+    }
+    if (!std::is_sorted(lines.begin(), lines.end(), query_less)) {
+        std::stable_sort(lines.begin(), lines.end(), query_less);
+    }
+    run.m_storage = std::move(storage);
+    run.m_dictionary = std::move(options.dictionary);
+    run.m_rankings.reserve(lines.size());
+    for (std::size_t idx = 0; idx < lines.size(); ++idx) {
+        if (idx == 0 || lines[idx].query != lines[idx - 1].query) {
+            run.m_query_ids.push_back(lines[idx].query);
+            run.m_offsets.push_back(idx);
+        }
+        run.m_rankings.push_back(lines[idx].doc);
+    }
+    run.m_offsets.push_back(lines.size());
+    run.reorder(options.order, options.threads, options.depth);
+    return run;
+}
+
+void Run::reorder(RankingOrder order, std::size_t threads, std::size_t depth)
+{
+    threads = detail::resolve_threads(threads);
+    // Queries are sorted in blocks, each reusing one set of buffers.
+    auto blocks = std::min(num_queries(), threads * 4);
+    detail::parallel_for(blocks, threads, [&](std::size_t block) {
+        SortBuffers buffers;
+        for (auto query = block * num_queries() / blocks; query < (block + 1) * num_queries() / blocks; ++query) {
+            m_rankings.sort(m_offsets[query], m_offsets[query + 1] - m_offsets[query], order, buffers, depth);
+        }
+    });
+}
+
+auto Run::find_query(std::string_view query_id) const noexcept -> std::optional<std::size_t>
+{
+    auto pos = std::lower_bound(m_query_ids.begin(), m_query_ids.end(), query_id);
+    if (pos == m_query_ids.end() || *pos != query_id) {
+        return std::nullopt;
+    }
+    return static_cast<std::size_t>(std::distance(m_query_ids.begin(), pos));
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,187 @@
+#include "eval_metrics/run_stream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "eval_metrics/detail/json_run.hpp"
+#include "eval_metrics/detail/run_line.hpp"
+#include "eval_metrics/detail/tokenizer.hpp"
+#include "eval_metrics/error.hpp"
+
+namespace eval_metrics {
+
+namespace {
+
+constexpr std::size_t initial_window_size = std::size_t{1} << 20U;
+
+}  // namespace
+
+RunStream::RunStream(std::filesystem::path const& path, RunParseOptions options)
+    : m_input(path),
+      m_dictionary(std::move(options.dictionary)),
+      m_order(options.order),
+      m_depth(options.depth),
+      m_window(initial_window_size)
+{}
+
+void RunStream::refill(std::size_t block_begin)
+{
+    auto kept = m_end - block_begin;
+    if (block_begin > 0) {
+        std::memmove(m_window.data(), m_window.data() + block_begin, kept);
+    }
+    m_end = kept;
+    if (m_end == m_window.size()) {
+        m_window.resize(m_window.size() * 2);
+    }
+    auto bytes = m_input.read(m_window.data() + m_end, m_window.size() - m_end);
+    if (bytes == 0) {
+        m_eof = true;
+    }
+    m_end += bytes;
+}
+
+auto RunStream::next() -> bool
+{
+    if (!m_format_known) {
+        if (m_end == 0 && !m_eof) {
+            refill(0);
+        }
+        m_json = detail::is_json_run(std::string_view(m_window.data(), m_end));
+        m_format_known = true;
+    }
+    return m_json ? next_json() : next_trec();
+}
+
+auto RunStream::next_trec() -> bool
+{
+    auto block_begin = m_pos;
+    auto block_line = m_line_number;
+    std::size_t query_line = 0;
+    bool block_ended = false;
+    m_docs.clear();
+    detail::RunFields fields;
+    std::size_t count = 0;
+    detail::RunLine parsed;
+    while (!block_ended) {
+        // Only complete lines are tokenized until the end of the file.
+        auto available = m_end;
+        if (!m_eof) {
+            auto const* last = static_cast<char const*>(
+                ::memrchr(m_window.data() + m_pos, '\n', m_end - m_pos));
+            if (last == nullptr) {
+                // The views parsed so far point into the window, which is about to
+                // move: restart the block once more input is available.
+                refill(block_begin);
+                block_begin = 0;
+                m_pos = 0;
+                m_line_number = block_line;
+                m_docs.clear();
+                continue;
+            }
+            available = static_cast<std::size_t>(last - m_window.data()) + 1;
+        }
+        auto base = m_pos;
+        detail::FieldTokenizer tokenizer(
+            std::string_view(m_window.data() + base, available - base), m_line_number + 1);
+        while (tokenizer.next(fields, count)) {
+            bool is_entry = false;
+            try {
+                is_entry = detail::parse_run_fields(fields, count, parsed);
+            } catch (ParseError const& error) {
+                throw ParseError(error.what(), tokenizer.line_number());
+            }
+            if (is_entry) {
+                if (m_docs.empty()) {
+                    m_query_id = parsed.query;
+                    query_line = tokenizer.line_number();
+                    if (m_tag.empty()) {
+                        m_tag = parsed.tag;
+                    }
+                } else if (parsed.query != m_query_id) {
+                    block_ended = true;
+                    break;
+                }
+                if (m_dictionary) {
+                    parsed.doc.id = m_dictionary->lookup(parsed.doc.doc);
+                }
+                m_docs.push_back(parsed.doc);
+            }
+            m_pos = base + tokenizer.position();
+            m_line_number = tokenizer.line_number();
+        }
+        if (m_eof && m_pos == m_end) {
+            block_ended = true;
+        }
+    }
+    return finish_block(query_line);
+}
+
+auto RunStream::next_json() -> bool
+{
+    auto block_begin = m_pos;
+    auto block_line = m_line_number;
+    std::size_t query_line = 0;
+    m_docs.clear();
+    m_arena.clear();
+    while (m_pos < m_end || !m_eof) {
+        auto const* newline = static_cast<char const*>(std::memchr(m_window.data() + m_pos, '\n', m_end - m_pos));
+        if (newline == nullptr && !m_eof) {
+            // As in `next_trec`: the window is about to move, so restart the block.
+            refill(block_begin);
+            block_begin = 0;
+            m_pos = 0;
+            m_line_number = block_line;
+            m_docs.clear();
+            m_arena.clear();
+            continue;
+        }
+        auto line_end = newline == nullptr ? m_end : static_cast<std::size_t>(newline - m_window.data()) + 1;
+        m_json_lines.clear();
+        try {
+            static_cast<void>(detail::parse_json_ranking(
+                std::string_view(m_window.data() + m_pos, line_end - m_pos), m_arena, m_json_lines));
+        } catch (ParseError const& error) {
+            throw ParseError(error.what(), m_line_number + 1);
+        }
+        if (!m_json_lines.empty()) {
+            auto query = m_json_lines.front().query;
+            if (m_docs.empty()) {
+                m_query_id = query;
+                query_line = m_line_number + 1;
+                if (m_tag.empty()) {
+                    m_tag = m_json_lines.front().tag;
+                }
+            } else if (query != m_query_id) {
+                break;
+            }
+            for (auto& line : m_json_lines) {
+                if (m_dictionary) {
+                    line.doc.id = m_dictionary->lookup(line.doc.doc);
+                }
+                m_docs.push_back(line.doc);
+            }
+        }
+        m_pos = line_end;
+        ++m_line_number;
+    }
+    return finish_block(query_line);
+}
+
+auto RunStream::finish_block(std::size_t query_line) -> bool
+{
+    if (m_docs.empty()) {
+        m_query_id = {};
+        return false;
+    }
+    if (!m_seen.emplace(m_query_id).second) {
+        throw UngroupedRunError(
+            "query " + std::string(m_query_id)
+                + " appears in more than one block; the run is not grouped by query",
+            query_line);
+    }
+    m_docs.sort(0, m_docs.size(), m_order, m_sort_buffers, m_depth);
+    return true;
+}
+
+}  // namespace eval_metrics
@@ -0,0 +1,128 @@
+#include "eval_metrics/detail/simd_scan.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EVAL_METRICS_X86 1
+#include <immintrin.h>
+#endif
+
+#include "eval_metrics/detail/text.hpp"
+
+namespace eval_metrics::detail {
+
+namespace {
+
+auto scan_scalar(char const* block) noexcept -> BlockMasks
+{
+    BlockMasks masks{0, 0};
+    for (unsigned idx = 0; idx < 64; ++idx) {
+        auto bit = std::uint64_t{1} << idx;
+        if (block[idx] == '\n') {
+            masks.newlines |= bit;
+        } else if (is_blank(block[idx])) {
+            masks.blanks |= bit;
+        }
+    }
+    return masks;
+}
+
+#ifdef EVAL_METRICS_X86
+
+/// Uses the SSE4.2 string instruction to match any of the blank characters.
+__attribute__((target("sse4.2"))) auto scan_sse42(char const* block) noexcept -> BlockMasks
+{
+    auto const blank_set = _mm_setr_epi8(' ', '\t', '\r', '\v', '\f', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    auto const newline = _mm_set1_epi8('\n');
+    constexpr int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK;
+    BlockMasks masks{0, 0};
+    for (unsigned part = 0; part < 4; ++part) {
+        auto bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(block + 16 * part));
+        auto blanks = _mm_cvtsi128_si32(_mm_cmpestrm(blank_set, 5, bytes, 16, mode));
+        auto newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+        masks.blanks |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(blanks)) << (16 * part);
+        masks.newlines |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(newlines)) << (16 * part);
+    }
+    return masks;
+}
+
+/// Blanks are the space and the control characters `\t` to `\r`, except `\n`.
+__attribute__((target("avx2"))) auto scan_avx2(char const* block) noexcept -> BlockMasks
+{
+    auto const space = _mm256_set1_epi8(' ');
+    auto const newline = _mm256_set1_epi8('\n');
+    auto const tab = _mm256_set1_epi8('\t');
+    auto const span = _mm256_set1_epi8('\r' - '\t');
+    BlockMasks masks{0, 0};
+    for (unsigned part = 0; part < 2; ++part) {
+        auto bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(block + 32 * part));
+        auto offset = _mm256_sub_epi8(bytes, tab);
+        auto control = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, span), offset);
+        auto newlines = _mm256_cmpeq_epi8(bytes, newline);
+        auto blanks = _mm256_or_si256(
+            _mm256_cmpeq_epi8(bytes, space), _mm256_andnot_si256(newlines, control));
+        masks.blanks |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(blanks)))
+            << (32 * part);
+        masks.newlines |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(newlines)))
+            << (32 * part);
+    }
+    return masks;
+}
+
+#endif
+
+[[nodiscard]] auto detect() noexcept -> Isa
+{
+    auto best = Isa::scalar;
+#ifdef EVAL_METRICS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        best = Isa::avx2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        best = Isa::sse42;
+    }
+#endif
+    if (char const* requested = std::getenv("EVAL_METRICS_ISA"); requested != nullptr) {
+        if (std::strcmp(requested, "scalar") == 0) {
+            best = Isa::scalar;
+        } else if (std::strcmp(requested, "sse42") == 0 && best == Isa::avx2) {
+            best = Isa::sse42;
+        }
+    }
+    return best;
+}
+
+}  // namespace
+
+auto isa_name(Isa isa) noexcept -> std::string_view
+{
+    switch (isa) {
+    case Isa::avx2: return "avx2";
+    case Isa::sse42: return "sse42";
+    case Isa::scalar: break;
+    }
+    return "scalar";
+}
+
+auto detected_isa() noexcept -> Isa
+{
+    static Isa const isa = detect();
+    return isa;
+}
+
+auto block_scanner(Isa isa) noexcept -> BlockScanner
+{
+#ifdef EVAL_METRICS_X86
+    switch (isa) {
+    case Isa::avx2: return scan_avx2;
+    case Isa::sse42: return scan_sse42;
+    case Isa::scalar: break;
+    }
+#else
+    (void)isa;
+#endif
+    return scan_scalar;
+}
+
+}  // namespace eval_metrics::detail
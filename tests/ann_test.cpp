@@ -0,0 +1,310 @@
+// Checks the intersection kernel of the nearest-neighbor recall against a set-based
+// count, on blocks of true neighbors of every length up to 40 (most not a multiple of
+// the eight AVX2 lanes), with repeated results and with ID 0 among the results while
+// the masked lanes of the last block read as 0; `AnnMeasure::parse` and the names it
+// round-trips to; the `vecs` and `bin` readers, including truncated and inconsistent
+// files; and `AnnEvaluator` on two queries worked out by hand.
+//
+// Runs with the instruction set named by its argument, which CTest selects through
+// `EVAL_METRICS_ISA` (`scalar`, or `avx2` to keep the detected one); exits with 77, a
+// skip, if the CPU cannot provide it. Writes the files read by name to a fresh
+// directory under the system's temporary directory and removes it at the end.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#include "check.hpp"
+#include "eval_metrics/ann.hpp"
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/detail/intersection.hpp"
+#include "eval_metrics/error.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+namespace fs = std::filesystem;
+using em::test::check;
+
+constexpr int skipped = 77;
+
+[[nodiscard]] auto describe(std::vector<std::int32_t> const& ids) -> std::string
+{
+    std::string text;
+    for (auto id : ids) {
+        text += (text.empty() ? "" : " ") + std::to_string(id);
+    }
+    return "[" + text + "]";
+}
+
+void check_count(em::detail::IntersectionKernel kernel, std::vector<std::int32_t> const& truth,
+                 std::vector<std::int32_t> const& found)
+{
+    std::set<std::int32_t> results(found.begin(), found.end());
+    std::size_t expected = 0;
+    for (auto id : truth) {
+        expected += results.count(id);
+    }
+    // Exactly as long as the block, so that nothing past it could be read unnoticed by
+    // a sanitizer.
+    std::vector<std::int32_t> exact(truth);
+    exact.shrink_to_fit();
+    auto common = kernel(exact, found);
+    check(common == expected, "truth " + describe(truth) + " and results " + describe(found) + ": "
+                                  + std::to_string(common) + " in common, expected " + std::to_string(expected));
+}
+
+void check_kernel(em::detail::IntersectionKernel kernel, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<std::int32_t> small_id(0, 20);
+    std::uniform_int_distribution<std::int32_t> nonzero_id(1, 60);
+    std::uniform_int_distribution<std::size_t> found_size(0, 50);
+    for (std::size_t size = 0; size <= 40; ++size) {
+        for (int round = 0; round < 20; ++round) {
+            // Few distinct IDs: results repeat, and so do some true neighbors.
+            std::vector<std::int32_t> truth(size);
+            std::vector<std::int32_t> found(found_size(rng));
+            for (auto& id : truth) {
+                id = small_id(rng);
+            }
+            for (auto& id : found) {
+                id = small_id(rng);
+            }
+            check_count(kernel, truth, found);
+
+            // No true neighbor is 0, but the results list 0, repeatedly: the masked lanes
+            // of the last block must not match it.
+            for (auto& id : truth) {
+                id = nonzero_id(rng);
+            }
+            found.insert(found.begin() + static_cast<std::ptrdiff_t>(found.size() / 2), {0, 0});
+            check_count(kernel, truth, found);
+            found.assign(truth.begin(), truth.end());
+            found.push_back(0);
+            check_count(kernel, truth, found);
+        }
+    }
+    check_count(kernel, {-1, 2147483647, -2147483647 - 1}, {-2147483647 - 1, -1, 0});
+}
+
+void check_measures()
+{
+    struct Expected {
+        std::string_view spec;
+        em::AnnMeasure::Kind kind;
+        std::size_t k;
+        std::size_t depth;
+        std::string_view name;
+    };
+    using Kind = em::AnnMeasure::Kind;
+    for (auto const& expected : {
+             Expected{"recall@10", Kind::recall, 10, 10, "recall@10"},
+             Expected{"10-recall@100", Kind::recall, 10, 100, "10-recall@100"},
+             Expected{"1-recall@1", Kind::recall, 1, 1, "recall@1"},
+             Expected{"ratio@5", Kind::distance_ratio, 5, 5, "ratio@5"},
+         }) {
+        auto what = "measure " + std::string(expected.spec);
+        try {
+            auto measure = em::AnnMeasure::parse(expected.spec);
+            check(measure.kind == expected.kind && measure.k == expected.k && measure.depth == expected.depth,
+                  what + ": parsed as " + measure.name());
+            check(measure.name() == expected.name, what + ": named " + measure.name());
+        } catch (em::Error const& error) {
+            check(false, what + ": " + error.what());
+        }
+    }
+    for (std::string_view spec : {"", "recall", "recall@", "recall@0", "recall@x", "recall@10x", "recall@-1",
+                                  "@10", "0-recall@10", "-recall@10", "x-recall@10", "10-ratio@10", "precision@10",
+                                  "Recall@10"}) {
+        try {
+            static_cast<void>(em::AnnMeasure::parse(spec));
+            check(false, "accepted measure \"" + std::string(spec) + "\"");
+        } catch (em::Error const&) {
+        }
+    }
+}
+
+template <typename T>
+void append(std::string& bytes, T value)
+{
+    char raw[sizeof(T)];
+    std::memcpy(raw, &value, sizeof(T));
+    bytes.append(raw, sizeof(T));
+}
+
+template <typename T>
+[[nodiscard]] auto vecs(std::vector<std::vector<T>> const& rows) -> std::string
+{
+    std::string bytes;
+    for (auto const& row : rows) {
+        append(bytes, static_cast<std::int32_t>(row.size()));
+        for (auto value : row) {
+            append(bytes, value);
+        }
+    }
+    return bytes;
+}
+
+template <typename T>
+[[nodiscard]] auto bin(std::vector<std::vector<T>> const& rows) -> std::string
+{
+    std::string bytes;
+    append(bytes, static_cast<std::uint32_t>(rows.size()));
+    append(bytes, static_cast<std::uint32_t>(rows.empty() ? 0 : rows.front().size()));
+    for (auto const& row : rows) {
+        for (auto value : row) {
+            append(bytes, value);
+        }
+    }
+    return bytes;
+}
+
+template <typename T>
+void check_matrix(em::VectorMatrix<T> const& matrix, std::vector<std::vector<T>> const& rows, std::string const& what)
+{
+    check(matrix.rows() == rows.size(), what + ": " + std::to_string(matrix.rows()) + " rows");
+    check(matrix.dim() == (rows.empty() ? 0 : rows.front().size()),
+          what + ": dimension " + std::to_string(matrix.dim()));
+    if (matrix.rows() != rows.size() || rows.empty() || matrix.dim() != rows.front().size()) {
+        return;
+    }
+    for (std::size_t row = 0; row < rows.size(); ++row) {
+        auto actual = matrix.row(row);
+        check(std::vector<T>(actual.begin(), actual.end()) == rows[row], what + ": row " + std::to_string(row));
+    }
+}
+
+void check_rejected_matrix(std::string bytes, em::VectorFormat format, std::string const& what)
+{
+    try {
+        static_cast<void>(em::NeighborMatrix::parse(em::Buffer::from_string(std::move(bytes)), format));
+        check(false, what + ": accepted");
+    } catch (em::ParseError const&) {
+    }
+}
+
+void check_readers(fs::path const& dir)
+{
+    std::vector<std::vector<std::int32_t>> ids{{3, 1, 4, 1, 5}, {9, 2, 6, 5, 3}, {0, -1, 7, 8, 2147483647}};
+    std::vector<std::vector<float>> distances{{0.5f, 1.0f, 1.5f}, {0.0f, 0.25f, 1e30f}};
+    check_matrix(em::NeighborMatrix::parse(em::Buffer::from_string(vecs(ids)), em::VectorFormat::vecs), ids, "ivecs");
+    check_matrix(em::NeighborMatrix::parse(em::Buffer::from_string(bin(ids)), em::VectorFormat::bin), ids, "ibin");
+    check_matrix(em::DistanceMatrix::parse(em::Buffer::from_string(vecs(distances)), em::VectorFormat::vecs),
+                 distances, "fvecs");
+    check_matrix(em::DistanceMatrix::parse(em::Buffer::from_string(bin(distances)), em::VectorFormat::bin), distances,
+                 "fbin");
+    check_matrix(em::NeighborMatrix::parse(em::Buffer::from_string(""), em::VectorFormat::vecs), {}, "empty ivecs");
+    check_matrix(em::NeighborMatrix::parse(em::Buffer::from_string(bin<std::int32_t>({})), em::VectorFormat::bin), {},
+                 "empty ibin");
+
+    // The format follows the extension.
+    for (auto const& [name, bytes] : {std::pair{"truth.ivecs", vecs(ids)}, std::pair{"truth.ibin", bin(ids)}}) {
+        std::ofstream(dir / name, std::ios::binary) << bytes;
+        check_matrix(em::NeighborMatrix::from_file(dir / name), ids, name);
+    }
+
+    auto vecs_bytes = vecs(ids);
+    auto bin_bytes = bin(ids);
+    for (std::size_t size : {std::size_t{1}, std::size_t{3}, std::size_t{4}, std::size_t{23}, vecs_bytes.size() - 1}) {
+        check_rejected_matrix(vecs_bytes.substr(0, size), em::VectorFormat::vecs,
+                              "ivecs truncated to " + std::to_string(size) + " bytes");
+    }
+    for (std::size_t size : {std::size_t{0}, std::size_t{4}, std::size_t{7}, std::size_t{8}, bin_bytes.size() - 1}) {
+        check_rejected_matrix(bin_bytes.substr(0, size), em::VectorFormat::bin,
+                              "ibin truncated to " + std::to_string(size) + " bytes");
+    }
+    check_rejected_matrix(
+        vecs<std::int32_t>({{1, 2, 3}, {4, 5, 6, 7}}), em::VectorFormat::vecs, "ivecs rows of different dimensions");
+    // A row of 2 and one of 5 take as many bytes as three rows of 2.
+    check_rejected_matrix(vecs<std::int32_t>({{1, 2}, {3, 4, 5, 6, 7}}), em::VectorFormat::vecs,
+                          "ivecs rows of different dimensions, whole rows in size");
+}
+
+/// Two queries with ten true neighbors each: the first finds 1, 2, 3 in its first ten
+/// results (1 twice, and 0, which is not a neighbor) and 9, 10 after them; the second
+/// finds all of its neighbors, 0 among them, in order.
+void check_evaluator()
+{
+    auto truth = em::NeighborMatrix::parse(
+        em::Buffer::from_string(bin<std::int32_t>({{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}})),
+        em::VectorFormat::bin);
+    auto results = em::NeighborMatrix::parse(
+        em::Buffer::from_string(bin<std::int32_t>(
+            {{1, 1, 0, 2, 11, 12, 3, 13, 14, 15, 9, 10}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}})),
+        em::VectorFormat::bin);
+    auto truth_distances = em::DistanceMatrix::parse(
+        em::Buffer::from_string(bin<float>({{1, 2, 3, 4}, {0, 0, 0, 0}})), em::VectorFormat::bin);
+    std::vector<float> far(12, 9.0f);
+    std::vector<float> near(12, 0.0f);
+    far[0] = 2.0f;
+    far[1] = 2.0f;
+    far[2] = 5.0f;
+    auto result_distances =
+        em::DistanceMatrix::parse(em::Buffer::from_string(bin<float>({far, near})), em::VectorFormat::bin);
+
+    em::AnnOptions options;
+    options.measures = {"recall@5", "recall@10", "10-recall@12", "ratio@3"};
+    options.threads = 2;
+    em::AnnEvaluator evaluator(truth, options, &truth_distances);
+    check(evaluator.required_depth() == 12, "required depth");
+    std::vector<double> per_query;
+    auto summary = evaluator.evaluate(results, &result_distances, &per_query);
+    // ratio@3: (2 + 2 + 5) / (1 + 2 + 3) for the first, 0 / 0 for the second.
+    std::vector<double> expected{0.4, 0.3, 0.5, 1.5, 1.0, 1.0, 1.0, 1.0};
+    check(per_query.size() == expected.size(), "per-query values");
+    for (std::size_t idx = 0; idx < std::min(per_query.size(), expected.size()); ++idx) {
+        em::test::check_identical(per_query[idx], expected[idx],
+                                  "query " + std::to_string(idx / 4) + " " + evaluator.metrics()[idx % 4].name);
+    }
+    std::vector<double> means{(0.4 + 1.0) / 2, (0.3 + 1.0) / 2, (0.5 + 1.0) / 2, (1.5 + 1.0) / 2};
+    for (std::size_t idx = 0; idx < std::min(summary.size(), means.size()); ++idx) {
+        em::test::check_identical(summary[idx], means[idx], "mean " + evaluator.metrics()[idx].name);
+    }
+
+    try {
+        em::AnnEvaluator deep(truth, {.measures = {"recall@11"}});
+        check(false, "accepted a measure deeper than the ground truth");
+    } catch (em::Error const&) {
+    }
+    try {
+        em::AnnEvaluator ratio(truth, {.measures = {"ratio@3"}});
+        check(false, "accepted a distance ratio without distances");
+    } catch (em::Error const&) {
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string_view requested = argc > 1 ? argv[1] : "";
+    auto isa = em::detail::detected_isa();
+    if (requested == "avx2" && isa != em::detail::Isa::avx2) {
+        std::printf("AVX2 is not available, skipping\n");
+        return skipped;
+    }
+    check(requested.empty() || em::detail::isa_name(isa) == requested,
+          "running with " + std::string(em::detail::isa_name(isa)) + " instead of " + std::string(requested));
+
+    auto dir = fs::temp_directory_path() / ("eval_metrics_ann_test_" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::mt19937_64 rng(25);
+    check_kernel(em::detail::intersection_kernel(isa), rng);
+    check_measures();
+    check_readers(dir);
+    check_evaluator();
+
+    fs::remove_all(dir);
+    return em::test::exit_status();
+}
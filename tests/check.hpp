@@ -0,0 +1,44 @@
+#pragma once
+
+// Minimal assertions for the test executables, which run under CTest: a failed check
+// prints its location and what differed, and the test keeps going so that one run
+// reports every failure; `exit_status` then fails the test.
+
+#include <cstdio>
+#include <cstdlib>
+#include <source_location>
+#include <string>
+
+namespace eval_metrics::test {
+
+inline int failures = 0;
+
+inline void check(bool condition, std::string const& what, std::source_location where = std::source_location::current())
+{
+    if (!condition) {
+        ++failures;
+        std::fprintf(stderr, "%s:%u: check failed: %s\n", where.file_name(), where.line(), what.c_str());
+    }
+}
+
+/// Checks that `actual` equals `expected` bit for bit, as the fused and reference
+/// computations promise.
+inline void check_identical(
+    double actual, double expected, std::string const& what,
+    std::source_location where = std::source_location::current())
+{
+    char values[96];
+    std::snprintf(values, sizeof(values), " (%.17g, expected %.17g)", actual, expected);
+    check(actual == expected, what + values, where);
+}
+
+[[nodiscard]] inline auto exit_status() -> int
+{
+    if (failures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+}  // namespace eval_metrics::test
@@ -0,0 +1,168 @@
+// Checks that `vector_dcg`, `vector_dcg_at` and `vector_ndcg` stay within their
+// documented tolerance of `scalar_dcg`, for linear and exponential gain, at depths
+// around the vector width and around the end of the discount table, and that the
+// `ndcg_exp` measures of an `EvaluationPlan` give the values computed by hand.
+//
+// Runs with the instruction set named by its argument, which CTest selects through
+// `EVAL_METRICS_ISA` (`scalar`, or `avx2` to keep the detected one); exits with 77, a
+// skip, if the CPU cannot provide it.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "check.hpp"
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/dcg.hpp"
+#include "eval_metrics/detail/simd_scan.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/metrics.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+using em::test::check;
+
+constexpr int skipped = 77;
+
+/// Cutoffs of `vector_dcg_at`, several of them not multiples of the four lanes.
+constexpr std::array<std::size_t, 10> cutoffs{1, 3, 5, 10, 13, 20, 100, 999, 1000, 1500};
+
+/// Checks `actual` against the scalar `expected` DCG of `n` ranks, or, with `ratio`, an
+/// nDCG whose DCGs are of `n` ranks.
+void check_within_tolerance(
+    double actual, double expected, std::size_t n, std::string const& what, bool ratio = false)
+{
+    // vector_dcg documents its bound: every term is exact and non-negative, and only
+    // the order of the additions differs, so the error is within a relative
+    // 2 * n * epsilon of the ordered sum; that of a ratio of two such sums, within
+    // twice that.
+    auto tolerance = (ratio ? 4.0 : 2.0) * static_cast<double>(n) * std::numeric_limits<double>::epsilon() * expected;
+    if (std::isinf(expected)) {
+        check(actual == expected, what + ": expected infinity");
+        return;
+    }
+    if (std::isnan(expected)) {
+        // An infinite DCG over an infinite ideal DCG.
+        check(std::isnan(actual), what + ": expected NaN");
+        return;
+    }
+    char values[96];
+    std::snprintf(values, sizeof(values), " (%.17g, expected %.17g)", actual, expected);
+    check(std::abs(actual - expected) <= tolerance, what + values);
+}
+
+void check_column(std::vector<std::int32_t> const& grades, em::DiscountTable const& discounts, std::string const& name)
+{
+    for (auto gain : {em::Gain::linear, em::Gain::exponential}) {
+        auto label = name + (gain == em::Gain::linear ? " linear" : " exponential") + " table "
+            + std::to_string(discounts.depth());
+        auto n = grades.size();
+        check_within_tolerance(
+            em::vector_dcg(grades, discounts, gain), em::scalar_dcg(grades, discounts, gain), n, label + " dcg");
+        for (std::size_t k = 0; k <= n + 2; ++k) {
+            check_within_tolerance(
+                em::vector_dcg(grades, discounts, gain, k), em::scalar_dcg(grades, discounts, gain, k),
+                std::min(k, n), label + " dcg@" + std::to_string(k));
+        }
+        std::array<double, cutoffs.size()> dcg_at{};
+        em::vector_dcg_at(grades, discounts, gain, cutoffs, dcg_at);
+        for (std::size_t cutoff = 0; cutoff < cutoffs.size(); ++cutoff) {
+            auto k = cutoffs[cutoff];
+            check_within_tolerance(
+                dcg_at[cutoff], em::scalar_dcg(grades, discounts, gain, k), std::min(k, n),
+                label + " dcg_at@" + std::to_string(k));
+        }
+        // The ideal ranking: the positive grades, sorted, and some relevant documents
+        // that were not retrieved.
+        std::vector<std::int32_t> ideal;
+        std::copy_if(grades.begin(), grades.end(), std::back_inserter(ideal), [](auto grade) { return grade > 0; });
+        ideal.insert(ideal.end(), {2, 1, 1});
+        std::sort(ideal.begin(), ideal.end(), std::greater<>());
+        for (auto k : {std::size_t{1}, std::size_t{5}, std::size_t{10}, n, em::no_cutoff}) {
+            auto ideal_dcg = em::scalar_dcg(ideal, discounts, gain, k);
+            auto expected = ideal_dcg == 0.0 ? 0.0 : em::scalar_dcg(grades, discounts, gain, k) / ideal_dcg;
+            check_within_tolerance(
+                em::vector_ndcg(grades, ideal, discounts, gain, k), expected, std::min(k, ideal.size()),
+                label + " ndcg@" + (k == em::no_cutoff ? std::string("all") : std::to_string(k)), true);
+        }
+    }
+}
+
+/// Evaluates `ndcg_exp` and `ndcg_exp_cut` with the plan, against DCGs worked out by hand.
+void check_plan()
+{
+    auto qrels = em::Qrels::parse(em::Buffer::from_string(
+        "q1 0 a 3\nq1 0 b 1\nq1 0 c 2\nq1 0 d 0\n"
+        "q2 0 a 0\n"));
+    em::EvaluationOptions options;
+    options.measures = {"ndcg_exp", "ndcg_exp_cut.1,2,5", "ndcg"};
+    em::Evaluator evaluator(qrels, options);
+    // q1 ranks grades 3, 0, 1 and an unjudged document; its ideal ranking is 3, 2, 1.
+    auto run = em::Run::parse(
+        em::Buffer::from_string("q1 Q0 a 1 4 t\nq1 Q0 d 2 3 t\nq1 Q0 b 3 2 t\nq1 Q0 x 4 1 t\nq2 Q0 a 1 1 t\n"),
+        {.dictionary = qrels.dictionary()});
+    auto results = evaluator.evaluate(run);
+    // Gains 2^g - 1: 7, 0, 1 at discounts log2(2), log2(3), log2(4).
+    auto dcg = 7.0 + 1.0 / 2.0;
+    auto ideal_at_1 = 7.0;
+    auto ideal_at_2 = 7.0 + 3.0 / std::log2(3.0);
+    auto ideal = ideal_at_2 + 1.0 / 2.0;
+    // Linear gain, for comparison: 3, 0, 1 against 3, 2, 1.
+    auto linear = (3.0 + 1.0 / 2.0) / (3.0 + 2.0 / std::log2(3.0) + 1.0 / 2.0);
+    std::array<double, 5> expected{dcg / ideal, 7.0 / ideal_at_1, 7.0 / ideal_at_2, dcg / ideal, linear};
+    check(results.num_queries() == 2, "plan: query count");
+    for (std::size_t idx = 0; idx < expected.size(); ++idx) {
+        check_within_tolerance(
+            results.values(0)[idx], expected[idx], 3, "plan q1 " + results.metrics()[idx].name, true);
+        em::test::check_identical(results.values(1)[idx], 0.0, "plan q2 " + results.metrics()[idx].name);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string_view requested = argc > 1 ? argv[1] : "";
+    auto isa = em::detail::detected_isa();
+    if (requested == "avx2" && isa != em::detail::Isa::avx2) {
+        std::printf("AVX2 is not available, skipping\n");
+        return skipped;
+    }
+    check(requested.empty() || em::detail::isa_name(isa) == requested,
+          "running with " + std::string(em::detail::isa_name(isa)) + " instead of " + std::string(requested));
+
+    std::vector<em::DiscountTable> tables;
+    tables.emplace_back();
+    // Tables ending off the vector width and empty, so the kernel stops early or never runs.
+    tables.emplace_back(13);
+    tables.emplace_back(0);
+
+    std::mt19937_64 rng(19);
+    std::uniform_int_distribution<int> grade(-1, 5);
+    for (std::size_t depth : {0, 1, 2, 3, 4, 5, 7, 8, 9, 12, 15, 16, 17, 31, 33, 999, 1000, 1001, 1003, 2050}) {
+        std::vector<std::int32_t> grades;
+        for (std::size_t rank = 0; rank < depth; ++rank) {
+            auto value = grade(rng);
+            grades.push_back(value == 5 ? em::unjudged : value);
+        }
+        for (auto const& table : tables) {
+            check_column(grades, table, "depth " + std::to_string(depth));
+        }
+    }
+    // Exponential gains from the largest finite power to infinity.
+    std::vector<std::int32_t> large{1, 1022, 0, 1023, 3, 2, 0, 1, 7};
+    check_column(large, tables.front(), "large grades");
+    large.push_back(1024);
+    check_column(large, tables.front(), "infinite gain");
+    check_plan();
+    return em::test::exit_status();
+}
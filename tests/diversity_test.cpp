@@ -0,0 +1,278 @@
+// Checks `DiversityEvaluator` against the definitions of `ndeval`: on a ranking worked
+// out by hand, with a document relevant to two intents, a tie in the greedy ideal
+// ranking, judged but non-relevant and unjudged documents, and cutoffs past the end of
+// the ranking; then on random judgments and rankings, against a reference that follows
+// the definitions intent by intent and rebuilds the greedy ideal ranking from scratch at
+// each rank.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/diversity.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+using em::test::check;
+
+void check_close(double actual, double expected, std::string const& what)
+{
+    char values[64];
+    std::snprintf(values, sizeof(values), " = %.17g, expected %.17g", actual, expected);
+    check(std::abs(actual - expected) <= 1e-12 * std::max(1.0, std::abs(expected)), what + values);
+}
+
+void check_values(em::Results const& results, std::size_t query, std::vector<double> const& expected,
+                  std::string const& what)
+{
+    auto values = results.values(query);
+    check(values.size() == expected.size(), what + ": metric count");
+    for (std::size_t idx = 0; idx < std::min(values.size(), expected.size()); ++idx) {
+        check_close(values[idx], expected[idx], what + " " + results.metrics()[idx].name);
+    }
+}
+
+/// q1 has intents 1 to 3 relevant and intent 4 judged non-relevant only: a is relevant
+/// to intents 1 and 2, b to 1, c to 3, d to 2, e to none. Its run ranks b, a, e, the
+/// unjudged x, and c. q2 has no relevant document; q3 is missing from the run.
+void check_hand_case()
+{
+    auto qrels = em::IntentQrels::parse(em::Buffer::from_string(
+        "q1 1 a 1\nq1 2 a 2\nq1 3 a 0\nq1 1 b 1\nq1 3 c 1\nq1 2 d 1\nq1 1 e 0\nq1 4 e 0\n"
+        "q2 1 a 0\n"
+        "q3 1 a 1\n"));
+    em::DiversityOptions options;
+    options.cutoffs = {10, 5, 2, 1};
+    options.complete = true;
+    em::DiversityEvaluator evaluator(qrels, options);
+    check(evaluator.num_intents(0) == 3, "hand case: q1 intents");
+    check(evaluator.num_intents(1) == 0, "hand case: q2 intents");
+
+    // The ideal ranking takes a (gain 2), then c (1), then b and d (0.5 each) tie: b
+    // comes first, and either order gives the same alpha-DCG.
+    auto log2 = [](double x) { return std::log2(x); };
+    std::vector<double> ideal{0.0, 2.0, 2.0 + 1.0 / log2(3.0), 2.0 + 1.0 / log2(3.0) + 0.5 / 2.0,
+                              2.0 + 1.0 / log2(3.0) + 0.5 / 2.0 + 0.5 / log2(5.0)};
+    auto actual_ideal = evaluator.ideal_alpha_dcg(0);
+    check(actual_ideal.size() == ideal.size(), "hand case: ideal depth");
+    for (std::size_t idx = 0; idx < std::min(ideal.size(), actual_ideal.size()); ++idx) {
+        check_close(actual_ideal[idx], ideal[idx], "hand case: ideal alpha-DCG@" + std::to_string(idx));
+    }
+
+    auto run = em::Run::parse(
+        em::Buffer::from_string("q1 Q0 b 1 5 t\nq1 Q0 a 2 4 t\nq1 Q0 e 3 3 t\nq1 Q0 x 4 2 t\nq1 Q0 c 5 1 t\n"
+                                "q2 Q0 a 1 1 t\n"),
+        {.dictionary = qrels.dictionary()});
+    auto results = evaluator.evaluate(run);
+    check(results.num_queries() == 3, "hand case: query count");
+    if (results.num_queries() != 3) {
+        return;
+    }
+    // Novel gains 1 (b), 1.5 (a: 0.5 for intent 1, 1 for intent 2), 0, 0, 1 (c).
+    auto err_at_1 = 0.5 * 1.0;
+    auto err_at_2 = err_at_1 + 0.5 * 1.5 / 2.0;
+    auto err_at_5 = err_at_2 + 0.5 * 1.0 / 5.0;
+    auto dcg_at_2 = 1.0 + 1.5 / log2(3.0);
+    auto dcg_at_5 = dcg_at_2 + 1.0 / log2(6.0);
+    auto nrbp = (1.0 - 0.5 * 0.5) / 3.0 * (1.0 + 0.5 * 1.5 + 0.0625 * 1.0);
+    check_values(results, 0,
+                 {err_at_1 / 3.0, err_at_2 / 3.0, err_at_5 / 3.0, err_at_5 / 3.0,
+                  1.0 / ideal[1], dcg_at_2 / ideal[2], dcg_at_5 / ideal[4], dcg_at_5 / ideal[4],
+                  nrbp,
+                  1.0 / 3.0, 2.0 / 3.0, 1.0, 1.0},
+                 "hand case q1");
+    check_close(nrbp, 0.453125, "hand case: NRBP by hand");
+    check_values(results, 1, std::vector<double>(13, 0.0), "hand case q2");
+    check_values(results, 2, std::vector<double>(13, 0.0), "hand case q3");
+}
+
+/// The relevant intents of each judged document of a query, by document.
+using Judged = std::map<std::string, std::set<int>>;
+
+/// Novel gain of `intents`, counting them as covered once more.
+auto reference_gain(std::set<int> const& intents, std::map<int, int>& covered, double alpha) -> double
+{
+    double gain = 0.0;
+    for (auto intent : intents) {
+        gain += std::pow(1.0 - alpha, covered[intent]++);
+    }
+    return gain;
+}
+
+/// The measures of `ndeval`, in the evaluator's order, computed intent by intent.
+[[nodiscard]] auto reference_values(Judged const& judged, std::vector<std::string> const& ranking,
+                                    std::vector<std::size_t> const& cutoffs, double alpha, double beta)
+    -> std::vector<double>
+{
+    std::set<int> intents;
+    for (auto const& [doc, relevant] : judged) {
+        intents.insert(relevant.begin(), relevant.end());
+    }
+    auto num_intents = static_cast<double>(intents.size());
+    auto dcg_at = [&](std::vector<std::set<int>> const& ranked, std::size_t k) {
+        std::map<int, int> covered;
+        double dcg = 0.0;
+        for (std::size_t rank = 0; rank < std::min(k, ranked.size()); ++rank) {
+            dcg += reference_gain(ranked[rank], covered, alpha) / std::log2(static_cast<double>(rank) + 2.0);
+        }
+        return dcg;
+    };
+    std::vector<std::set<int>> ranked;
+    for (auto const& doc : ranking) {
+        auto found = judged.find(doc);
+        ranked.push_back(found == judged.end() ? std::set<int>{} : found->second);
+    }
+    // Greedy ideal: at each rank, the first document (by ID) of highest novel gain.
+    std::vector<std::set<int>> ideal;
+    std::vector<std::string> remaining;
+    for (auto const& [doc, relevant] : judged) {
+        if (!relevant.empty()) {
+            remaining.push_back(doc);
+        }
+    }
+    std::map<int, int> ideal_covered;
+    while (!remaining.empty()) {
+        auto best = remaining.begin();
+        double best_gain = -1.0;
+        for (auto doc = remaining.begin(); doc != remaining.end(); ++doc) {
+            auto probe = ideal_covered;
+            if (auto gain = reference_gain(judged.at(*doc), probe, alpha); gain > best_gain) {
+                best = doc;
+                best_gain = gain;
+            }
+        }
+        ideal.push_back(judged.at(*best));
+        reference_gain(ideal.back(), ideal_covered, alpha);
+        remaining.erase(best);
+    }
+
+    std::vector<double> values;
+    for (auto k : cutoffs) {
+        double err = 0.0;
+        for (auto intent : intents) {
+            int covered = 0;
+            for (std::size_t rank = 0; rank < std::min(k, ranked.size()); ++rank) {
+                if (ranked[rank].count(intent) != 0) {
+                    err += alpha * std::pow(1.0 - alpha, covered++) / static_cast<double>(rank + 1);
+                }
+            }
+        }
+        values.push_back(intents.empty() ? 0.0 : err / num_intents);
+    }
+    for (auto k : cutoffs) {
+        auto ideal_dcg = dcg_at(ideal, k);
+        values.push_back(ideal_dcg == 0.0 ? 0.0 : dcg_at(ranked, k) / ideal_dcg);
+    }
+    double nrbp = 0.0;
+    for (auto intent : intents) {
+        int covered = 0;
+        for (std::size_t rank = 0; rank < ranked.size(); ++rank) {
+            if (ranked[rank].count(intent) != 0) {
+                nrbp += std::pow(beta, static_cast<double>(rank)) * std::pow(1.0 - alpha, covered++);
+            }
+        }
+    }
+    values.push_back(intents.empty() ? 0.0 : (1.0 - (1.0 - alpha) * beta) / num_intents * nrbp);
+    for (auto k : cutoffs) {
+        std::set<int> seen;
+        for (std::size_t rank = 0; rank < std::min(k, ranked.size()); ++rank) {
+            seen.insert(ranked[rank].begin(), ranked[rank].end());
+        }
+        values.push_back(intents.empty() ? 0.0 : static_cast<double>(seen.size()) / num_intents);
+    }
+    return values;
+}
+
+/// Random queries with up to 8 intents and 30 judged documents, few of them relevant to
+/// several intents so that both the penalty and the ideal ties come into play, ranked
+/// among unjudged documents up to 40 deep.
+void check_random()
+{
+    std::mt19937_64 rng(23);
+    std::uniform_int_distribution<int> num_intents(1, 8);
+    std::uniform_int_distribution<int> grade(-1, 2);
+    std::uniform_int_distribution<int> doc_count(0, 30);
+    std::uniform_int_distribution<std::size_t> depth(0, 40);
+    for (double alpha : {0.5, 0.2, 1.0}) {
+        std::string qrels_text;
+        std::string run_text;
+        std::vector<Judged> queries;
+        std::vector<std::vector<std::string>> rankings;
+        for (int query = 0; query < 40; ++query) {
+            auto qid = "q" + std::to_string(100 + query);
+            Judged judged;
+            auto intents = num_intents(rng);
+            std::bernoulli_distribution judge(2.0 / intents);
+            std::uniform_int_distribution<int> any_intent(1, intents);
+            for (int doc = 0, docs = doc_count(rng); doc < docs; ++doc) {
+                auto docno = "d" + std::to_string(doc);
+                auto& relevant = judged[docno];
+                auto add = [&](int intent) {
+                    auto g = grade(rng);
+                    qrels_text += qid + " " + std::to_string(intent) + " " + docno + " " + std::to_string(g) + "\n";
+                    if (g >= 1) {
+                        relevant.insert(intent);
+                    }
+                };
+                bool any = false;
+                for (int intent = 1; intent <= intents; ++intent) {
+                    if (judge(rng)) {
+                        add(intent);
+                        any = true;
+                    }
+                }
+                if (!any) {
+                    add(any_intent(rng));
+                }
+            }
+            std::vector<std::string> ranking;
+            for (int doc = 0; doc < 45; ++doc) {
+                ranking.push_back("d" + std::to_string(doc));
+            }
+            std::shuffle(ranking.begin(), ranking.end(), rng);
+            ranking.resize(depth(rng));
+            for (std::size_t rank = 0; rank < ranking.size(); ++rank) {
+                run_text += qid + " Q0 " + ranking[rank] + " " + std::to_string(rank + 1) + " "
+                    + std::to_string(ranking.size() - rank) + " t\n";
+            }
+            queries.push_back(std::move(judged));
+            rankings.push_back(std::move(ranking));
+        }
+
+        auto qrels = em::IntentQrels::parse(em::Buffer::from_string(qrels_text));
+        em::DiversityOptions options;
+        options.alpha = alpha;
+        options.beta = 0.8;
+        options.cutoffs = {1, 3, 5, 10, 20, 30};
+        options.complete = true;
+        em::DiversityEvaluator evaluator(qrels, options);
+        auto run = em::Run::parse(em::Buffer::from_string(run_text), {.dictionary = qrels.dictionary()});
+        auto results = evaluator.evaluate(run);
+        for (std::size_t query = 0; query < results.num_queries(); ++query) {
+            auto const& qid = results.query_id(query);
+            auto idx = static_cast<std::size_t>(std::stoi(qid.substr(1)) - 100);
+            auto what = "alpha " + std::to_string(alpha) + ", query " + qid;
+            check_values(results, query,
+                         reference_values(queries[idx], rankings[idx], options.cutoffs, alpha, options.beta), what);
+        }
+    }
+}
+
+}  // namespace
+
+int main()
+{
+    check_hand_case();
+    check_random();
+    return em::test::exit_status();
+}
@@ -0,0 +1,149 @@
+// Checks the parsing of `SampledRuns`, including its errors, and `ExposureEvaluator`
+// on queries worked out by hand: two relevant documents and a non-relevant one swapped
+// between two samples, with and without document groups, and graded documents of which
+// one is never sampled.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "check.hpp"
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/exposure.hpp"
+#include "eval_metrics/qrels.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+using em::test::check;
+using em::test::check_identical;
+
+[[nodiscard]] auto parse(std::string_view text) -> em::SampledRuns
+{
+    return em::SampledRuns::parse(em::Buffer::from_string(std::string(text)));
+}
+
+/// Checks that `text` is rejected, on line `line` (0 when the error has no line).
+void check_rejected(std::string_view text, std::size_t line, std::string const& what)
+{
+    try {
+        static_cast<void>(parse(text));
+        check(false, what + ": accepted");
+    } catch (em::ParseError const& error) {
+        check(error.line() == line, what + ": reported line " + std::to_string(error.line()) + " ("
+                                        + error.what() + "), expected " + std::to_string(line));
+    }
+}
+
+void check_sample(em::SampledRuns const& runs, std::size_t query, std::size_t sample,
+                  std::vector<std::uint32_t> const& expected, std::string const& what)
+{
+    auto positions = runs.sample(query, sample);
+    check(std::vector<std::uint32_t>(positions.begin(), positions.end()) == expected, what);
+}
+
+void check_parse()
+{
+    // The lines of the two queries interleave; each keeps its own candidates and samples.
+    auto runs = parse("q2 D x\nq1 D a\n\nq2 D y\nq1 D b\nq2 S 1 0\nq1 S 0 1\nq2 S 0\nq1 S 1 0\nq1 S\n");
+    check(runs.num_queries() == 2, "query count");
+    if (runs.num_queries() == 2) {
+        check(runs.query_id(0) == "q1" && runs.query_id(1) == "q2", "queries out of order");
+        check(runs.candidates(0).size() == 2 && runs.candidates(0)[0] == "a" && runs.candidates(0)[1] == "b",
+              "q1 candidates");
+        check(runs.candidates(1).size() == 2 && runs.candidates(1)[0] == "x" && runs.candidates(1)[1] == "y",
+              "q2 candidates");
+        check(runs.num_samples(0) == 3 && runs.num_samples(1) == 2, "sample counts");
+        if (runs.num_samples(0) == 3 && runs.num_samples(1) == 2) {
+            check_sample(runs, 0, 0, {0, 1}, "q1 sample 0");
+            // A position may come back in the next sample.
+            check_sample(runs, 0, 1, {1, 0}, "q1 sample 1");
+            check_sample(runs, 0, 2, {}, "q1 empty sample");
+            check_sample(runs, 1, 0, {1, 0}, "q2 sample 0");
+            check_sample(runs, 1, 1, {0}, "q2 sample 1");
+        }
+        check(runs.candidate_ids(0)[0] == em::unresolved_doc, "candidate resolved without a dictionary");
+    }
+
+    check_rejected("q1 S 0\n", 1, "sample before any candidate");
+    check_rejected("q1 D a\nq1 S 0 1\nq1 D b\n", 2, "candidate declared after the sample");
+    check_rejected("q1 D a\nq2 D b\nq2 S 0\nq1 S 0 1\n", 4, "candidate of another query");
+    check_rejected("q1 D a\nq1 S -1\n", 2, "negative position");
+    check_rejected("q1 D a\nq1 S 0.0\n", 2, "fractional position");
+    check_rejected("q1 D a\nq1 S x\n", 2, "position that is not a number");
+    check_rejected("q1 D a\nq1 S 4294967296\n", 2, "position out of range");
+    check_rejected("q1 D a\nq1 D b\nq1 S 1 0 1\n", 3, "repeated position");
+    check_rejected("q1 D a\nq1 D b\nq1 S 1 0\nq1 S 0 0\n", 4, "repeated position in the second sample");
+    check_rejected("q1 D a\nq2 D a\nq1 D a\n", 0, "duplicate candidate");
+    check_rejected("q1 D\n", 1, "candidate without a document");
+    check_rejected("q1 D a b\n", 1, "candidate with an extra field");
+    check_rejected("q1 X a\n", 1, "unknown line kind");
+    check_rejected("q1\n", 1, "line without a kind");
+}
+
+/// Checks the three measures of `query`, bit for bit: the cases below only involve
+/// sums of powers of two.
+void check_values(em::Results const& results, std::size_t query, std::vector<double> const& expected,
+                  std::string const& what)
+{
+    auto values = results.values(query);
+    check(values.size() == expected.size(), what + ": metric count");
+    for (std::size_t idx = 0; idx < std::min(values.size(), expected.size()); ++idx) {
+        check_identical(values[idx], expected[idx], what + " " + results.metrics()[idx].name);
+    }
+}
+
+void check_hand_cases()
+{
+    // q1: r1 and r2 relevant, n not; both samples rank n last. q2: a, then b and c tied,
+    // of which c is never sampled. q3 is missing from the samples.
+    auto qrels = em::Qrels::parse(em::Buffer::from_string(
+        "q1 0 n 0\nq1 0 r1 1\nq1 0 r2 1\n"
+        "q2 0 a 2\nq2 0 b 1\nq2 0 c 1\n"
+        "q3 0 a 1\n"));
+    auto runs = em::SampledRuns::parse(
+        em::Buffer::from_string("q1 D r1\nq1 D n\nq1 D r2\nq1 S 0 2 1\nq1 S 2 0 1\n"
+                                "q2 D a\nq2 D b\nq2 D u\nq2 S 1 0\n"),
+        qrels.dictionary());
+    auto groups = em::DocumentGroups::parse(em::Buffer::from_string("r1 g1\nn g1\nr2 g2\nb g2\nc g2\n"));
+    em::ExposureEvaluator evaluator(qrels, {.patience = 0.5}, &groups);
+
+    // The relevant documents of q1 share ranks 0 and 1: (1 + 0.5) / 2 each. n gets none.
+    check_identical(evaluator.target(0, 0), 0.0, "q1 target of n");
+    check_identical(evaluator.target(0, 1), 0.75, "q1 target of r1");
+    check_identical(evaluator.target(0, 2), 0.75, "q1 target of r2");
+    check_identical(evaluator.target(1, 0), 1.0, "q2 target of a");
+    check_identical(evaluator.target(1, 1), 0.375, "q2 target of b");
+    check_identical(evaluator.target(1, 2), 0.375, "q2 target of c");
+
+    auto results = evaluator.evaluate(runs);
+    check(results.num_queries() == 2, "hand cases: query count");
+    if (results.num_queries() != 2) {
+        return;
+    }
+    // q1 exposures: r1 and r2 0.75, n 0.25. Groups: g1 (r1, n) 1 against a target of
+    // 0.75, g2 (r2) 0.75 against 0.75.
+    check_values(results, 0, {0.0625, 1.1875, 1.125, 0.0625, 1.5625, 1.3125}, "q1");
+    // q2 exposures: b 1, a 0.5, the unjudged u none; c misses its 0.375. Groups: g2 (b, c)
+    // 1 against 0.75, g1 nothing.
+    check_values(results, 1, {0.78125, 1.25, 0.875, 0.0625, 1.0, 0.75}, "q2");
+
+    // Without groups, only the first three.
+    em::ExposureEvaluator plain(qrels);
+    auto plain_results = plain.evaluate(runs);
+    check(plain_results.metrics().size() == 3, "metrics without groups");
+    check_values(plain_results, 0, {0.0625, 1.1875, 1.125}, "q1 without groups");
+}
+
+}  // namespace
+
+int main()
+{
+    check_parse();
+    check_hand_cases();
+    return em::test::exit_status();
+}
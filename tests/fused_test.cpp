@@ -0,0 +1,320 @@
+// Checks that `fused_pass`, in each of its template variants, computes exactly the
+// values of the reference functions of `metrics.hpp`, bit for bit, as do the
+// compile-time metric sets of `static_metrics.hpp` and the `PrefixSums` of
+// `prefix.hpp`, and that the evaluator built on them ranks tied scores as `trec_eval`
+// does. The gain columns cover empty rankings, queries without relevant documents,
+// cutoffs deeper than the ranking, negative (unsampled) and unjudged grades, and
+// random columns past the shared discount table. Rankings long enough for the radix
+// sort are checked by `tests/ranking_test`.
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/fused.hpp"
+#include "eval_metrics/metrics.hpp"
+#include "eval_metrics/prefix.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+#include "eval_metrics/static_metrics.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+using em::test::check;
+using em::test::check_identical;
+using em::unjudged;
+
+constexpr std::int32_t relevance_level = 1;
+constexpr std::array<std::size_t, 6> cutoffs{1, 2, 5, 10, 30, 1000};
+constexpr std::array<double, 4> stop_probabilities{0.0, 0.125, 0.375, 0.875};
+constexpr std::array<double, 3> persistences{0.5, 0.8, 0.95};
+
+struct Case {
+    std::string name;
+    std::vector<std::int32_t> grades;
+    /// Relevant grades of the query in decreasing order; `num_rel` is their number.
+    std::vector<std::int32_t> ideal;
+    std::size_t num_nonrel = 0;
+};
+
+template <bool WithDcg, bool WithCascade, bool WithIncomplete>
+void check_variant(Case const& query)
+{
+    std::array<std::size_t, cutoffs.size()> relevant_at{};
+    std::array<double, cutoffs.size()> dcg_at{};
+    std::array<double, cutoffs.size()> err_at{};
+    std::array<double, persistences.size()> rbp{};
+    std::array<double, persistences.size()> residual{};
+    std::array<double, persistences.size()> weights{};
+    std::array<std::size_t, cutoffs.size()> judged_at{};
+    em::FusedCascade cascade{stop_probabilities, persistences, err_at, 0.0, rbp, residual, weights};
+    em::FusedIncomplete incomplete{query.num_nonrel, judged_at};
+    em::FusedTotals totals;
+    auto num_rel = query.ideal.size();
+    em::fused_pass<WithDcg, WithCascade, WithIncomplete>(
+        query.grades, num_rel, relevance_level, cutoffs, relevant_at, dcg_at, totals, em::DiscountTable::standard(),
+        WithCascade ? &cascade : nullptr, WithIncomplete ? &incomplete : nullptr);
+
+    auto label = [&](std::string const& what) {
+        return query.name + " <" + std::to_string(WithDcg) + std::to_string(WithCascade)
+            + std::to_string(WithIncomplete) + ">: " + what;
+    };
+    check(totals.relevant == em::relevant_retrieved(query.grades, relevance_level), label("num_rel_ret"));
+    check_identical(
+        em::fused_average_precision(totals, num_rel), em::average_precision(query.grades, num_rel, relevance_level),
+        label("map"));
+    check_identical(
+        em::fused_r_precision(totals, num_rel), em::r_precision(query.grades, num_rel, relevance_level),
+        label("Rprec"));
+    check_identical(
+        em::fused_reciprocal_rank(totals), em::reciprocal_rank(query.grades, relevance_level), label("recip_rank"));
+    for (std::size_t cutoff = 0; cutoff < cutoffs.size(); ++cutoff) {
+        auto k = cutoffs[cutoff];
+        auto at = "@" + std::to_string(k);
+        check_identical(
+            em::fused_precision(relevant_at[cutoff], k), em::precision(query.grades, relevance_level, k),
+            label("P" + at));
+        check_identical(
+            em::fused_recall(relevant_at[cutoff], num_rel), em::recall(query.grades, num_rel, relevance_level, k),
+            label("recall" + at));
+        check_identical(
+            em::fused_success(relevant_at[cutoff]), em::success(query.grades, relevance_level, k),
+            label("success" + at));
+        if constexpr (WithDcg) {
+            check_identical(
+                em::fused_ndcg(dcg_at[cutoff], em::dcg(query.ideal, k)), em::ndcg(query.grades, query.ideal, k),
+                label("ndcg_cut" + at));
+        }
+        if constexpr (WithCascade) {
+            check_identical(
+                err_at[cutoff], em::expected_reciprocal_rank(query.grades, stop_probabilities, k), label("err" + at));
+        }
+        if constexpr (WithIncomplete) {
+            check(judged_at[cutoff] == em::judged_retrieved(query.grades, k), label("judged_retrieved" + at));
+            check_identical(
+                em::fused_judged(judged_at[cutoff], k), em::judged(query.grades, k), label("judged" + at));
+        }
+    }
+    if constexpr (WithDcg) {
+        check_identical(
+            em::fused_ndcg(totals.dcg, em::dcg(query.ideal)), em::ndcg(query.grades, query.ideal), label("ndcg"));
+    }
+    if constexpr (WithCascade) {
+        check_identical(cascade.err, em::expected_reciprocal_rank(query.grades, stop_probabilities), label("err"));
+        for (std::size_t idx = 0; idx < persistences.size(); ++idx) {
+            auto p = persistences[idx];
+            check_identical(
+                rbp[idx], em::rank_biased_precision(query.grades, relevance_level, p),
+                label("rbp." + std::to_string(p)));
+            check_identical(residual[idx], em::rbp_residual(query.grades, p), label("rbp_res." + std::to_string(p)));
+        }
+    }
+    if constexpr (WithIncomplete) {
+        check(incomplete.judged == em::judged_retrieved(query.grades), label("judged_retrieved"));
+        check_identical(
+            incomplete.bpref, em::bpref(query.grades, num_rel, query.num_nonrel, relevance_level), label("bpref"));
+        check_identical(
+            incomplete.infap, em::inferred_average_precision(query.grades, num_rel, relevance_level),
+            label("infAP"));
+    }
+}
+
+void check_all_variants(Case const& query)
+{
+    check_variant<true, false, false>(query);
+    check_variant<false, false, false>(query);
+    check_variant<true, true, false>(query);
+    check_variant<false, true, false>(query);
+    check_variant<true, false, true>(query);
+    check_variant<false, false, true>(query);
+    check_variant<true, true, true>(query);
+    check_variant<false, true, true>(query);
+}
+
+using StandardSet = em::Metrics<
+    em::NumRelRet, em::AP, em::RPrec, em::RR,
+    em::P<1>, em::Recall<1>, em::NDCG<1>,
+    em::P<2>, em::Recall<2>, em::NDCG<2>,
+    em::P<5>, em::Recall<5>, em::NDCG<5>,
+    em::P<10>, em::Recall<10>, em::NDCG<10>,
+    em::P<30>, em::Recall<30>, em::NDCG<30>,
+    em::P<1000>, em::Recall<1000>, em::NDCG<1000>,
+    em::NDCG<>>;
+
+/// The standard measures in the order of `StandardSet`.
+[[nodiscard]] auto standard_reference(Case const& query) -> std::vector<double>
+{
+    auto num_rel = query.ideal.size();
+    std::vector<double> values{
+        static_cast<double>(em::relevant_retrieved(query.grades, relevance_level)),
+        em::average_precision(query.grades, num_rel, relevance_level),
+        em::r_precision(query.grades, num_rel, relevance_level),
+        em::reciprocal_rank(query.grades, relevance_level)};
+    for (auto k : cutoffs) {
+        values.push_back(em::precision(query.grades, relevance_level, k));
+        values.push_back(em::recall(query.grades, num_rel, relevance_level, k));
+        values.push_back(em::ndcg(query.grades, query.ideal, k));
+    }
+    values.push_back(em::ndcg(query.grades, query.ideal));
+    return values;
+}
+
+void check_static_and_prefix(Case const& query)
+{
+    auto expected = standard_reference(query);
+    auto compiled = em::evaluate<StandardSet>(query.grades, query.ideal, relevance_level).values;
+    check(compiled.size() == expected.size(), query.name + " <static>: number of values");
+    for (std::size_t idx = 0; idx < std::min(compiled.size(), expected.size()); ++idx) {
+        check_identical(compiled[idx], expected[idx], query.name + " <static>: value " + std::to_string(idx));
+    }
+
+    auto num_rel = query.ideal.size();
+    em::PrefixSums ideal;
+    em::PrefixSums sums;
+    ideal.assign(query.ideal, relevance_level, num_rel, {});
+    sums.assign(query.grades, relevance_level, num_rel, ideal.dcg_prefix());
+    check(sums.relevant(em::no_cutoff) == em::relevant_retrieved(query.grades, relevance_level),
+          query.name + " <prefix>: num_rel_ret");
+    for (std::size_t cutoff = 0; cutoff < cutoffs.size(); ++cutoff) {
+        auto k = cutoffs[cutoff];
+        auto at = "@" + std::to_string(k);
+        check_identical(sums.precision(k), expected[4 + 3 * cutoff], query.name + " <prefix>: P" + at);
+        check_identical(sums.recall(k), expected[5 + 3 * cutoff], query.name + " <prefix>: recall" + at);
+        check_identical(sums.ndcg(k), expected[6 + 3 * cutoff], query.name + " <prefix>: ndcg_cut" + at);
+    }
+    check_identical(sums.ndcg(), expected.back(), query.name + " <prefix>: ndcg");
+    // The empty prefix, which the reference functions leave undefined for P.
+    check_identical(sums.precision(0), 0.0, query.name + " <prefix>: P@0");
+    check_identical(sums.recall(0), 0.0, query.name + " <prefix>: recall@0");
+    check_identical(sums.ndcg(0), 0.0, query.name + " <prefix>: ndcg_cut@0");
+    check_identical(sums.success(0), 0.0, query.name + " <prefix>: success@0");
+}
+
+[[nodiscard]] auto edge_cases() -> std::vector<Case>
+{
+    return {
+        {"empty ranking", {}, {}, 0},
+        {"empty ranking of a judged query", {}, {2, 1}, 3},
+        {"no relevant documents", {0, 0, unjudged, 0}, {}, 3},
+        {"relevant documents not retrieved", {0, unjudged, 0, -1}, {3, 1}, 2},
+        {"only unjudged documents", {unjudged, unjudged, unjudged}, {1}, 0},
+        {"cutoffs deeper than the ranking", {1, 0, 2}, {2, 1, 1}, 1},
+        {"more relevant documents than retrieved", {1, 1}, {3, 2, 1, 1, 1}, 0},
+        {"relevant first and last", {3, 0, 0, -1, unjudged, 0, 1}, {3, 1}, 4},
+        {"unsampled above relevant", {-1, -1, 1, unjudged, -1, 2}, {2, 1, 1}, 0},
+        {"grade below the relevance level", {0, 0, 0, 0, 0, 1}, {1}, 5},
+    };
+}
+
+[[nodiscard]] auto random_cases() -> std::vector<Case>
+{
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<int> grade(-1, 4);
+    std::uniform_int_distribution<int> relevant_grade(1, 3);
+    std::vector<Case> cases;
+    for (std::size_t depth : {0, 1, 3, 7, 29, 30, 31, 64, 999, 1000, 1001, 2500}) {
+        for (int repeat = 0; repeat < 20; ++repeat) {
+            Case query{"random depth " + std::to_string(depth) + " #" + std::to_string(repeat), {}, {}, 0};
+            for (std::size_t rank = 0; rank < depth; ++rank) {
+                auto value = grade(rng);
+                query.grades.push_back(value == 4 ? unjudged : value);
+            }
+            std::uniform_int_distribution<std::size_t> count(0, depth / 4 + 2);
+            for (auto num_rel = count(rng); query.ideal.size() < num_rel;) {
+                query.ideal.push_back(relevant_grade(rng));
+            }
+            std::sort(query.ideal.begin(), query.ideal.end(), std::greater<>());
+            query.num_nonrel = count(rng);
+            cases.push_back(std::move(query));
+        }
+    }
+    return cases;
+}
+
+/// Documents of equal score are ranked by decreasing document ID, so `z`, `c` and `b`
+/// come before `a`; ranked by increasing ID, the relevant `b` would be first instead.
+void check_tied_scores()
+{
+    auto qrels = em::Qrels::parse(em::Buffer::from_string(
+        "q1 0 a 2\n"
+        "q1 0 b 1\n"
+        "q1 0 c 0\n"
+        "q1 0 d 1\n"
+        "q1 0 z 0\n"
+        "q2 0 a 1\n"));
+    em::RunParseOptions parsing;
+    parsing.dictionary = qrels.dictionary();
+    auto run = em::Run::parse(
+        em::Buffer::from_string(
+            "q1 Q0 a 1 1.0 tag\n"
+            "q1 Q0 b 2 2.0 tag\n"
+            "q1 Q0 x 3 0.5 tag\n"
+            "q1 Q0 z 4 2.0 tag\n"
+            "q1 Q0 c 5 2.0 tag\n"
+            "q2 Q0 b 1 3.0 tag\n"
+            "q2 Q0 a 2 3.0 tag\n"
+            "q2 Q0 c 3 3.0 tag\n"),
+        parsing);
+    em::EvaluationOptions options;
+    options.measures = {"num_rel_ret", "map", "Rprec", "recip_rank", "P.1,2,5,10", "recall.5", "ndcg_cut.2,10"};
+    auto results = em::Evaluator(qrels, options).evaluate(run);
+
+    std::array<Case, 2> expected{
+        Case{"ties of q1", {0, 0, 1, 2, unjudged}, {2, 1, 1}, 2},
+        Case{"ties of q2", {unjudged, unjudged, 1}, {1}, 0},
+    };
+    check(results.num_queries() == expected.size(), "tied scores: number of queries");
+    for (std::size_t query = 0; query < std::min(results.num_queries(), expected.size()); ++query) {
+        auto const& grades = expected[query].grades;
+        auto const& ideal = expected[query].ideal;
+        auto num_rel = ideal.size();
+        auto values = results.values(query);
+        auto metrics = results.metrics();
+        for (std::size_t idx = 0; idx < metrics.size(); ++idx) {
+            auto const& name = metrics[idx].name;
+            double reference = 0.0;
+            if (name == "num_rel_ret") {
+                reference = static_cast<double>(em::relevant_retrieved(grades, relevance_level));
+            } else if (name == "map") {
+                reference = em::average_precision(grades, num_rel, relevance_level);
+            } else if (name == "Rprec") {
+                reference = em::r_precision(grades, num_rel, relevance_level);
+            } else if (name == "recip_rank") {
+                reference = em::reciprocal_rank(grades, relevance_level);
+            } else if (name.starts_with("P_")) {
+                reference = em::precision(grades, relevance_level, std::stoul(name.substr(2)));
+            } else if (name.starts_with("recall_")) {
+                reference = em::recall(grades, num_rel, relevance_level, std::stoul(name.substr(7)));
+            } else if (name.starts_with("ndcg_cut_")) {
+                reference = em::ndcg(grades, ideal, std::stoul(name.substr(9)));
+            } else {
+                check(false, "tied scores: unexpected metric " + name);
+                continue;
+            }
+            check_identical(values[idx], reference, expected[query].name + ": " + name);
+        }
+    }
+}
+
+}  // namespace
+
+int main()
+{
+    for (auto const& query : edge_cases()) {
+        check_all_variants(query);
+        check_static_and_prefix(query);
+    }
+    for (auto const& query : random_cases()) {
+        check_all_variants(query);
+        check_static_and_prefix(query);
+    }
+    check_tied_scores();
+    return em::test::exit_status();
+}
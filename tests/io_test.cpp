@@ -0,0 +1,383 @@
+// Checks that every way of reading qrels and runs leads to the same evaluation as
+// parsing the text in memory: streaming a run query by query, and loading qrels and
+// runs converted to the binary format, which must also be rejected when corrupt or of
+// another version, and rebuilt as a cache when their source changes, and reading
+// gzip- and zstd-compressed text, for whichever compressions the library was built with.
+//
+// Writes its inputs to a fresh directory under the system's temporary directory and
+// removes it at the end.
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#ifdef EVAL_METRICS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef EVAL_METRICS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "check.hpp"
+#include "eval_metrics/batch.hpp"
+#include "eval_metrics/binary_format.hpp"
+#include "eval_metrics/buffer.hpp"
+#include "eval_metrics/detail/segmented_text.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/input_stream.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+#include "eval_metrics/run_stream.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+namespace fs = std::filesystem;
+using em::test::check;
+
+void write_file(fs::path const& path, std::string_view text)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+[[nodiscard]] auto read_file(fs::path const& path) -> std::string
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+/// Qrels of 20 queries, each judging about a fifth of 200 documents with grades 0 to 3.
+[[nodiscard]] auto make_qrels(std::mt19937_64& rng) -> std::string
+{
+    std::bernoulli_distribution judged(0.2);
+    std::uniform_int_distribution<int> grade(0, 3);
+    std::string text;
+    for (int query = 301; query <= 320; ++query) {
+        for (int doc = 0; doc < 200; ++doc) {
+            if (judged(rng)) {
+                text += std::to_string(query) + " 0 d" + std::to_string(doc) + ' ' + std::to_string(grade(rng)) + '\n';
+            }
+        }
+    }
+    return text;
+}
+
+/// A run grouped by query, with the groups out of order and one query the qrels lack.
+/// Rankings are in no particular order, some long enough for the radix sort, and the
+/// scores repeat so that the tie-breaking on document IDs matters.
+[[nodiscard]] auto make_run(std::mt19937_64& rng) -> std::string
+{
+    std::vector<int> queries{312, 301, 399, 305, 320, 302, 318, 310, 307, 315};
+    std::vector<int> docs(250);
+    std::iota(docs.begin(), docs.end(), 0);
+    std::uniform_int_distribution<int> length(0, 250);
+    std::uniform_int_distribution<int> score(0, 40);
+    std::string text;
+    for (auto query : queries) {
+        std::shuffle(docs.begin(), docs.end(), rng);
+        auto n = length(rng);
+        for (int rank = 0; rank < n; ++rank) {
+            text += std::to_string(query) + " Q0 d" + std::to_string(docs[rank]) + ' ' + std::to_string(rank + 1) + ' '
+                + std::to_string(score(rng) / 4.0) + " tagA\n";
+        }
+    }
+    return text;
+}
+
+/// Checks that two evaluations hold the same queries and bit-identical values.
+void check_same_results(em::Results const& actual, em::Results const& expected, std::string const& what)
+{
+    check(actual.metrics().size() == expected.metrics().size(), what + ": metric count");
+    check(actual.num_queries() == expected.num_queries(), what + ": query count");
+    if (actual.metrics().size() != expected.metrics().size() || actual.num_queries() != expected.num_queries()) {
+        return;
+    }
+    for (std::size_t query = 0; query < expected.num_queries(); ++query) {
+        check(actual.query_id(query) == expected.query_id(query), what + ": query " + expected.query_id(query));
+        auto values = actual.values(query);
+        auto expected_values = expected.values(query);
+        for (std::size_t idx = 0; idx < values.size(); ++idx) {
+            em::test::check_identical(
+                values[idx], expected_values[idx],
+                what + ": " + expected.metrics()[idx].name + " of " + expected.query_id(query));
+        }
+    }
+}
+
+[[nodiscard]] auto run_options(em::Evaluator const& evaluator) -> em::RunParseOptions
+{
+    em::RunParseOptions options;
+    options.dictionary = evaluator.qrels().dictionary();
+    options.depth = evaluator.required_depth();
+    return options;
+}
+
+[[nodiscard]] auto evaluate_streamed(em::Evaluator const& evaluator, fs::path const& path) -> em::Results
+{
+    em::RunStream stream(path, run_options(evaluator));
+    return evaluator.evaluate(stream);
+}
+
+void check_streaming(em::Qrels const& qrels, fs::path const& run_path, std::string const& run_text)
+{
+    // Deep measures, which order whole rankings, and shallow ones, which order only the top.
+    std::vector<std::vector<std::string>> measure_sets{{}, {"P.5", "ndcg_cut.10"}};
+    for (auto const& measures : measure_sets) {
+        em::EvaluationOptions options;
+        options.measures = measures;
+        em::Evaluator evaluator(qrels, options);
+        auto label = measures.empty() ? std::string("standard measures") : std::string("shallow measures");
+        auto expected = evaluator.evaluate(em::Run::parse(em::Buffer::from_string(run_text), run_options(evaluator)));
+        check_same_results(evaluate_streamed(evaluator, run_path), expected, "streamed, " + label);
+    }
+}
+
+void check_ungrouped_stream(em::Qrels const& qrels, fs::path const& path)
+{
+    write_file(path, "301 Q0 d1 1 2.0 t\n302 Q0 d2 1 1.0 t\n301 Q0 d3 2 0.5 t\n");
+    em::Evaluator evaluator(qrels);
+    try {
+        (void)evaluate_streamed(evaluator, path);
+        check(false, "an ungrouped run is streamed without error");
+    } catch (em::UngroupedRunError const& error) {
+        check(std::string_view(error.what()).find("line 3") != std::string_view::npos,
+              std::string("ungrouped run error names another line: ") + error.what());
+    }
+}
+
+/// Checks that a streamed batch evaluates each run as loading it does, and records
+/// which runs had to be loaded whole because they are not grouped by query.
+void check_streamed_batch(em::Qrels const& qrels, fs::path const& dir)
+{
+    em::Evaluator evaluator(qrels);
+    std::vector<fs::path> paths{dir / "run.txt", dir / "ungrouped.txt"};
+    em::BatchOptions options;
+    options.stream = true;
+    auto evaluations = em::evaluate_runs(evaluator, paths, options);
+    for (std::size_t idx = 0; idx < paths.size(); ++idx) {
+        auto const& evaluation = evaluations[idx];
+        auto what = "batch, " + paths[idx].filename().string();
+        check(!evaluation.error && evaluation.results, what + ": not evaluated");
+        check(evaluation.stream_fallback.empty() == (idx == 0), what + ": stream fallback recorded wrongly");
+        if (evaluation.results) {
+            check_same_results(
+                *evaluation.results, evaluator.evaluate(em::Run::from_file(paths[idx], run_options(evaluator))), what);
+        }
+    }
+    check(evaluations[1].stream_fallback.find("not grouped") != std::string::npos,
+          "stream fallback does not say why: " + evaluations[1].stream_fallback);
+}
+
+/// Converts the text files as `convert` does, then checks that the binary qrels and
+/// run evaluate exactly as the text does.
+void check_binary_round_trip(fs::path const& dir, em::Results const& expected)
+{
+    auto qrels = em::Qrels::from_file(dir / "qrels.txt");
+    em::write_binary(dir / "qrels.bin", qrels, em::SourceStamp::of(dir / "qrels.txt"));
+    em::write_binary(dir / "run.bin", em::Run::from_file(dir / "run.txt"), em::SourceStamp::of(dir / "run.txt"));
+    check(em::binary_source_stamp(dir / "run.bin") == em::SourceStamp::of(dir / "run.txt"), "source stamp of run.bin");
+
+    auto binary_qrels = em::Qrels::from_file(dir / "qrels.bin");
+    em::Evaluator evaluator(binary_qrels);
+    auto binary_run = em::Run::from_file(dir / "run.bin", run_options(evaluator));
+    check_same_results(evaluator.evaluate(binary_run), expected, "binary qrels and run");
+    em::Evaluator text_qrels(qrels);
+    check_same_results(
+        text_qrels.evaluate(em::Run::from_file(dir / "run.bin", run_options(text_qrels))), expected, "binary run");
+}
+
+/// Checks that loading `bytes`, a damaged copy of a binary run, fails with a message
+/// containing `reason`.
+void check_rejected(fs::path const& path, std::string const& bytes, std::string_view reason)
+{
+    write_file(path, bytes);
+    try {
+        (void)em::Run::from_file(path);
+        check(false, "loaded a binary run that should fail with: " + std::string(reason));
+    } catch (em::ParseError const& error) {
+        check(std::string_view(error.what()).find(reason) != std::string_view::npos,
+              "expected \"" + std::string(reason) + "\", got: " + error.what());
+    }
+}
+
+void check_corrupt_binary(fs::path const& dir)
+{
+    auto bytes = read_file(dir / "run.bin");
+    auto flipped = bytes;
+    flipped[flipped.size() / 2] ^= 0x10;
+    check_rejected(dir / "corrupt.bin", flipped, "checksum mismatch");
+    auto truncated = bytes.substr(0, bytes.size() - 8);
+    check_rejected(dir / "truncated.bin", truncated, "corrupt");
+
+    // The version follows the 8 magic bytes.
+    auto other_version = bytes;
+    ++other_version[8];
+    check_rejected(dir / "version.bin", other_version, "unsupported binary format version");
+    check(!em::binary_source_stamp(dir / "version.bin"), "a file of another version has a source stamp");
+}
+
+/// Checks that `load_run_cached` writes the cache, rebuilds it when it is corrupt or its
+/// source has changed, and gives the same run every time.
+void check_stale_cache(fs::path const& dir, em::Qrels const& qrels, std::string const& run_text)
+{
+    em::Evaluator evaluator(qrels);
+    auto source = dir / "cached.txt";
+    auto cache = dir / "cached.bin";
+    auto evaluate_cached = [&] {
+        return evaluator.evaluate(em::load_run_cached(source, cache, run_options(evaluator)));
+    };
+    auto evaluate_text = [&](std::string const& text) {
+        return evaluator.evaluate(em::Run::parse(em::Buffer::from_string(text), run_options(evaluator)));
+    };
+
+    write_file(source, run_text);
+    check_same_results(evaluate_cached(), evaluate_text(run_text), "new cache");
+    check(em::binary_source_stamp(cache) == em::SourceStamp::of(source), "cache stamped with its source");
+    check_same_results(evaluate_cached(), evaluate_text(run_text), "cache hit");
+
+    auto bytes = read_file(cache);
+    bytes[bytes.size() / 2] ^= 0x10;
+    write_file(cache, bytes);
+    check_same_results(evaluate_cached(), evaluate_text(run_text), "corrupt cache");
+    check(read_file(cache) != bytes, "corrupt cache not rewritten");
+
+    // Dropping the last query changes the size, so the cache is stale whatever the clock.
+    auto changed = run_text.substr(0, run_text.rfind('\n', run_text.size() - 2) + 1);
+    write_file(source, changed);
+    check(em::binary_source_stamp(cache) != em::SourceStamp::of(source), "stale cache has the source's stamp");
+    check_same_results(evaluate_cached(), evaluate_text(changed), "stale cache");
+    check(em::binary_source_stamp(cache) == em::SourceStamp::of(source), "stale cache not rewritten");
+}
+
+/// Writes `text` compressed, split into two gzip members or zstd frames, which
+/// readers must decompress one after the other. Returns `false` if the test was built
+/// without the compression.
+[[nodiscard]] auto write_compressed(fs::path const& path, std::string_view text, em::Compression compression) -> bool
+{
+    auto half = text.size() / 2;
+    std::string_view parts[] = {text.substr(0, half), text.substr(half)};
+    if (compression == em::Compression::gzip) {
+#ifdef EVAL_METRICS_HAVE_ZLIB
+        for (std::size_t part = 0; part < 2; ++part) {
+            auto* file = gzopen(path.c_str(), part == 0 ? "wb" : "ab");
+            gzwrite(file, parts[part].data(), static_cast<unsigned>(parts[part].size()));
+            gzclose(file);
+        }
+        return true;
+#endif
+    } else if (compression == em::Compression::zstd) {
+#ifdef EVAL_METRICS_HAVE_ZSTD
+        std::string bytes;
+        for (auto part : parts) {
+            std::string frame(ZSTD_compressBound(part.size()), '\0');
+            frame.resize(ZSTD_compress(frame.data(), frame.size(), part.data(), part.size(), 3));
+            bytes += frame;
+        }
+        write_file(path, bytes);
+        return true;
+#endif
+    }
+    return false;
+}
+
+/// Checks that the text read back through an `InputStream` with small buffers is the
+/// original, line for line, with the line numbers `detail::read_segments` reports.
+void check_segments(fs::path const& path, std::string const& text, std::string const& what)
+{
+    em::InputStream input(path, em::InputStreamOptions{.buffer_size = 61, .queue_depth = 2});
+    em::detail::SegmentedText segments;
+    std::string joined;
+    em::detail::read_segments(input, segments, [&](std::string_view lines, std::size_t preceding_lines) {
+        check(preceding_lines == static_cast<std::size_t>(std::count(joined.begin(), joined.end(), '\n')),
+              what + ": line count before a segment");
+        check(lines.empty() || lines.back() == '\n' || joined.size() + lines.size() == text.size(),
+              what + ": segment ends mid-line");
+        joined.append(lines);
+    });
+    check(joined == text, what + ": segments differ from the text");
+}
+
+void check_compressed(
+    fs::path const& dir, em::Compression compression, std::string const& qrels_text, std::string const& run_text)
+{
+    auto name = std::string(em::compression_name(compression));
+    auto qrels_path = dir / ("qrels." + name);
+    auto run_path = dir / ("run." + name);
+    if (!em::is_supported(compression)) {
+        // Magic bytes alone are enough to be turned down.
+        write_file(run_path, compression == em::Compression::gzip ? "\x1f\x8b" : "\x28\xb5\x2f\xfd");
+        try {
+            (void)em::Run::from_file(run_path);
+            check(false, "read a " + name + " run without " + name + " support");
+        } catch (em::IoError const&) {
+        }
+        std::printf("%s is not supported, skipping its round trip\n", name.c_str());
+        return;
+    }
+    if (!write_compressed(qrels_path, qrels_text, compression) || !write_compressed(run_path, run_text, compression)) {
+        std::printf("the test was built without %s, skipping its round trip\n", name.c_str());
+        return;
+    }
+    check(em::InputStream(run_path).compression() == compression, name + " detected");
+    check_segments(qrels_path, qrels_text, name + " qrels");
+    check_segments(run_path, run_text, name + " run");
+
+    auto qrels = em::Qrels::from_file(qrels_path);
+    em::Evaluator evaluator(qrels);
+    auto expected = em::Evaluator(em::Qrels::parse(em::Buffer::from_string(qrels_text)))
+                        .evaluate(em::Run::parse(em::Buffer::from_string(run_text)));
+    check_same_results(evaluator.evaluate(em::Run::from_file(run_path, run_options(evaluator))), expected, name);
+    check_same_results(evaluate_streamed(evaluator, run_path), expected, name + " streamed");
+
+    // A file cut short must not pass for a shorter run.
+    auto bytes = read_file(run_path);
+    write_file(run_path, bytes.substr(0, bytes.size() - 10));
+    try {
+        (void)em::Run::from_file(run_path);
+        check(false, "read a truncated " + name + " run");
+    } catch (em::IoError const&) {
+    }
+}
+
+}  // namespace
+
+int main()
+{
+    auto dir = fs::temp_directory_path() / ("eval_metrics_io_test_" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::mt19937_64 rng(3);
+    auto qrels_text = make_qrels(rng);
+    auto run_text = make_run(rng);
+    write_file(dir / "qrels.txt", qrels_text);
+    write_file(dir / "run.txt", run_text);
+    auto qrels = em::Qrels::parse(em::Buffer::from_string(qrels_text));
+
+    check_streaming(qrels, dir / "run.txt", run_text);
+    check_ungrouped_stream(qrels, dir / "ungrouped.txt");
+    check_streamed_batch(qrels, dir);
+
+    em::Evaluator evaluator(qrels);
+    auto expected = evaluator.evaluate(em::Run::parse(em::Buffer::from_string(run_text), run_options(evaluator)));
+    check_binary_round_trip(dir, expected);
+    check_corrupt_binary(dir);
+    check_stale_cache(dir, qrels, run_text);
+    for (auto compression : {em::Compression::gzip, em::Compression::zstd}) {
+        check_compressed(dir, compression, qrels_text, run_text);
+    }
+
+    fs::remove_all(dir);
+    return em::test::exit_status();
+}
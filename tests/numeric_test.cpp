@@ -0,0 +1,142 @@
+// Checks that `detail::parse_score` returns bit-for-bit what `strtod` returns, on score
+// distributions typical of TREC runs and on the edges of the fast path, and that it and
+// `detail::parse_integer` reject whatever is not a whole number, including doubled signs.
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "check.hpp"
+#include "eval_metrics/detail/numeric.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+using em::test::check;
+
+[[nodiscard]] auto format(char const* pattern, double value) -> std::string
+{
+    std::array<char, 64> text{};
+    auto size = std::snprintf(text.data(), text.size(), pattern, value);
+    return {text.data(), static_cast<std::size_t>(size)};
+}
+
+/// Checks that `field` parses, to the same bits as `strtod`.
+void check_round_trip(std::string const& field)
+{
+    double value = 0.0;
+    auto reference = std::strtod(field.c_str(), nullptr);
+    if (!em::detail::parse_score(field, value)) {
+        check(false, "rejected score " + field);
+        return;
+    }
+    char values[96];
+    std::snprintf(values, sizeof(values), " (%.17g, strtod %.17g)", value, reference);
+    check(std::memcmp(&value, &reference, sizeof(double)) == 0, "score " + field + values);
+}
+
+void check_distributions()
+{
+    std::vector<std::function<std::string(std::mt19937_64&)>> distributions{
+        [](auto& rng) { return format("%.4f", std::gamma_distribution<>(4.0, 3.0)(rng)); },
+        [](auto& rng) { return format("%.17g", std::gamma_distribution<>(4.0, 3.0)(rng)); },
+        [](auto& rng) { return format("%.6f", std::normal_distribution<>(0.0, 4.0)(rng)); },
+        [](auto& rng) { return format("%g", std::exponential_distribution<>(50.0)(rng)); },
+        [](auto& rng) { return format("%.8e", std::exp(std::uniform_real_distribution<>(-60, 0)(rng))); },
+        [](auto& rng) { return format("%.10f", 1.0 / std::uniform_int_distribution<>(1, 1000)(rng)); },
+        // Any double, in its shortest and its longest form.
+        [](auto& rng) {
+            auto bits = std::uniform_int_distribution<std::uint64_t>(0, 0x7FEFFFFFFFFFFFFFULL)(rng);
+            double value = 0.0;
+            std::memcpy(&value, &bits, sizeof(value));
+            return format(bits % 2 == 0 ? "%.17g" : "%.25e", bits % 3 == 0 ? -value : value);
+        },
+    };
+    std::mt19937_64 rng(42);
+    for (auto const& generate : distributions) {
+        for (int idx = 0; idx < 20000; ++idx) {
+            check_round_trip(generate(rng));
+        }
+    }
+}
+
+void check_edges()
+{
+    for (std::string field : {
+             "0", "-0", "+0", "0.0", "-0.0", ".5", "5.", "-.5", "+1.5", "1E5", "1e+5", "1e-5", "007",
+             // Around the limits of the fast path: 2^53, 19 digits, and 10^22.
+             "9007199254740992", "9007199254740993", "9007199254740993e-3", "1234567890123456789",
+             "12345678901234567890", "0.12345678901234567890123", "1e22", "1e23", "123e-22", "123e-23",
+             "0.000000000000000000000001",
+             // Subnormals, overflow and underflow, which defer to strtod.
+             "4.9e-324", "2.4703282292062327e-324", "2.2250738585072011e-308", "1.7976931348623157e308",
+             "1e308", "1e309", "-1e309", "1e-400", "-1e-400", "1e99999", "inf", "-inf", "+infinity"}) {
+        check_round_trip(field);
+    }
+}
+
+void check_rejected_scores()
+{
+    for (std::string_view field : {
+             "", "-", "+", ".", "-.", "e5", "1e", "1e+", "1.5x", " 1", "1 ", "1..5", "1e5.5",
+             // A second sign, before the digits or in the exponent.
+             "--5", "+-7", "-+7", "++1", "--inf", "+-1e400", "--1e-400", "1e--5", "1e+-5",
+             // Doubled signs on numbers long enough for the fallback.
+             "--12345678901234567890", "+-0.12345678901234567890123"}) {
+        double value = 0.0;
+        check(!em::detail::parse_score(field, value), "accepted score \"" + std::string(field) + "\"");
+    }
+}
+
+template <typename T>
+void check_integer(std::string_view field, bool valid, T expected = 0)
+{
+    T value = 0;
+    auto parsed = em::detail::parse_integer(field, value);
+    check(parsed == valid, (valid ? "rejected integer \"" : "accepted integer \"") + std::string(field) + "\"");
+    if (parsed && valid) {
+        check(value == expected, "integer \"" + std::string(field) + "\" parsed as " + std::to_string(value));
+    }
+}
+
+void check_integers()
+{
+    check_integer<std::int32_t>("0", true, 0);
+    check_integer<std::int32_t>("-0", true, 0);
+    check_integer<std::int32_t>("+17", true, 17);
+    check_integer<std::int32_t>("-17", true, -17);
+    check_integer<std::int32_t>("2147483647", true, std::numeric_limits<std::int32_t>::max());
+    check_integer<std::int32_t>("-2147483648", true, std::numeric_limits<std::int32_t>::min());
+    check_integer<std::int32_t>("2147483648", false);
+    check_integer<std::int32_t>("-2147483649", false);
+    check_integer<std::int64_t>("9223372036854775807", true, std::numeric_limits<std::int64_t>::max());
+    check_integer<std::int64_t>("-9223372036854775808", true, std::numeric_limits<std::int64_t>::min());
+    check_integer<std::int64_t>("9223372036854775808", false);
+    check_integer<std::uint32_t>("4294967295", true, std::numeric_limits<std::uint32_t>::max());
+    check_integer<std::uint32_t>("4294967296", false);
+    check_integer<std::uint32_t>("-1", false);
+    check_integer<std::uint32_t>("-0", false);
+    for (std::string_view field : {"", "-", "+", "--5", "+-7", "-+7", "1.0", "1e3", " 1", "1 ", "0x10"}) {
+        check_integer<std::int32_t>(field, false);
+    }
+}
+
+}  // namespace
+
+int main()
+{
+    check_distributions();
+    check_edges();
+    check_rejected_scores();
+    check_integers();
+    return em::test::exit_status();
+}
@@ -0,0 +1,195 @@
+// Checks `RankingColumns::sort` against `std::stable_sort` on rankings long enough for
+// the radix sort (64 to 2000 documents): with both zeros, long runs of equal scores
+// and repeated document IDs, each at full depth and at random depths, which select
+// the top with `std::nth_element` first.
+//
+// The `id` column carries each document's position in the file, so that documents
+// `trec_order` cannot tell apart can still be told apart where the order is defined
+// (by rank, ties keep the file order).
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "check.hpp"
+#include "eval_metrics/ranking.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+using em::test::check;
+
+constexpr std::size_t full_depth = std::numeric_limits<std::size_t>::max();
+
+struct Scores {
+    char const* name;
+    std::function<double(std::mt19937_64&)> draw;
+};
+
+[[nodiscard]] auto score_distributions() -> std::vector<Scores>
+{
+    return {
+        {"distinct", [](auto& rng) { return std::normal_distribution<>(0.0, 10.0)(rng); }},
+        // A handful of values, so that most documents tie.
+        // Pairs and triples of equal scores among distinct ones.
+        {"sparse ties", [](auto& rng) { return std::uniform_int_distribution<>(0, 999)(rng) / 8.0; }},
+        {"few values", [](auto& rng) { return std::uniform_int_distribution<>(-2, 2)(rng) / 2.0; }},
+        {"both zeros",
+         [](auto& rng) {
+             auto pick = std::uniform_int_distribution<>(0, 3)(rng);
+             return pick == 0 ? 0.0 : pick == 1 ? -0.0 : pick == 2 ? 1.0 : -1e-300;
+         }},
+        {"all equal", [](auto&) { return 3.5; }},
+        {"extremes",
+         [](auto& rng) {
+             constexpr std::array<double, 6> values{
+                 std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                 std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest(),
+                 std::numeric_limits<double>::denorm_min(), -std::numeric_limits<double>::denorm_min()};
+             return values[std::uniform_int_distribution<std::size_t>(0, values.size() - 1)(rng)];
+         }},
+    };
+}
+
+/// Document IDs from a small pool, so that they repeat, with shared prefixes so that
+/// their comparison goes past the first bytes.
+[[nodiscard]] auto doc_pool() -> std::deque<std::string>
+{
+    std::deque<std::string> pool;
+    for (int idx = 0; idx < 150; ++idx) {
+        auto zeros = static_cast<std::size_t>(idx / 10);
+        pool.push_back("clueweb09-en0000-" + std::to_string(idx % 10) + std::string(zeros, '0'));
+    }
+    return pool;
+}
+
+[[nodiscard]] auto describe(em::ScoredDoc const& doc) -> std::string
+{
+    char score[32];
+    std::snprintf(score, sizeof(score), "%g", doc.score);
+    return std::string(doc.doc) + " (score " + score + ", rank " + std::to_string(doc.rank) + ", file position "
+        + std::to_string(doc.id) + ")";
+}
+
+/// Checks the first `depth` documents of `actual` against `expected`, the fully sorted
+/// ranking, and that the others are the rest of `original`, none of which should come
+/// before the last of the top.
+void check_sorted(
+    em::RankingView actual,
+    std::vector<em::ScoredDoc> const& original,
+    std::vector<em::ScoredDoc> const& expected,
+    std::size_t depth,
+    em::RankingOrder order,
+    std::string const& what)
+{
+    check(actual.size() == expected.size(), what + ": size");
+    if (actual.size() != expected.size()) {
+        return;
+    }
+    depth = std::min(depth, expected.size());
+    for (std::size_t pos = 0; pos < depth; ++pos) {
+        auto doc = actual[pos];
+        auto const& want = expected[pos];
+        // By score, tied documents with the same ID may come in either order; by rank,
+        // the file order (the `id` column) decides.
+        auto same = order == em::RankingOrder::score ? doc.doc == want.doc && doc.score == want.score
+                                                     : doc.id == want.id;
+        if (!same) {
+            check(false, what + ": position " + std::to_string(pos) + " holds " + describe(doc) + ", expected "
+                             + describe(want));
+            return;
+        }
+    }
+    // Every document is still there, exactly once, with its own score and rank.
+    std::vector<bool> seen(original.size());
+    for (std::size_t pos = 0; pos < actual.size(); ++pos) {
+        auto doc = actual[pos];
+        if (doc.id >= original.size() || seen[doc.id]) {
+            check(false, what + ": documents lost or repeated");
+            return;
+        }
+        seen[doc.id] = true;
+        auto const& source = original[doc.id];
+        auto same_score = std::bit_cast<std::uint64_t>(doc.score) == std::bit_cast<std::uint64_t>(source.score);
+        if (doc.doc != source.doc || !same_score || doc.rank != source.rank) {
+            check(false, what + ": columns out of step at position " + std::to_string(pos));
+            return;
+        }
+    }
+    if (depth > 0 && depth < actual.size() && order == em::RankingOrder::score) {
+        auto last = actual[depth - 1];
+        for (std::size_t pos = depth; pos < actual.size(); ++pos) {
+            if (em::trec_order(actual[pos], last)) {
+                check(false, what + ": document past the depth precedes the top");
+                return;
+            }
+        }
+    }
+}
+
+void check_rankings()
+{
+    auto pool = doc_pool();
+    std::mt19937_64 rng(13);
+    std::uniform_int_distribution<std::size_t> doc(0, pool.size() - 1);
+    em::SortBuffers buffers;
+    for (auto const& scores : score_distributions()) {
+        for (std::size_t size : {64, 65, 100, 127, 128, 129, 255, 256, 257, 1000, 2000}) {
+            std::uniform_int_distribution<std::size_t> random_depth(0, size + 5);
+            std::array<std::size_t, 6> depths{
+                full_depth, 63, 64, size - 1, random_depth(rng), random_depth(rng)};
+            for (auto depth : depths) {
+                for (auto order : {em::RankingOrder::score, em::RankingOrder::rank}) {
+                    // A ranking of another query first, so that the sorted one starts at an offset.
+                    em::RankingColumns columns;
+                    columns.push_back({"other", 1.0, 1, 0});
+                    std::vector<em::ScoredDoc> original;
+                    std::uniform_int_distribution<std::int64_t> rank(1, static_cast<std::int64_t>(size / 4 + 1));
+                    for (std::size_t pos = 0; pos < size; ++pos) {
+                        em::ScoredDoc scored{
+                            pool[doc(rng)], scores.draw(rng), rank(rng), static_cast<std::uint32_t>(pos)};
+                        columns.push_back(scored);
+                        original.push_back(scored);
+                    }
+                    auto expected = original;
+                    if (order == em::RankingOrder::score) {
+                        std::stable_sort(expected.begin(), expected.end(), em::trec_order);
+                    } else {
+                        std::stable_sort(expected.begin(), expected.end(), [](auto const& lhs, auto const& rhs) {
+                            return lhs.rank < rhs.rank;
+                        });
+                    }
+                    auto what = std::string(scores.name) + ", " + std::to_string(size) + " docs, depth "
+                        + (depth == full_depth ? std::string("all") : std::to_string(depth))
+                        + (order == em::RankingOrder::score ? ", by score" : ", by rank");
+                    columns.sort(1, size, order, buffers, depth);
+                    check(columns.view(0, 1)[0].doc == "other", what + ": preceding ranking moved");
+                    check_sorted(columns.view(1, size), original, expected, depth, order, what);
+
+                    // Sorting again finds it in order and leaves it as it is.
+                    auto again = columns;
+                    again.sort(1, size, order, buffers, depth);
+                    check(std::equal(again.view().ids.begin(), again.view().ids.end(), columns.view().ids.begin()),
+                          what + ": sorting a sorted ranking changed it");
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+int main()
+{
+    check_rankings();
+    return em::test::exit_status();
+}
@@ -0,0 +1,160 @@
+// Checks the block scanner and `FieldTokenizer` against the byte-by-byte `is_blank`,
+// `LineReader` and `split_fields`: on every byte value, on CRLF and tab-separated
+// lines, on fields and line ends straddling the 16-, 32- and 64-byte boundaries of the
+// SSE4.2 and AVX2 loads and of the blocks, and on random text.
+//
+// Runs with the instruction set named by its argument, which CTest selects through
+// `EVAL_METRICS_ISA` (`scalar`, `sse42`, or `avx2` to keep the detected one); exits with
+// 77, a skip, if the CPU cannot provide it.
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "check.hpp"
+#include "eval_metrics/detail/simd_scan.hpp"
+#include "eval_metrics/detail/text.hpp"
+#include "eval_metrics/detail/tokenizer.hpp"
+
+namespace {
+
+namespace em = eval_metrics;
+using em::test::check;
+
+constexpr int skipped = 77;
+
+/// Fields kept per line; fewer than some lines have, to check the overflow count.
+constexpr std::size_t max_fields = 4;
+
+void check_block(std::array<char, 64> const& block, std::string const& what)
+{
+    auto masks = em::detail::block_scanner()(block.data());
+    for (std::size_t idx = 0; idx < block.size(); ++idx) {
+        auto bit = std::uint64_t{1} << idx;
+        auto byte = std::to_string(static_cast<unsigned char>(block[idx]));
+        check(((masks.newlines & bit) != 0) == (block[idx] == '\n'),
+              what + ": newline bit of byte " + byte + " at " + std::to_string(idx));
+        check(((masks.blanks & bit) != 0) == em::detail::is_blank(block[idx]),
+              what + ": blank bit of byte " + byte + " at " + std::to_string(idx));
+    }
+}
+
+void check_blocks(std::mt19937_64& rng)
+{
+    // Every byte value in every position, 64 values per block.
+    for (int first = 0; first < 256; ++first) {
+        std::array<char, 64> block{};
+        for (std::size_t idx = 0; idx < block.size(); ++idx) {
+            block[idx] = static_cast<char>((first + static_cast<int>(idx) * 5) % 256);
+        }
+        check_block(block, "byte values from " + std::to_string(first));
+    }
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (int round = 0; round < 200; ++round) {
+        std::array<char, 64> block{};
+        for (auto& c : block) {
+            c = static_cast<char>(byte(rng));
+        }
+        check_block(block, "random block " + std::to_string(round));
+    }
+}
+
+/// Tokenizes `text` both ways and checks that every line has the same fields, count,
+/// number and extent.
+void check_text(std::string_view text, std::string const& what)
+{
+    em::detail::FieldTokenizer tokenizer(text, 7);
+    em::detail::LineReader reader(text, 7);
+    std::array<std::string_view, max_fields> fields;
+    std::array<std::string_view, max_fields> expected_fields;
+    std::size_t count = 0;
+    std::size_t line_begin = 0;
+    std::string_view line;
+    while (reader.next(line)) {
+        auto label = what + ", line " + std::to_string(reader.line_number());
+        if (!tokenizer.next(fields, count)) {
+            check(false, label + ": tokenizer ended early");
+            return;
+        }
+        auto expected_count = em::detail::split_fields(line, expected_fields);
+        check(tokenizer.line_number() == reader.line_number(), label + ": line number");
+        check(tokenizer.line_begin() == line_begin, label + ": line begin");
+        line_begin += line.size() + (line_begin + line.size() < text.size() ? 1 : 0);
+        check(tokenizer.position() == line_begin, label + ": position");
+        check(count == expected_count,
+              label + ": " + std::to_string(count) + " fields, expected " + std::to_string(expected_count));
+        for (std::size_t idx = 0; idx < std::min({count, expected_count, max_fields}); ++idx) {
+            check(fields[idx] == expected_fields[idx] && fields[idx].data() == expected_fields[idx].data(),
+                  label + ": field " + std::to_string(idx) + " is \"" + std::string(fields[idx]) + "\", expected \""
+                      + std::string(expected_fields[idx]) + "\"");
+        }
+    }
+    check(!tokenizer.next(fields, count), what + ": tokenizer reads past the end");
+}
+
+/// Lines whose fields, separators and line ends start on either side of the boundaries
+/// of the 16- and 32-byte loads and of the 64-byte blocks.
+void check_boundaries()
+{
+    for (std::size_t boundary : {16, 32, 48, 64, 96, 128}) {
+        for (std::size_t start = boundary - 3; start <= boundary + 3; ++start) {
+            for (std::size_t length : {1, 2, 3, 15, 17, 33, 65}) {
+                auto label = "field of " + std::to_string(length) + " at " + std::to_string(start);
+                // A run line, padded with a tab and spaces so the field starts at `start`.
+                std::string text = "301\tQ0 ";
+                text.append(start - text.size(), ' ');
+                text.append(length, 'd');
+                text += "\t1 2.5\tt";
+                check_text(text + "\n302 Q0 x 1 1 t\n", label + ", LF");
+                check_text(text + "\r\n302 Q0 x 1 1 t\r\n", label + ", CRLF");
+                check_text(text, label + ", no final newline");
+                check_text(text + " \t\r", label + ", trailing blanks");
+                // The line end, rather than the field, at `start`.
+                std::string line(start - 2, 'a');
+                line[start / 2] = '\t';
+                check_text(line + "\r\n" + line + "\n\n\t\n", "line end at " + std::to_string(start));
+            }
+        }
+    }
+}
+
+void check_random(std::mt19937_64& rng)
+{
+    constexpr std::string_view alphabet = "ab1.- \t\r\n\v\f";
+    std::uniform_int_distribution<std::size_t> letter(0, alphabet.size() - 1);
+    std::uniform_int_distribution<std::size_t> length(0, 300);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (int round = 0; round < 2000; ++round) {
+        std::string text(length(rng), ' ');
+        for (auto& c : text) {
+            // Mostly separators and field characters, some other bytes.
+            c = round % 4 == 3 ? static_cast<char>(byte(rng)) : alphabet[letter(rng)];
+        }
+        check_text(text, "random text " + std::to_string(round));
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string_view requested = argc > 1 ? argv[1] : "";
+    auto isa = em::detail::detected_isa();
+    if ((requested == "avx2" && isa != em::detail::Isa::avx2)
+        || (requested == "sse42" && isa != em::detail::Isa::sse42)) {
+        std::printf("%s is not available, skipping\n", std::string(requested).c_str());
+        return skipped;
+    }
+    check(requested.empty() || em::detail::isa_name(isa) == requested,
+          "running with " + std::string(em::detail::isa_name(isa)) + " instead of " + std::string(requested));
+    check(em::detail::block_scanner() == em::detail::block_scanner(isa), "default scanner is not the detected one");
+
+    std::mt19937_64 rng(6);
+    check_blocks(rng);
+    check_boundaries();
+    check_random(rng);
+    return em::test::exit_status();
+}
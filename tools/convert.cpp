@@ -0,0 +1,42 @@
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+#include "eval_metrics/binary_format.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace {
+
+constexpr std::string_view usage = R"(usage: convert <qrels|run> <input> <output>
+
+Converts TREC qrels or a TREC run to the binary columnar format, which the
+evaluate tool and the library load without parsing.
+)";
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 4) {
+        std::cerr << usage;
+        return EXIT_FAILURE;
+    }
+    std::string_view kind = argv[1];
+    try {
+        auto stamp = eval_metrics::SourceStamp::of(argv[2]);
+        if (kind == "qrels") {
+            eval_metrics::write_binary(argv[3], eval_metrics::Qrels::from_file(argv[2]), stamp);
+        } else if (kind == "run") {
+            eval_metrics::write_binary(argv[3], eval_metrics::Run::from_file(argv[2]), stamp);
+        } else {
+            std::cerr << usage;
+            return EXIT_FAILURE;
+        }
+    } catch (eval_metrics::Error const& error) {
+        std::cerr << "convert: " << error.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/batch.hpp"
+#include "eval_metrics/binary_format.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/qrels.hpp"
+#include "eval_metrics/run.hpp"
+#include "eval_metrics/run_stream.hpp"
+
+namespace {
+
+constexpr std::string_view usage = R"(usage: evaluate [options] <qrels> <run>...
+
+Evaluates TREC runs against TREC qrels and prints trec_eval-style output.
+
+With several runs, the qrels are loaded once and the runs are evaluated
+concurrently; each output line is prefixed with the run's path and a tab, and
+the runs are reported in command line order.
+
+options:
+  -q          print per-query values before the summary
+  -c          evaluate judged queries missing from the run as empty rankings
+  -J          evaluate condensed rankings: drop unjudged documents first
+  -m <specs>  measures to compute, as trec_eval names them (e.g. map,P.10 or
+              ndcg_cut.5,10,20) or as printed (P_10); may be repeated; rankings
+              are only sorted as deep as these measures need; also err.5,10
+              (expected reciprocal rank), rbp.0.8 (rank-biased precision at
+              persistence 0.8) and rbp_res.0.8 (its residual), ndcg_exp and
+              ndcg_exp_cut.5,10 (nDCG with gain 2^grade - 1), and for
+              incomplete judgments bpref, infAP (over sampled qrels, where
+              negative grades mark pooled documents left unjudged) and
+              judged.10 (fraction of the first 10 ranks that are judged)
+  -l <level>  minimum grade of a relevant document (default: 1)
+  -r          order rankings by the run's rank column instead of by score (as
+              trec_eval does); rankings already in rank order are not sorted
+  -j <n>      number of threads (default: all cores); with several runs, the
+              number of runs evaluated at a time
+  -C <dir>    cache the inputs in the binary format in <dir>; a cached file is
+              reused until its source file changes
+  -s          stream the run one query at a time; the run must be grouped by
+              query, otherwise the whole run is loaded instead
+  -h          show this help
+)";
+
+struct Arguments {
+    bool per_query = false;
+    bool stream = false;
+    std::filesystem::path cache_dir;
+    eval_metrics::EvaluationOptions evaluation;
+    eval_metrics::RunParseOptions parsing;
+    std::vector<std::string> positional;
+};
+
+template <typename T>
+[[nodiscard]] auto parse_value(std::string_view flag, char const* text) -> T
+{
+    T value{};
+    std::string_view input = text == nullptr ? std::string_view{} : std::string_view{text};
+    auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (input.empty() || ec != std::errc() || ptr != input.data() + input.size()) {
+        throw eval_metrics::Error("invalid value for " + std::string(flag));
+    }
+    return value;
+}
+
+[[nodiscard]] auto parse_arguments(int argc, char** argv) -> Arguments
+{
+    Arguments args;
+    for (int idx = 1; idx < argc; ++idx) {
+        std::string_view arg = argv[idx];
+        auto next = [&] { return idx + 1 < argc ? argv[++idx] : nullptr; };
+        if (arg == "-h" || arg == "--help") {
+            std::cout << usage;
+            std::exit(EXIT_SUCCESS);
+        } else if (arg == "-q") {
+            args.per_query = true;
+        } else if (arg == "-C") {
+            auto* dir = next();
+            if (dir == nullptr) {
+                throw eval_metrics::Error("missing directory for -C");
+            }
+            args.cache_dir = dir;
+        } else if (arg == "-s") {
+            args.stream = true;
+        } else if (arg == "-m") {
+            auto* names = next();
+            if (names == nullptr) {
+                throw eval_metrics::Error("missing measures for -m");
+            }
+            for (auto& spec : eval_metrics::split_measures(names)) {
+                args.evaluation.measures.push_back(std::move(spec));
+            }
+        } else if (arg == "-r") {
+            args.parsing.order = eval_metrics::RankingOrder::rank;
+        } else if (arg == "-c") {
+            args.evaluation.complete = true;
+        } else if (arg == "-J") {
+            args.evaluation.condensed = true;
+        } else if (arg == "-l") {
+            args.evaluation.relevance_level = parse_value<std::int32_t>(arg, next());
+        } else if (arg == "-j") {
+            args.parsing.threads = parse_value<std::size_t>(arg, next());
+        } else if (arg.size() > 1 && arg.front() == '-') {
+            throw eval_metrics::Error("unknown option " + std::string(arg));
+        } else {
+            args.positional.emplace_back(arg);
+        }
+    }
+    if (args.positional.size() < 2) {
+        throw eval_metrics::Error("expected <qrels> and <run> arguments");
+    }
+    return args;
+}
+
+/// Location of the binary cache of `input` within `cache_dir`.
+[[nodiscard]] auto cache_path(std::filesystem::path const& cache_dir, std::filesystem::path const& input)
+    -> std::filesystem::path
+{
+    auto absolute = std::filesystem::absolute(input).string();
+    std::ostringstream name;
+    name << input.filename().string() << '-' << std::hex << std::hash<std::string>{}(absolute) << ".evm";
+    return cache_dir / name.str();
+}
+
+[[nodiscard]] auto load_qrels(Arguments const& args) -> eval_metrics::Qrels
+{
+    std::filesystem::path const& path = args.positional[0];
+    if (args.cache_dir.empty()) {
+        return eval_metrics::Qrels::from_file(path);
+    }
+    return eval_metrics::load_qrels_cached(path, cache_path(args.cache_dir, path));
+}
+
+[[nodiscard]] auto load_run(
+    Arguments const& args, std::filesystem::path const& path, eval_metrics::RunParseOptions const& options)
+    -> eval_metrics::Run
+{
+    if (args.cache_dir.empty()) {
+        return eval_metrics::Run::from_file(path, options);
+    }
+    return eval_metrics::load_run_cached(path, cache_path(args.cache_dir, path), options);
+}
+
+/// Evaluates the runs concurrently and prints each run's lines prefixed with its path.
+/// Returns whether all runs were evaluated.
+[[nodiscard]] auto evaluate_batch(Arguments const& args, eval_metrics::Evaluator const& evaluator) -> bool
+{
+    std::vector<std::filesystem::path> paths(args.positional.begin() + 1, args.positional.end());
+    eval_metrics::BatchOptions options;
+    options.threads = args.parsing.threads;
+    options.stream = args.stream;
+    options.order = args.parsing.order;
+    options.load_run = [&](std::filesystem::path const& path, eval_metrics::RunParseOptions const& parsing) {
+        return load_run(args, path, parsing);
+    };
+    bool succeeded = true;
+    for (auto const& evaluation : eval_metrics::evaluate_runs(evaluator, paths, options)) {
+        if (!evaluation.stream_fallback.empty()) {
+            std::cerr << "evaluate: " << evaluation.path.string() << ": " << evaluation.stream_fallback
+                      << "; loaded the whole run instead\n";
+        }
+        if (evaluation.error) {
+            try {
+                std::rethrow_exception(evaluation.error);
+            } catch (std::exception const& error) {
+                std::cerr << "evaluate: " << evaluation.path.string() << ": " << error.what() << '\n';
+            }
+            succeeded = false;
+            continue;
+        }
+        std::ostringstream text;
+        eval_metrics::write_trec(text, *evaluation.results, evaluation.tag, args.per_query);
+        std::istringstream lines(text.str());
+        for (std::string line; std::getline(lines, line);) {
+            std::cout << evaluation.path.string() << '\t' << line << '\n';
+        }
+    }
+    return succeeded;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        auto args = parse_arguments(argc, argv);
+        auto qrels = load_qrels(args);
+        eval_metrics::Evaluator evaluator(qrels, args.evaluation);
+        if (args.positional.size() > 2) {
+            return evaluate_batch(args, evaluator) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        // Binary runs load without parsing, so they are never streamed.
+        if (args.stream && !eval_metrics::binary_source_stamp(args.positional[1])) {
+            try {
+                auto options = args.parsing;
+                options.dictionary = qrels.dictionary();
+                options.depth = evaluator.required_depth();
+                eval_metrics::RunStream stream(args.positional[1], options);
+                auto results = evaluator.evaluate(stream);
+                eval_metrics::write_trec(std::cout, results, stream.tag(), args.per_query);
+                return EXIT_SUCCESS;
+            } catch (eval_metrics::UngroupedRunError const& error) {
+                std::cerr << "evaluate: " << error.what() << "; loading the whole run instead\n";
+            }
+        }
+        auto options = args.parsing;
+        options.dictionary = qrels.dictionary();
+        options.depth = evaluator.required_depth();
+        auto run = load_run(args, args.positional[1], options);
+        auto results = evaluator.evaluate(run);
+        eval_metrics::write_trec(std::cout, results, run.tag(), args.per_query);
+    } catch (eval_metrics::Error const& error) {
+        std::cerr << "evaluate: " << error.what() << '\n';
+        if (argc < 2) {
+            std::cerr << usage;
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
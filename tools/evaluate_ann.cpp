@@ -0,0 +1,138 @@
+#include <charconv>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/ann.hpp"
+#include "eval_metrics/error.hpp"
+
+namespace {
+
+constexpr std::string_view usage = R"(usage: evaluate_ann [options] <ground-truth> <results>
+
+Evaluates approximate nearest-neighbor search results against the ground truth
+of a vector-search benchmark. Both hold one row of neighbor IDs per query,
+nearest first, as .ivecs files or, with any other extension, .ibin files (a
+header of two 32-bit counts, rows and neighbors per row, then the IDs).
+
+measures:
+  recall@k        fraction of the k true neighbors among the first k results
+  k-recall@n      fraction of the k true neighbors among the first n results
+  ratio@k         summed distances of the first k results over those of the k
+                  true neighbors (needs -t and -d)
+
+options:
+  -m <list>   measures, separated by commas (default: recall@10)
+  -t <file>   distances of the true neighbors (.fvecs or .fbin)
+  -d <file>   distances of the results (.fvecs or .fbin)
+  -q          print per-query values, by query number, before the summary
+  -j <n>      number of threads (default: all cores)
+  -h          show this help
+)";
+
+struct Arguments {
+    bool per_query = false;
+    std::string truth_distances;
+    std::string result_distances;
+    eval_metrics::AnnOptions evaluation;
+    std::vector<std::string> positional;
+};
+
+template <typename T>
+[[nodiscard]] auto parse_value(std::string_view flag, std::string_view input) -> T
+{
+    T value{};
+    auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (input.empty() || ec != std::errc() || ptr != input.data() + input.size()) {
+        throw eval_metrics::Error("invalid value for " + std::string(flag));
+    }
+    return value;
+}
+
+[[nodiscard]] auto parse_arguments(int argc, char** argv) -> Arguments
+{
+    Arguments args;
+    for (int idx = 1; idx < argc; ++idx) {
+        std::string_view arg = argv[idx];
+        auto next = [&] { return idx + 1 < argc ? std::string_view{argv[++idx]} : std::string_view{}; };
+        if (arg == "-h") {
+            std::cout << usage;
+            std::exit(EXIT_SUCCESS);
+        } else if (arg == "-q") {
+            args.per_query = true;
+        } else if (arg == "-m") {
+            args.evaluation.measures.clear();
+            for (auto list = next(); !list.empty();) {
+                auto comma = std::min(list.find(','), list.size());
+                args.evaluation.measures.emplace_back(list.substr(0, comma));
+                list.remove_prefix(std::min(comma + 1, list.size()));
+            }
+        } else if (arg == "-t") {
+            args.truth_distances = next();
+        } else if (arg == "-d") {
+            args.result_distances = next();
+        } else if (arg == "-j") {
+            args.evaluation.threads = parse_value<std::size_t>(arg, next());
+        } else if (arg.size() > 1 && arg.front() == '-') {
+            throw eval_metrics::Error("unknown option " + std::string(arg));
+        } else {
+            args.positional.emplace_back(arg);
+        }
+    }
+    if (args.positional.size() != 2) {
+        throw eval_metrics::Error("expected <ground-truth> and <results> arguments");
+    }
+    return args;
+}
+
+void write_row(std::ostream& os, std::string_view name, std::string_view query, double value)
+{
+    os << std::left << std::setw(22) << name << '\t' << query << '\t' << std::fixed << std::setprecision(4) << value
+       << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        auto args = parse_arguments(argc, argv);
+        auto truth = eval_metrics::NeighborMatrix::from_file(args.positional[0]);
+        std::optional<eval_metrics::DistanceMatrix> truth_distances;
+        if (!args.truth_distances.empty()) {
+            truth_distances = eval_metrics::DistanceMatrix::from_file(args.truth_distances);
+        }
+        eval_metrics::AnnEvaluator evaluator(
+            truth, args.evaluation, truth_distances ? &*truth_distances : nullptr);
+        auto results = eval_metrics::NeighborMatrix::from_file(args.positional[1]);
+        std::optional<eval_metrics::DistanceMatrix> result_distances;
+        if (!args.result_distances.empty()) {
+            result_distances = eval_metrics::DistanceMatrix::from_file(args.result_distances);
+        }
+        std::vector<double> per_query;
+        auto summary = evaluator.evaluate(
+            results, result_distances ? &*result_distances : nullptr, args.per_query ? &per_query : nullptr);
+
+        auto metrics = evaluator.metrics();
+        for (std::size_t query = 0; query < results.rows() && args.per_query; ++query) {
+            auto id = std::to_string(query);
+            for (std::size_t idx = 0; idx < metrics.size(); ++idx) {
+                write_row(std::cout, metrics[idx].name, id, per_query[query * metrics.size() + idx]);
+            }
+        }
+        for (std::size_t idx = 0; idx < metrics.size(); ++idx) {
+            write_row(std::cout, metrics[idx].name, "all", summary[idx]);
+        }
+    } catch (eval_metrics::Error const& error) {
+        std::cerr << "evaluate_ann: " << error.what() << '\n';
+        if (argc < 2) {
+            std::cerr << usage;
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/diversity.hpp"
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/run.hpp"
+
+namespace {
+
+constexpr std::string_view usage = R"(usage: evaluate_diversity [options] <qrels> <run>
+
+Evaluates the diversity of a run against intent (subtopic) judgments in the TREC
+diversity qrels format, "qid intent docno rel", with the measures of ndeval:
+ERR-IA, alpha-nDCG and subtopic recall (strec) at each cutoff, and NRBP.
+
+options:
+  -q          print per-query values before the summary
+  -c          evaluate judged queries missing from the run as empty rankings
+  -k <list>   cutoffs, separated by commas (default: 5,10,20)
+  -a <alpha>  redundancy penalty of alpha-nDCG, ERR-IA and NRBP (default: 0.5)
+  -b <beta>   persistence of NRBP (default: 0.5)
+  -l <level>  minimum grade of a document relevant to an intent (default: 1)
+  -r          order rankings by the run's rank column instead of by score
+  -j <n>      number of parsing threads (default: all cores)
+  -h          show this help
+)";
+
+struct Arguments {
+    bool per_query = false;
+    eval_metrics::DiversityOptions evaluation;
+    eval_metrics::RunParseOptions parsing;
+    std::vector<std::string> positional;
+};
+
+template <typename T>
+[[nodiscard]] auto parse_value(std::string_view flag, std::string_view input) -> T
+{
+    T value{};
+    auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (input.empty() || ec != std::errc() || ptr != input.data() + input.size()) {
+        throw eval_metrics::Error("invalid value for " + std::string(flag));
+    }
+    return value;
+}
+
+[[nodiscard]] auto parse_arguments(int argc, char** argv) -> Arguments
+{
+    Arguments args;
+    for (int idx = 1; idx < argc; ++idx) {
+        std::string_view arg = argv[idx];
+        auto next = [&] { return idx + 1 < argc ? std::string_view{argv[++idx]} : std::string_view{}; };
+        if (arg == "-h") {
+            std::cout << usage;
+            std::exit(EXIT_SUCCESS);
+        } else if (arg == "-q") {
+            args.per_query = true;
+        } else if (arg == "-c") {
+            args.evaluation.complete = true;
+        } else if (arg == "-k") {
+            args.evaluation.cutoffs.clear();
+            for (auto list = next(); !list.empty();) {
+                auto comma = std::min(list.find(','), list.size());
+                args.evaluation.cutoffs.push_back(parse_value<std::size_t>(arg, list.substr(0, comma)));
+                list.remove_prefix(std::min(comma + 1, list.size()));
+            }
+        } else if (arg == "-a") {
+            args.evaluation.alpha = parse_value<double>(arg, next());
+        } else if (arg == "-b") {
+            args.evaluation.beta = parse_value<double>(arg, next());
+        } else if (arg == "-l") {
+            args.evaluation.relevance_level = parse_value<std::int32_t>(arg, next());
+        } else if (arg == "-r") {
+            args.parsing.order = eval_metrics::RankingOrder::rank;
+        } else if (arg == "-j") {
+            args.parsing.threads = parse_value<std::size_t>(arg, next());
+        } else if (arg.size() > 1 && arg.front() == '-') {
+            throw eval_metrics::Error("unknown option " + std::string(arg));
+        } else {
+            args.positional.emplace_back(arg);
+        }
+    }
+    if (args.positional.size() != 2) {
+        throw eval_metrics::Error("expected <qrels> and <run> arguments");
+    }
+    return args;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        auto args = parse_arguments(argc, argv);
+        auto qrels = eval_metrics::IntentQrels::from_file(args.positional[0]);
+        eval_metrics::DiversityEvaluator evaluator(qrels, args.evaluation);
+        auto options = args.parsing;
+        options.dictionary = qrels.dictionary();
+        auto run = eval_metrics::Run::from_file(args.positional[1], options);
+        auto results = evaluator.evaluate(run);
+        eval_metrics::write_trec(std::cout, results, run.tag(), args.per_query);
+    } catch (eval_metrics::Error const& error) {
+        std::cerr << "evaluate_diversity: " << error.what() << '\n';
+        if (argc < 2) {
+            std::cerr << usage;
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "eval_metrics/error.hpp"
+#include "eval_metrics/evaluator.hpp"
+#include "eval_metrics/exposure.hpp"
+#include "eval_metrics/qrels.hpp"
+
+namespace {
+
+constexpr std::string_view usage = R"(usage: evaluate_exposure [options] <qrels> <samples>
+
+Evaluates sampled rankings by expected exposure: EE-L (distance to the target
+exposure), EE-D (disparity) and EE-R (relevance), per query and on average.
+
+The samples file names each query's candidates once, then each sampled ranking
+as a line of distinct candidate positions (from 0), best first:
+
+  qid D docno
+  qid S 3 0 7 1 ...
+
+options:
+  -q          print per-query values before the summary
+  -g <file>   also evaluate the exposure of document groups, read from lines
+              "docno group"
+  -p <p>      patience of the browsing model (default: 0.5)
+  -l <level>  minimum grade of a relevant document (default: 1)
+  -h          show this help
+)";
+
+struct Arguments {
+    bool per_query = false;
+    std::string groups;
+    eval_metrics::ExposureOptions evaluation;
+    std::vector<std::string> positional;
+};
+
+template <typename T>
+[[nodiscard]] auto parse_value(std::string_view flag, char const* text) -> T
+{
+    T value{};
+    std::string_view input = text == nullptr ? std::string_view{} : std::string_view{text};
+    auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (input.empty() || ec != std::errc() || ptr != input.data() + input.size()) {
+        throw eval_metrics::Error("invalid value for " + std::string(flag));
+    }
+    return value;
+}
+
+[[nodiscard]] auto parse_arguments(int argc, char** argv) -> Arguments
+{
+    Arguments args;
+    for (int idx = 1; idx < argc; ++idx) {
+        std::string_view arg = argv[idx];
+        auto next = [&] { return idx + 1 < argc ? argv[++idx] : nullptr; };
+        if (arg == "-h") {
+            std::cout << usage;
+            std::exit(EXIT_SUCCESS);
+        } else if (arg == "-q") {
+            args.per_query = true;
+        } else if (arg == "-g") {
+            auto* path = next();
+            if (path == nullptr) {
+                throw eval_metrics::Error("missing file for -g");
+            }
+            args.groups = path;
+        } else if (arg == "-p") {
+            args.evaluation.patience = parse_value<double>(arg, next());
+        } else if (arg == "-l") {
+            args.evaluation.relevance_level = parse_value<std::int32_t>(arg, next());
+        } else if (arg.size() > 1 && arg.front() == '-') {
+            throw eval_metrics::Error("unknown option " + std::string(arg));
+        } else {
+            args.positional.emplace_back(arg);
+        }
+    }
+    if (args.positional.size() != 2) {
+        throw eval_metrics::Error("expected <qrels> and <samples> arguments");
+    }
+    return args;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        auto args = parse_arguments(argc, argv);
+        auto qrels = eval_metrics::Qrels::from_file(args.positional[0]);
+        std::optional<eval_metrics::DocumentGroups> groups;
+        if (!args.groups.empty()) {
+            groups = eval_metrics::DocumentGroups::from_file(args.groups);
+        }
+        eval_metrics::ExposureEvaluator evaluator(qrels, args.evaluation, groups ? &*groups : nullptr);
+        auto runs = eval_metrics::SampledRuns::from_file(args.positional[1], qrels.dictionary());
+        auto results = evaluator.evaluate(runs);
+        eval_metrics::write_trec(std::cout, results, "samples", args.per_query);
+    } catch (eval_metrics::Error const& error) {
+        std::cerr << "evaluate_exposure: " << error.what() << '\n';
+        if (argc < 2) {
+            std::cerr << usage;
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}